@@ -30,22 +30,53 @@ struct AssimpNodeData
     std::vector<AssimpNodeData> children;
 };
 
+/* one node of the baked hierarchy, nodes are stored parents first so a single
+forward pass sees every parent before its children*/
+struct AnimationNode
+{
+    // index of the parent in the baked array, -1 for the root
+    int parent;
+    // index into Animation::m_Bones, -1 when the node has no animation channel
+    int boneIndex;
+    // slot in the final bone matrices, -1 when the node has no BoneInfo
+    int finalIndex;
+    // bind pose transform, used when the node is not animated
+    glm::mat4 transformation;
+    glm::mat4 offset;
+};
+
 class Animation {
 public:
     AssimpNodeData m_RootNode;
     std::vector<Bone> m_Bones;
-    std::map<std::string, BoneInfo> m_BoneInfoMap;
     Animation() = default;
 
-    Animation(const std::string& animationPath, Model* model) {
-        Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(animationPath, aiProcess_Triangulate);
-        assert(scene && scene->mRootNode);
-        auto animation = scene->mAnimations[0];
-        m_Duration = animation->mDuration;
-        m_TicksPerSecond = animation->mTicksPerSecond;
-        ReadHeirarchyData(m_RootNode, scene->mRootNode);
-        ReadMissingBones(animation, *model);
+    /* builds clip of an already imported model (ModelImport or ModelCache). The bone
+    registry is data's, shared with the Model and the other clips, not copied*/
+    Animation(const ModelData& data, size_t clip = 0)
+    {
+        assert(clip < data.clips.size() && !data.nodes.empty());
+        const ClipView& source = data.clips[clip];
+        m_Duration = source.duration;
+        m_TicksPerSecond = source.ticksPerSecond;
+        size_t next = 0;
+        ReadHeirarchyData(m_RootNode, data.nodes, next);
+        m_Bones.reserve(source.channels.size());
+        for (const ChannelView& channel : source.channels)
+            m_Bones.push_back(Bone(channel.name, channel.boneID, channel.positions.ToVector(),
+                channel.rotations.ToVector(), channel.scales.ToVector()));
+        m_Registry = data.bones;
+        BakeHierarchy();
+    }
+
+    /* builds an animation from already loaded data, e.g. a synthetic skeleton*/
+    Animation(const AssimpNodeData& rootNode, const std::vector<Bone>& bones,
+        const std::map<std::string, BoneInfo>& boneInfoMap, float duration, int ticksPerSecond)
+        : m_RootNode(rootNode), m_Bones(bones),
+        m_Registry(std::make_shared<BoneRegistry>(BoneRegistry{boneInfoMap, (int) boneInfoMap.size()})),
+        m_Duration(duration), m_TicksPerSecond(ticksPerSecond)
+    {
+        BakeHierarchy();
     }
 
     ~Animation()
@@ -73,61 +104,107 @@ public:
     }
 
 	
-    inline float GetTicksPerSecond() { return m_TicksPerSecond; }
+    inline float GetTicksPerSecond() const { return m_TicksPerSecond; }
 
-    inline float GetDuration() { return m_Duration;}
+    inline float GetDuration() const { return m_Duration;}
 
     inline const AssimpNodeData& GetRootNode() { return m_RootNode; }
 
-    inline const std::map<std::string,BoneInfo>& GetBoneIDMap() 
+    inline const BoneInfoMap& GetBoneIDMap() const
     { 
-        return m_BoneInfoMap;
+        return m_Registry->bones;
     }
 
+    inline const std::shared_ptr<const BoneRegistry>& GetBoneRegistry() const { return m_Registry; }
+
+    inline const std::vector<AnimationNode>& GetNodes() const { return m_Nodes; }
+
+    /* keyframes are only read during playback, Animators sample them through
+    Bone::Sample so one Animation can be shared by any number of them*/
+    inline const std::vector<Bone>& GetBones() const { return m_Bones; }
+
 private:
-    void ReadMissingBones(const aiAnimation* animation, Model& model)
+    /* rebuilds the tree from nodes stored parents first, next is the node to read*/
+    void ReadHeirarchyData(AssimpNodeData& dest, const std::vector<ModelNode>& nodes, size_t& next)
     {
-        int size = animation->mNumChannels;
+        assert(next < nodes.size());
+        const ModelNode& src = nodes[next++];
+        dest.name = src.name;
+        dest.transformation = src.transformation;
+        dest.childrenCount = src.childrenCount;
+
+        dest.children.resize(src.childrenCount);
+        for (int i = 0; i < src.childrenCount; i++)
+            ReadHeirarchyData(dest.children[i], nodes, next);
+    }
 
-        auto& boneInfoMap = model.GetBoneInfoMap();//getting m_BoneInfoMap from Model class
-        int& boneCount = model.GetBoneCount(); //getting the m_BoneCounter from Model class
+    /* flattens m_RootNode into m_Nodes in depth first order, resolving each node's
+    bone channel and BoneInfo once so evaluation needs no name lookups*/
+    void BakeHierarchy()
+    {
+        m_Nodes.clear();
 
-        //reading channels(bones engaged in an animation and their keyframes)
-        for (int i = 0; i < size; i++)
+        std::map<std::string, int> channelByLowerName;
+        for (int i = 0; i < (int) m_Bones.size(); i++)
         {
-            auto channel = animation->mChannels[i];
-            std::string boneName = channel->mNodeName.data;
-
-            if (boneInfoMap.find(boneName) == boneInfoMap.end())
-            {
-                boneInfoMap[boneName].id = boneCount;
-                boneCount++;
-            }
-            m_Bones.push_back(Bone(channel->mNodeName.data,
-                boneInfoMap[channel->mNodeName.data].id, channel));
+            std::string name = m_Bones[i].GetBoneName();
+            std::transform(name.begin(), name.end(), name.begin(),
+                [](unsigned char c){ return std::tolower(c); });
+            // FindBone returns the first match
+            channelByLowerName.insert({name, i});
         }
 
-        m_BoneInfoMap = boneInfoMap;
-    }
+        std::vector<std::pair<const AssimpNodeData*, int>> stack;
+        stack.push_back({&m_RootNode, -1});
+        while (!stack.empty())
+        {
+            const AssimpNodeData* src = stack.back().first;
+            int parent = stack.back().second;
+            stack.pop_back();
 
-    void ReadHeirarchyData(AssimpNodeData& dest, const aiNode* src)
-    {
-        assert(src);
+            AnimationNode node;
+            node.parent = parent;
+            node.transformation = src->transformation;
+            node.offset = glm::mat4(1.0f);
+
+            std::string lowerName = src->name;
+            std::transform(lowerName.begin(), lowerName.end(), lowerName.begin(),
+                [](unsigned char c){ return std::tolower(c); });
+            auto channel = channelByLowerName.find(lowerName);
+            node.boneIndex = channel == channelByLowerName.end() ? -1 : channel->second;
 
-        dest.name = src->mName.data;
-        dest.transformation = AssimpGLMHelpers::ConvertMatrixToGLMFormat(src->mTransformation);
-        dest.childrenCount = src->mNumChildren;
+            auto info = m_Registry->bones.find(src->name);
+            node.finalIndex = -1;
+            if (info != m_Registry->bones.end())
+            {
+                node.finalIndex = info->second.id;
+                node.offset = info->second.offset;
+            }
 
-        for (int i = 0; i < src->mNumChildren; i++)
-        {
-            AssimpNodeData newData;
-            ReadHeirarchyData(newData, src->mChildren[i]);
-            dest.children.push_back(newData);
+            int index = m_Nodes.size();
+            m_Nodes.push_back(node);
+            // pushed in reverse so children come out in their original order
+            for (int i = src->childrenCount - 1; i >= 0; i--)
+                stack.push_back({&src->children[i], index});
         }
     }
+
+    std::vector<AnimationNode> m_Nodes;
+    std::shared_ptr<const BoneRegistry> m_Registry = std::make_shared<BoneRegistry>();
     float m_Duration;
     int m_TicksPerSecond;
 };
 
+/* every clip of one import as its own Animation, all of them and the Model built from
+the same data index one shared bone registry*/
+std::vector<Animation> LoadAnimations(const ModelData& data)
+{
+    std::vector<Animation> clips;
+    clips.reserve(data.clips.size());
+    for (size_t i = 0; i < data.clips.size(); i++)
+        clips.emplace_back(data, i);
+    return clips;
+}
+
 
 #endif
\ No newline at end of file
@@ -22,9 +22,12 @@
 #include "Bone.hpp"
 #include "Animation.hpp"
 
+/* playback state of one instance: time, keyframe cursors and output matrices.
+The Animation it plays is never written to, so many Animators can share one clip
+and be updated from different threads at once*/
 class Animator {	
 public:
-    Animator(Animation* Animation) {
+    Animator(const Animation* Animation) {
         m_CurrentTime = 0.0;
         m_CurrentAnimation = Animation;
 
@@ -32,6 +35,7 @@ public:
 
         for (int i = 0; i < 100; i++)
             m_FinalBoneMatrices.push_back(glm::mat4(1.0f));
+        FitFinalBoneMatrices();
     }
 	
     void UpdateAnimation(float dt) {
@@ -40,50 +44,76 @@ public:
             // std::cout << "processing" << std::endl;
             m_CurrentTime += m_CurrentAnimation->GetTicksPerSecond() * dt;
             m_CurrentTime = fmod(m_CurrentTime, m_CurrentAnimation->GetDuration());
-            CalculateBoneTransform(&m_CurrentAnimation->GetRootNode(), glm::mat4(1.0f));
+            CalculateBoneTransforms();
         }
     }
 	
-    void PlayAnimation(Animation* pAnimation)
+    void PlayAnimation(const Animation* pAnimation)
     {
         m_CurrentAnimation = pAnimation;
         m_CurrentTime = 0.0f;
+        FitFinalBoneMatrices();
     }
-	
-    void CalculateBoneTransform(const AssimpNodeData* node, glm::mat4 parentTransform)
+
+    /* jumps to a time in ticks, e.g. to stagger instances playing the same clip*/
+    void SetCurrentTime(float time)
     {
-        std::string nodeName = node->name;
-        glm::mat4 nodeTransform = node->transformation;
-	
-        Bone* Bone = m_CurrentAnimation->FindBone(nodeName);
-	
-        if (Bone) {
-            Bone->Update(m_CurrentTime);
-            nodeTransform = Bone->GetLocalTransform();
-        }
-	
-        glm::mat4 globalTransformation = parentTransform * nodeTransform;
+        m_CurrentTime = m_CurrentAnimation ? fmod(time, m_CurrentAnimation->GetDuration()) : time;
+    }
+
+    float GetCurrentTime() const { return m_CurrentTime; }
 	
-        auto boneInfoMap = m_CurrentAnimation->GetBoneIDMap();
-        if (boneInfoMap.find(nodeName) != boneInfoMap.end()) {
-            int index = boneInfoMap[nodeName].id;
-            glm::mat4 offset = boneInfoMap[nodeName].offset;
-            m_FinalBoneMatrices[index] = globalTransformation * offset;
-        }
+    /* evaluates the baked hierarchy in one forward pass, parents always come
+    before their children so their global transform is already known*/
+    void CalculateBoneTransforms()
+    {
+        const std::vector<AnimationNode>& nodes = m_CurrentAnimation->GetNodes();
+        const std::vector<Bone>& bones = m_CurrentAnimation->GetBones();
+        if (m_GlobalTransforms.size() != nodes.size())
+            m_GlobalTransforms.resize(nodes.size());
+        if (m_Cursors.size() != bones.size())
+            m_Cursors.resize(bones.size());
+
+        for (size_t i = 0; i < nodes.size(); i++) {
+            const AnimationNode& node = nodes[i];
+            glm::mat4 nodeTransform = node.transformation;
+
+            if (node.boneIndex >= 0)
+                nodeTransform = bones[node.boneIndex].Sample(m_CurrentTime, m_Cursors[node.boneIndex]);
+
+            m_GlobalTransforms[i] = node.parent >= 0
+                ? m_GlobalTransforms[node.parent] * nodeTransform
+                : nodeTransform;
 
-        for (int i = 0; i < node->childrenCount; i++) {
-            CalculateBoneTransform(&node->children[i], globalTransformation);            
+            if (node.finalIndex >= 0)
+                m_FinalBoneMatrices[node.finalIndex] = m_GlobalTransforms[i] * node.offset;
         }
     }
 	
-    std::vector<glm::mat4> GetFinalBoneMatrices() 
+    const std::vector<glm::mat4>& GetFinalBoneMatrices() const
     { 
         return m_FinalBoneMatrices;  
     }
 		
 private:
+    /* grows the final matrices past the shader's 100 when a skeleton has more bones*/
+    void FitFinalBoneMatrices()
+    {
+        if (!m_CurrentAnimation)
+            return;
+        for (const AnimationNode& node : m_CurrentAnimation->GetNodes())
+        {
+            if (node.finalIndex >= (int) m_FinalBoneMatrices.size())
+                m_FinalBoneMatrices.resize(node.finalIndex + 1, glm::mat4(1.0f));
+        }
+    }
+
     std::vector<glm::mat4> m_FinalBoneMatrices;
-    Animation* m_CurrentAnimation;
+    // global transform per baked node, reused every update
+    std::vector<glm::mat4> m_GlobalTransforms;
+    // keyframe cursors of this instance, one per Animation bone
+    std::vector<BoneCursor> m_Cursors;
+    const Animation* m_CurrentAnimation;
     float m_CurrentTime;
     float m_DeltaTime;	
 };
@@ -15,8 +15,10 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <algorithm>
 
 #include "AssimpGLMHelpers.h"
+#include "Logger.h"
 
 struct KeyPosition
 {
@@ -36,6 +38,16 @@ struct KeyScale
     float timeStamp;
 };
 
+/* last key index found per channel, playback is mostly monotonic so the next
+lookup usually lands on the same key or the one after it. Kept outside the
+keyframes so every instance playing a clip can carry its own*/
+struct BoneCursor
+{
+    int position = 0;
+    int rotation = 0;
+    int scale = 0;
+};
+
 class Bone
 {
 private:
@@ -45,6 +57,9 @@ private:
     int m_NumPositions;
     int m_NumRotations;
     int m_NumScalings;
+
+    // cursor used by Update, shared instances sample through their own
+    BoneCursor m_Cursor;
 	
     glm::mat4 m_LocalTransform;
     int m_ID;
@@ -61,7 +76,7 @@ public:
     {
         m_NumPositions = channel->mNumPositionKeys;
         aiVector3D aiPosition = channel->mPositionKeys[0].mValue;
-        std::cout << "NAME: " << name << "POS ("<< aiPosition.x << ", " << aiPosition.y << ", " << aiPosition.z << std::endl;
+        LOG_DEBUG("NAME: " << name << "POS ("<< aiPosition.x << ", " << aiPosition.y << ", " << aiPosition.z);
 
         for (int positionIndex = 0; positionIndex < m_NumPositions; ++positionIndex)
         {
@@ -100,9 +115,26 @@ public:
 
         glm::vec4 localVec(0, 0, 0, 1);
         auto scaledVec = m_LocalTransform * localVec;
-        std::cout << name << ": (" << scaledVec.x << ", " << scaledVec.y << ", " << scaledVec.z << ")" << std::endl;
+        LOG_DEBUG(name << ": (" << scaledVec.x << ", " << scaledVec.y << ", " << scaledVec.z << ")");
 
     }
+
+    /*takes keyframes that were already read, e.g. from a baked model cache*/
+    Bone(const std::string& name, int ID, std::vector<KeyPosition> positions,
+        std::vector<KeyRotation> rotations, std::vector<KeyScale> scales)
+        :
+        m_Positions(std::move(positions)),
+        m_Rotations(std::move(rotations)),
+        m_Scales(std::move(scales)),
+        m_LocalTransform(1.0f),
+        m_ID(ID),
+        m_Name(name)
+    {
+        m_NumPositions = m_Positions.size();
+        m_NumRotations = m_Rotations.size();
+        m_NumScalings = m_Scales.size();
+        Update(m_Positions[0].timeStamp);
+    }
 	
     glm::vec4 get_first_position() {
         return glm::vec4(m_Positions[0].position, 1);
@@ -113,73 +145,102 @@ public:
     tranformations*/
     void Update(float animationTime)
     {
-        glm::mat4 translation = InterpolatePosition(animationTime);
-        glm::mat4 rotation = InterpolateRotation(animationTime);
-        glm::mat4 scale = InterpolateScaling(animationTime);
-        m_LocalTransform = translation * rotation * scale;
+        m_LocalTransform = Sample(animationTime, m_Cursor);
+    }
+
+    /*same as Update but leaves the bone untouched, the keyframes are only read so
+    any number of threads can sample one bone, each with its own cursor*/
+    glm::mat4 Sample(float animationTime, BoneCursor& cursor) const
+    {
+        glm::mat4 translation = InterpolatePosition(animationTime, cursor.position);
+        glm::mat4 rotation = InterpolateRotation(animationTime, cursor.rotation);
+        glm::mat4 scale = InterpolateScaling(animationTime, cursor.scale);
+        return translation * rotation * scale;
     }
 
-    glm::mat4 GetLocalTransform() { return m_LocalTransform; }
+    glm::mat4 GetLocalTransform() const { return m_LocalTransform; }
     std::string GetBoneName() const { return m_Name; }
-    int GetBoneID() { return m_ID; }
+    int GetBoneID() const { return m_ID; }
+    const std::vector<KeyPosition>& GetPositionKeys() const { return m_Positions; }
+    const std::vector<KeyRotation>& GetRotationKeys() const { return m_Rotations; }
+    const std::vector<KeyScale>& GetScaleKeys() const { return m_Scales; }
 	
 
     /* Gets the current index on mKeyPositions to interpolate to based on 
     the current animation time*/
     int GetPositionIndex(float animationTime)
     {
-        for (int index = 0; index < m_NumPositions - 1; ++index)
-        {
-            if (animationTime < m_Positions[index + 1].timeStamp)
-                return index;
-        }
-        assert(0);
+        return FindKeyIndex(m_Positions, animationTime, m_Cursor.position);
     }
 
     /* Gets the current index on mKeyRotations to interpolate to based on the 
     current animation time*/
     int GetRotationIndex(float animationTime)
     {
-        for (int index = 0; index < m_NumRotations - 1; ++index)
-        {
-            if (animationTime < m_Rotations[index + 1].timeStamp)
-                return index;
-        }
-        assert(0);
+        return FindKeyIndex(m_Rotations, animationTime, m_Cursor.rotation);
     }
 
     /* Gets the current index on mKeyScalings to interpolate to based on the 
     current animation time */
     int GetScaleIndex(float animationTime)
     {
-        for (int index = 0; index < m_NumScalings - 1; ++index)
+        return FindKeyIndex(m_Scales, animationTime, m_Cursor.scale);
+    }
+
+    /* Finds index i with keys[i].timeStamp <= animationTime < keys[i + 1].timeStamp.
+    Checks the cached cursor and the key after it first, and falls back to a binary
+    search on seeks and loops. Times before the first key return 0 and times past the
+    last key return the last pair, GetScaleFactor clamps so the end key is held.*/
+    template <typename Key>
+    static int FindKeyIndex(const std::vector<Key>& keys, float animationTime, int& cursor)
+    {
+        int lastPair = (int) keys.size() - 2;
+        if (lastPair <= 0)
+            return 0;
+        if (animationTime >= keys[lastPair + 1].timeStamp)
+            return cursor = lastPair;
+        if (animationTime < keys[1].timeStamp)
+            return cursor = 0;
+
+        if (cursor > lastPair)
+            cursor = lastPair;
+        if (keys[cursor].timeStamp <= animationTime)
         {
-            if (animationTime < m_Scales[index + 1].timeStamp)
-                return index;
+            if (animationTime < keys[cursor + 1].timeStamp)
+                return cursor;
+            if (cursor + 1 <= lastPair && animationTime < keys[cursor + 2].timeStamp)
+                return ++cursor;
         }
-        assert(0);
+
+        auto next = std::upper_bound(keys.begin(), keys.end(), animationTime,
+            [](float time, const Key& key) { return time < key.timeStamp; });
+        cursor = (int) (next - keys.begin()) - 1;
+        return cursor;
     }
 
 private:
 
     /* Gets normalized value for Lerp & Slerp*/
-    float GetScaleFactor(float lastTimeStamp, float nextTimeStamp, float animationTime)
+    float GetScaleFactor(float lastTimeStamp, float nextTimeStamp, float animationTime) const
     {
         float scaleFactor = 0.0f;
         float midWayLength = animationTime - lastTimeStamp;
         float framesDiff = nextTimeStamp - lastTimeStamp;
+        if (framesDiff <= 0.0f)
+            return 0.0f;
         scaleFactor = midWayLength / framesDiff;
-        return scaleFactor;
+        // outside the key range the nearest key is held
+        return glm::clamp(scaleFactor, 0.0f, 1.0f);
     }
 
     /*figures out which position keys to interpolate b/w and performs the interpolation 
     and returns the translation matrix*/
-    glm::mat4 InterpolatePosition(float animationTime)
+    glm::mat4 InterpolatePosition(float animationTime, int& cursor) const
     {
         if (1 == m_NumPositions)
             return glm::translate(glm::mat4(1.0f), m_Positions[0].position);
 
-        int p0Index = GetPositionIndex(animationTime);
+        int p0Index = FindKeyIndex(m_Positions, animationTime, cursor);
         int p1Index = p0Index + 1;
         float scaleFactor = GetScaleFactor(m_Positions[p0Index].timeStamp,
             m_Positions[p1Index].timeStamp, animationTime);
@@ -190,7 +251,7 @@ private:
 
     /*figures out which rotations keys to interpolate b/w and performs the interpolation 
     and returns the rotation matrix*/
-    glm::mat4 InterpolateRotation(float animationTime)
+    glm::mat4 InterpolateRotation(float animationTime, int& cursor) const
     {
         if (1 == m_NumRotations)
         {
@@ -198,7 +259,7 @@ private:
             return glm::toMat4(rotation);
         }
 
-        int p0Index = GetRotationIndex(animationTime);
+        int p0Index = FindKeyIndex(m_Rotations, animationTime, cursor);
         int p1Index = p0Index + 1;
         float scaleFactor = GetScaleFactor(m_Rotations[p0Index].timeStamp,
             m_Rotations[p1Index].timeStamp, animationTime);
@@ -210,12 +271,12 @@ private:
 
     /*figures out which scaling keys to interpolate b/w and performs the interpolation 
     and returns the scale matrix*/
-    glm::mat4 InterpolateScaling(float animationTime)
+    glm::mat4 InterpolateScaling(float animationTime, int& cursor) const
     {
         if (1 == m_NumScalings)
             return glm::scale(glm::mat4(1.0f), m_Scales[0].scale);
 
-        int p0Index = GetScaleIndex(animationTime);
+        int p0Index = FindKeyIndex(m_Scales, animationTime, cursor);
         int p1Index = p0Index + 1;
         float scaleFactor = GetScaleFactor(m_Scales[p0Index].timeStamp,
             m_Scales[p1Index].timeStamp, animationTime);
@@ -0,0 +1,78 @@
+#ifndef BONE_PALETTE_BUFFER_H
+#define BONE_PALETTE_BUFFER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <algorithm>
+
+#include "GLCallCounter.h"
+
+// binding point shaders attach their BonePalette block to
+const unsigned int BONE_PALETTE_BINDING = 0;
+// matches MAX_BONES in skeleton_animation.vert
+const unsigned int BONE_PALETTE_MAX_BONES = 100;
+
+/**
+ * Uniform buffer holding the final bone matrices for the BonePalette block
+ *
+ *   layout (std140) uniform BonePalette { mat4 finalBonesMatrices[MAX_BONES]; };
+ *
+ * std140 lays out a mat4 array as 64 byte column major matrices, the same as a
+ * std::vector<glm::mat4>, so a whole palette goes up in one glBufferSubData.
+ */
+class BonePaletteBuffer {
+public:
+    unsigned int UBO = 0;
+
+    BonePaletteBuffer(unsigned int maxBones = BONE_PALETTE_MAX_BONES, unsigned int bindingPoint = BONE_PALETTE_BINDING)
+        : maxBones(maxBones), bindingPoint(bindingPoint)
+    {
+        glGenBuffers(1, &UBO);
+        glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+        glBufferData(GL_UNIFORM_BUFFER, maxBones * sizeof(glm::mat4), NULL, GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_UNIFORM_BUFFER, bindingPoint, UBO);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    BonePaletteBuffer(const BonePaletteBuffer&) = delete;
+    BonePaletteBuffer& operator=(const BonePaletteBuffer&) = delete;
+
+    ~BonePaletteBuffer() {
+        Release();
+    }
+
+    /**
+     * @brief frees the buffer, call before the context goes away if the palette outlives it
+     */
+    void Release() {
+        if (UBO == 0)
+            return;
+        glDeleteBuffers(1, &UBO);
+        UBO = 0;
+    }
+
+    /**
+     * @brief writes the palette, e.g. Animator::GetFinalBoneMatrices(). Matrices past
+     * maxBones are dropped, the shader treats those bone ids as unskinned anyway.
+     *
+     * @param matrices
+     */
+    void Upload(const std::vector<glm::mat4>& matrices) {
+        size_t count = std::min<size_t>(matrices.size(), maxBones);
+        if (count == 0)
+            return;
+        GL_COUNTED(glBindBuffer(GL_UNIFORM_BUFFER, UBO));
+        GL_COUNTED(glBufferSubData(GL_UNIFORM_BUFFER, 0, count * sizeof(glm::mat4), matrices.data()));
+    }
+
+    unsigned int BindingPoint() const { return bindingPoint; }
+    unsigned int MaxBones() const { return maxBones; }
+
+private:
+    unsigned int maxBones;
+    unsigned int bindingPoint;
+};
+
+#endif
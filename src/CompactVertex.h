@@ -0,0 +1,290 @@
+#ifndef COMPACT_VERTEX_H
+#define COMPACT_VERTEX_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <limits>
+
+#include "Vertex.h"
+
+// packed bone id of an unused influence, the -1 of Vertex::m_BoneIDs
+const uint8_t COMPACT_VERTEX_NO_BONE = 255;
+// ids past it are clamped, they stay past the shader's MAX_BONES so the vertex stays unskinned
+const uint8_t COMPACT_VERTEX_MAX_BONE_ID = 254;
+
+/*
+ * How a Mesh stores its vertices. The compact layout packs a Vertex into 36 bytes
+ * (32 with 8 bit weights) instead of 88:
+ *
+ *   position   3 x float
+ *   normal     octahedral, 2 x snorm16
+ *   texcoords  2 x half
+ *   tangent    octahedral, 2 x snorm16, the bitangent is cross(normal, tangent)
+ *   bone ids   4 x uint8, 255 for an unused influence
+ *   weights    4 x unorm16 (or unorm8)
+ *
+ * and needs the skeleton_animation_compact shader, which decodes the normal and skips id 255.
+ */
+enum MeshVertexLayout {
+    MESH_LAYOUT_FULL,
+    MESH_LAYOUT_COMPACT
+};
+
+// what a Mesh keeps on the CPU once its buffers are uploaded
+enum MeshCpuCopy {
+    // the Vertex array, as before
+    MESH_KEEP_VERTICES,
+    // a VertexSoA, e.g. for CpuSkinner or export, the Vertex array is freed
+    MESH_KEEP_SOA,
+    // nothing, vertices and indices are freed after upload
+    MESH_RELEASE_CPU
+};
+
+struct MeshStorage {
+    MeshVertexLayout layout = MESH_LAYOUT_FULL;
+    // unorm8 instead of unorm16 weights in the compact layout
+    bool weights8 = false;
+    MeshCpuCopy cpuCopy = MESH_KEEP_VERTICES;
+};
+
+template <typename WeightT>
+struct CompactVertexT {
+    glm::vec3 Position;
+    int16_t Normal[2];
+    uint16_t TexCoords[2];
+    int16_t Tangent[2];
+    uint8_t BoneIDs[MAX_BONE_INFLUENCE];
+    WeightT Weights[MAX_BONE_INFLUENCE];
+};
+
+typedef CompactVertexT<uint16_t> CompactVertex;
+typedef CompactVertexT<uint8_t> CompactVertex8;
+
+inline float OctSignNotZero(float v) {
+    return v >= 0.0f ? 1.0f : -1.0f;
+}
+
+/**
+ * @brief octahedral encoding of a direction into 2 snorm16, under 0.01 degrees of error.
+ * Zero or non finite vectors (e.g. missing tangents) are stored as +z.
+ *
+ * @param v
+ * @param out
+ */
+inline void OctEncode(glm::vec3 v, int16_t out[2]) {
+    float l1 = std::fabs(v.x) + std::fabs(v.y) + std::fabs(v.z);
+    if (!(l1 > 1e-20f) || !std::isfinite(l1))
+        v = glm::vec3(0.0f, 0.0f, 1.0f), l1 = 1.0f;
+    glm::vec2 p(v.x / l1, v.y / l1);
+    if (v.z < 0.0f)
+        p = glm::vec2((1.0f - std::fabs(p.y)) * OctSignNotZero(p.x), (1.0f - std::fabs(p.x)) * OctSignNotZero(p.y));
+    out[0] = (int16_t) std::lround(glm::clamp(p.x, -1.0f, 1.0f) * 32767.0f);
+    out[1] = (int16_t) std::lround(glm::clamp(p.y, -1.0f, 1.0f) * 32767.0f);
+}
+
+// same decode as octDecode in skeleton_animation_compact.vert
+inline glm::vec3 OctDecode(const int16_t in[2]) {
+    glm::vec2 p(std::max(in[0] / 32767.0f, -1.0f), std::max(in[1] / 32767.0f, -1.0f));
+    glm::vec3 v(p.x, p.y, 1.0f - std::fabs(p.x) - std::fabs(p.y));
+    if (v.z < 0.0f)
+        v = glm::vec3((1.0f - std::fabs(p.y)) * OctSignNotZero(p.x), (1.0f - std::fabs(p.x)) * OctSignNotZero(p.y), v.z);
+    return glm::normalize(v);
+}
+
+inline uint8_t PackBoneID(int id) {
+    if (id < 0)
+        return COMPACT_VERTEX_NO_BONE;
+    return (uint8_t) std::min<int>(id, COMPACT_VERTEX_MAX_BONE_ID);
+}
+
+inline int UnpackBoneID(uint8_t id) {
+    return id == COMPACT_VERTEX_NO_BONE ? -1 : id;
+}
+
+/**
+ * @brief quantizes weights to unorm, rounding so the quantized sum matches the rounded
+ * float sum; the difference goes to the largest weight
+ *
+ * @param weights
+ * @param out
+ */
+template <typename WeightT>
+void PackWeights(const float weights[MAX_BONE_INFLUENCE], WeightT out[MAX_BONE_INFLUENCE]) {
+    const float scale = (float) std::numeric_limits<WeightT>::max();
+    long sum = 0;
+    float float_sum = 0;
+    int largest = 0;
+    for (int k = 0; k < MAX_BONE_INFLUENCE; k++) {
+        float w = glm::clamp(weights[k], 0.0f, 1.0f);
+        out[k] = (WeightT) std::lround(w * scale);
+        sum += out[k];
+        float_sum += w;
+        if (weights[k] > weights[largest])
+            largest = k;
+    }
+    long target = std::lround(float_sum * scale);
+    long adjusted = (long) out[largest] + target - sum;
+    out[largest] = (WeightT) std::max(0L, std::min((long) scale, adjusted));
+}
+
+template <typename WeightT>
+CompactVertexT<WeightT> PackVertex(const Vertex& vertex) {
+    CompactVertexT<WeightT> packed;
+    packed.Position = vertex.Position;
+    OctEncode(vertex.Normal, packed.Normal);
+    OctEncode(vertex.Tangent, packed.Tangent);
+    packed.TexCoords[0] = glm::packHalf1x16(vertex.TexCoords.x);
+    packed.TexCoords[1] = glm::packHalf1x16(vertex.TexCoords.y);
+    for (int k = 0; k < MAX_BONE_INFLUENCE; k++)
+        packed.BoneIDs[k] = PackBoneID(vertex.m_BoneIDs[k]);
+    PackWeights(vertex.m_Weights, packed.Weights);
+    return packed;
+}
+
+/**
+ * @brief what the compact shader sees for a packed vertex, as a Vertex
+ */
+template <typename WeightT>
+Vertex UnpackVertex(const CompactVertexT<WeightT>& packed) {
+    const float scale = (float) std::numeric_limits<WeightT>::max();
+    Vertex vertex;
+    vertex.Position = packed.Position;
+    vertex.Normal = OctDecode(packed.Normal);
+    vertex.Tangent = OctDecode(packed.Tangent);
+    vertex.Bitangent = glm::cross(vertex.Normal, vertex.Tangent);
+    vertex.TexCoords = glm::vec2(glm::unpackHalf1x16(packed.TexCoords[0]), glm::unpackHalf1x16(packed.TexCoords[1]));
+    for (int k = 0; k < MAX_BONE_INFLUENCE; k++) {
+        vertex.m_BoneIDs[k] = UnpackBoneID(packed.BoneIDs[k]);
+        vertex.m_Weights[k] = packed.Weights[k] / scale;
+    }
+    return vertex;
+}
+
+template <typename WeightT>
+std::vector<CompactVertexT<WeightT>> PackVertices(const Vertex* vertices, size_t count) {
+    std::vector<CompactVertexT<WeightT>> packed(count);
+    for (size_t i = 0; i < count; i++)
+        packed[i] = PackVertex<WeightT>(vertices[i]);
+    return packed;
+}
+
+template <typename WeightT>
+std::vector<CompactVertexT<WeightT>> PackVertices(const std::vector<Vertex>& vertices) {
+    return PackVertices<WeightT>(vertices.data(), vertices.size());
+}
+
+/**
+ * A mesh's vertices as one array per attribute, the bitangent is left out (it is
+ * cross(normal, tangent) for the tangent spaces assimp generates).
+ */
+struct VertexSoA {
+    std::vector<glm::vec3> Positions;
+    std::vector<glm::vec3> Normals;
+    std::vector<glm::vec2> TexCoords;
+    std::vector<glm::vec3> Tangents;
+    std::vector<glm::ivec4> BoneIDs;
+    std::vector<glm::vec4> Weights;
+
+    VertexSoA() {}
+
+    explicit VertexSoA(const std::vector<Vertex>& vertices) : VertexSoA(vertices.data(), vertices.size()) {}
+
+    VertexSoA(const Vertex* vertices, size_t count) {
+        Positions.reserve(count);
+        Normals.reserve(count);
+        TexCoords.reserve(count);
+        Tangents.reserve(count);
+        BoneIDs.reserve(count);
+        Weights.reserve(count);
+        for (size_t i = 0; i < count; i++) {
+            const Vertex& v = vertices[i];
+            Positions.push_back(v.Position);
+            Normals.push_back(v.Normal);
+            TexCoords.push_back(v.TexCoords);
+            Tangents.push_back(v.Tangent);
+            BoneIDs.push_back(glm::ivec4(v.m_BoneIDs[0], v.m_BoneIDs[1], v.m_BoneIDs[2], v.m_BoneIDs[3]));
+            Weights.push_back(glm::vec4(v.m_Weights[0], v.m_Weights[1], v.m_Weights[2], v.m_Weights[3]));
+        }
+    }
+
+    size_t Size() const { return Positions.size(); }
+
+    size_t Bytes() const {
+        return Positions.capacity() * sizeof(glm::vec3) + Normals.capacity() * sizeof(glm::vec3) +
+            TexCoords.capacity() * sizeof(glm::vec2) + Tangents.capacity() * sizeof(glm::vec3) +
+            BoneIDs.capacity() * sizeof(glm::ivec4) + Weights.capacity() * sizeof(glm::vec4);
+    }
+
+    Vertex At(size_t i) const {
+        Vertex v;
+        v.Position = Positions[i];
+        v.Normal = Normals[i];
+        v.TexCoords = TexCoords[i];
+        v.Tangent = Tangents[i];
+        v.Bitangent = glm::cross(Normals[i], Tangents[i]);
+        for (int k = 0; k < MAX_BONE_INFLUENCE; k++) {
+            v.m_BoneIDs[k] = BoneIDs[i][k];
+            v.m_Weights[k] = Weights[i][k];
+        }
+        return v;
+    }
+
+    std::vector<Vertex> ToVertices() const {
+        std::vector<Vertex> vertices(Size());
+        for (size_t i = 0; i < vertices.size(); i++)
+            vertices[i] = At(i);
+        return vertices;
+    }
+};
+
+struct CompactVertexError {
+    double maxNormalDegrees = 0;
+    double maxTangentDegrees = 0;
+    // in UV units, multiply by the texture size for texels
+    double maxTexCoord = 0;
+    double maxWeight = 0;
+    // bone ids that decode to a different shader outcome, should be 0
+    size_t boneIDMismatches = 0;
+};
+
+// atan2 form, acos of a float dot product can not resolve the small angles measured here
+inline double AngleDegrees(glm::vec3 a, glm::vec3 b) {
+    glm::dvec3 da(a), db(b);
+    return std::atan2(glm::length(glm::cross(da, db)), glm::dot(da, db)) * 180.0 / 3.14159265358979323846;
+}
+
+/**
+ * @brief packs and unpacks every vertex and measures what the round trip lost. Tangents
+ * that were zero (not generated) are skipped.
+ *
+ * @param vertices
+ * @param maxBones the shader's MAX_BONES, ids at or past it only need to stay past it
+ * @return CompactVertexError
+ */
+template <typename WeightT>
+CompactVertexError MeasureCompactVertexError(const std::vector<Vertex>& vertices, int maxBones = 100) {
+    CompactVertexError error;
+    for (const Vertex& v : vertices) {
+        Vertex decoded = UnpackVertex(PackVertex<WeightT>(v));
+        error.maxNormalDegrees = std::max(error.maxNormalDegrees, AngleDegrees(v.Normal, decoded.Normal));
+        if (glm::dot(v.Tangent, v.Tangent) > 0)
+            error.maxTangentDegrees = std::max(error.maxTangentDegrees, AngleDegrees(v.Tangent, decoded.Tangent));
+        glm::vec2 uv = glm::abs(v.TexCoords - decoded.TexCoords);
+        error.maxTexCoord = std::max(error.maxTexCoord, (double) std::max(uv.x, uv.y));
+        for (int k = 0; k < MAX_BONE_INFLUENCE; k++) {
+            int id = v.m_BoneIDs[k];
+            int decodedID = decoded.m_BoneIDs[k];
+            bool same = id < 0 ? decodedID == -1 : (id >= maxBones ? decodedID >= maxBones : decodedID == id);
+            error.boneIDMismatches += !same;
+            error.maxWeight = std::max(error.maxWeight, (double) std::fabs(v.m_Weights[k] - decoded.m_Weights[k]));
+        }
+    }
+    return error;
+}
+
+#endif
@@ -0,0 +1,405 @@
+#ifndef CPU_SKINNER_H
+#define CPU_SKINNER_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+
+#include "Mesh.h"
+#include "work_stealing_pool.hpp"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define CPU_SKINNER_AVX2 1
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CPU_SKINNER_SSE2 1
+#endif
+
+// matches MAX_BONES in skeleton_animation.vert, ids at or past it leave the vertex unskinned
+const int CPU_SKINNER_MAX_BONES = 100;
+// vertices per kernel step, meshes are padded to a multiple of it
+const size_t CPU_SKINNER_LANES = 8;
+// vertices per pool chunk
+const size_t CPU_SKINNER_CHUNK = 4096;
+// palette slot holding the identity, where vertices the shader leaves unskinned point
+const int CPU_SKINNER_IDENTITY_SLOT = CPU_SKINNER_MAX_BONES;
+// floats between two matrix elements of the palette, the slots rounded up to the lanes
+const size_t CPU_SKINNER_PALETTE_STRIDE = (CPU_SKINNER_MAX_BONES + 1 + 7) / 8 * 8;
+
+enum CpuSkinningKernel {
+    CPU_SKINNING_SCALAR,
+    CPU_SKINNING_SSE2,
+    CPU_SKINNING_AVX2
+};
+
+const char* const CPU_SKINNING_KERNEL_NAMES[] = {"scalar", "sse2", "avx2"};
+
+/**
+ * @brief widest kernel this build was compiled with, -mavx2 (/arch:AVX2) enables AVX2
+ */
+inline CpuSkinningKernel CpuSkinningBestKernel() {
+#if defined(CPU_SKINNER_AVX2)
+    return CPU_SKINNING_AVX2;
+#elif defined(CPU_SKINNER_SSE2)
+    return CPU_SKINNING_SSE2;
+#else
+    return CPU_SKINNING_SCALAR;
+#endif
+}
+
+/**
+ * @brief skeleton_animation.vert's linear blend for one vertex, word for word: -1 ids are
+ * skipped, an id at or past MAX_BONES makes the result the bind position. The reference
+ * CpuSkinner is checked against.
+ *
+ * @param vertex
+ * @param palette final bone matrices, ids past its end read the identity
+ * @return totalPosition as the shader computes it, w is the sum of the applied weights
+ */
+glm::vec4 SkinVertexLikeShader(const Vertex& vertex, const std::vector<glm::mat4>& palette) {
+    glm::vec4 totalPosition(0.0f);
+    for (int i = 0; i < MAX_BONE_INFLUENCE; i++) {
+        int id = vertex.m_BoneIDs[i];
+        if (id == -1)
+            continue;
+        if (id >= CPU_SKINNER_MAX_BONES) {
+            totalPosition = glm::vec4(vertex.Position, 1.0f);
+            break;
+        }
+        glm::mat4 bone = id < (int) palette.size() ? palette[id] : glm::mat4(1.0f);
+        totalPosition += bone * glm::vec4(vertex.Position, 1.0f) * vertex.m_Weights[i];
+    }
+    return totalPosition;
+}
+
+/**
+ * Linear blend skinning on the CPU, the same blend skeleton_animation.vert does, for
+ * deforming meshes without a GPU (headless export, checking poses).
+ *
+ * AddMesh copies a mesh's positions, normals and bone influences into structure of arrays
+ * form once. The shader's id rules are resolved there: -1 influences get weight 0 and
+ * vertices with an id past MAX_BONES point all their weight at an identity slot, so the
+ * kernels are branch free multiply-adds over 8 vertices (AVX2 gathers, or two SSE2 halves).
+ * Bone matrices are taken as affine, the bottom row is not read. Skin() spreads meshes and
+ * CPU_SKINNER_CHUNK vertex chunks over a work_stealing_pool.
+ */
+class CpuSkinner {
+public:
+    explicit CpuSkinner(bool skinNormals = true) : skinNormals(skinNormals) {
+        std::vector<glm::mat4> identity;
+        SetPalette(identity);
+    }
+
+    /**
+     * @brief copies a mesh's vertices, e.g. Mesh::vertices filled by
+     * Model::ExtractBoneWeightForVertices
+     *
+     * @param vertices
+     * @return index of the mesh
+     */
+    size_t AddMesh(const std::vector<Vertex>& vertices) {
+        meshes.emplace_back();
+        SoaMesh& mesh = meshes.back();
+        mesh.vertexCount = vertices.size();
+        size_t padded = (vertices.size() + CPU_SKINNER_LANES - 1) / CPU_SKINNER_LANES * CPU_SKINNER_LANES;
+        for (int a = 0; a < SOA_ATTRIBUTES; a++) {
+            mesh.input[a].assign(padded, 0.0f);
+            mesh.output[a].assign(padded, 0.0f);
+        }
+        for (int k = 0; k < MAX_BONE_INFLUENCE; k++) {
+            mesh.ids[k].assign(padded, 0);
+            mesh.weights[k].assign(padded, 0.0f);
+        }
+
+        for (size_t v = 0; v < vertices.size(); v++) {
+            const Vertex& vertex = vertices[v];
+            mesh.input[0][v] = vertex.Position.x;
+            mesh.input[1][v] = vertex.Position.y;
+            mesh.input[2][v] = vertex.Position.z;
+            mesh.input[3][v] = vertex.Normal.x;
+            mesh.input[4][v] = vertex.Normal.y;
+            mesh.input[5][v] = vertex.Normal.z;
+
+            bool unskinned = false;
+            for (int k = 0; k < MAX_BONE_INFLUENCE; k++)
+                unskinned |= vertex.m_BoneIDs[k] >= CPU_SKINNER_MAX_BONES;
+            for (int k = 0; k < MAX_BONE_INFLUENCE; k++) {
+                int id = vertex.m_BoneIDs[k];
+                if (unskinned) {
+                    mesh.ids[k][v] = CPU_SKINNER_IDENTITY_SLOT;
+                    mesh.weights[k][v] = k == 0 ? 1.0f : 0.0f;
+                } else if (id >= 0) {
+                    mesh.ids[k][v] = id;
+                    mesh.weights[k][v] = vertex.m_Weights[k];
+                }
+            }
+        }
+
+        for (size_t begin = 0; begin < vertices.size(); begin += CPU_SKINNER_CHUNK)
+            chunks.push_back({meshes.size() - 1, begin, std::min(vertices.size(), begin + CPU_SKINNER_CHUNK)});
+        return meshes.size() - 1;
+    }
+
+    // a Model's meshes, from their vertices or MESH_KEEP_SOA copy; released meshes are empty
+    void AddMeshes(const std::vector<Mesh>& modelMeshes) {
+        for (const Mesh& mesh : modelMeshes)
+            AddMesh(mesh.Storage().cpuCopy == MESH_KEEP_SOA ? mesh.soa.ToVertices() : mesh.vertices);
+    }
+
+    /**
+     * @brief takes the bone matrices to skin with, e.g. Animator::GetFinalBoneMatrices().
+     * Like the BonePalette block only the first MAX_BONES are used, missing ones are the
+     * identity.
+     *
+     * @param matrices
+     */
+    void SetPalette(const std::vector<glm::mat4>& matrices) {
+        palette.assign(PALETTE_ELEMENTS * CPU_SKINNER_PALETTE_STRIDE, 0.0f);
+        for (int slot = 0; slot <= CPU_SKINNER_MAX_BONES; slot++) {
+            bool given = slot < CPU_SKINNER_MAX_BONES && slot < (int) matrices.size();
+            glm::mat4 bone = given ? matrices[slot] : glm::mat4(1.0f);
+            // row major 3x4, glm is column major
+            for (int row = 0; row < 3; row++)
+                for (int col = 0; col < 4; col++)
+                    palette[(row * 4 + col) * CPU_SKINNER_PALETTE_STRIDE + slot] = bone[col][row];
+        }
+    }
+
+    /**
+     * @brief skins every mesh with the current palette
+     *
+     * @param pool spreads chunks over its workers, runs inline when NULL
+     * @param kernel falls back to the best compiled kernel if this one was not compiled
+     */
+    void Skin(work_stealing_pool* pool = NULL, CpuSkinningKernel kernel = CpuSkinningBestKernel()) {
+        if (kernel > CpuSkinningBestKernel())
+            kernel = CpuSkinningBestKernel();
+        if (pool == NULL) {
+            for (const SkinChunk& chunk : chunks)
+                SkinRange(chunk, kernel);
+            return;
+        }
+        pool->parallel_for(chunks.size(), 1, [&](size_t begin, size_t end, unsigned int) {
+            for (size_t c = begin; c < end; c++)
+                SkinRange(chunks[c], kernel);
+        });
+    }
+
+    size_t MeshCount() const { return meshes.size(); }
+    size_t VertexCount(size_t mesh) const { return meshes[mesh].vertexCount; }
+
+    size_t TotalVertexCount() const {
+        size_t total = 0;
+        for (const SoaMesh& mesh : meshes)
+            total += mesh.vertexCount;
+        return total;
+    }
+
+    glm::vec3 Position(size_t mesh, size_t vertex) const {
+        const SoaMesh& m = meshes[mesh];
+        return glm::vec3(m.output[0][vertex], m.output[1][vertex], m.output[2][vertex]);
+    }
+
+    // unit length, the bind normal for unskinned vertices, zero when no bone applies
+    glm::vec3 Normal(size_t mesh, size_t vertex) const {
+        const SoaMesh& m = meshes[mesh];
+        return glm::vec3(m.output[3][vertex], m.output[4][vertex], m.output[5][vertex]);
+    }
+
+    /**
+     * @brief interleaves a mesh's skinned positions, 3 floats per vertex
+     *
+     * @param mesh
+     * @param xyz resized to VertexCount(mesh) * 3
+     */
+    void CopyPositions(size_t mesh, std::vector<float>& xyz) const {
+        const SoaMesh& m = meshes[mesh];
+        xyz.resize(m.vertexCount * 3);
+        for (size_t v = 0; v < m.vertexCount; v++) {
+            xyz[v*3] = m.output[0][v];
+            xyz[v*3 + 1] = m.output[1][v];
+            xyz[v*3 + 2] = m.output[2][v];
+        }
+    }
+
+private:
+    // position xyz then normal xyz
+    static const int SOA_ATTRIBUTES = 6;
+    // 3x4 affine part of a bone matrix
+    static const int PALETTE_ELEMENTS = 12;
+
+    struct SoaMesh {
+        size_t vertexCount = 0;
+        std::vector<float> input[SOA_ATTRIBUTES];
+        std::vector<float> output[SOA_ATTRIBUTES];
+        std::vector<int32_t> ids[MAX_BONE_INFLUENCE];
+        std::vector<float> weights[MAX_BONE_INFLUENCE];
+    };
+
+    struct SkinChunk {
+        size_t mesh;
+        size_t begin;
+        size_t end;
+    };
+
+    bool skinNormals;
+    std::vector<SoaMesh> meshes;
+    std::vector<SkinChunk> chunks;
+    // element major, element e of slot s at e * CPU_SKINNER_PALETTE_STRIDE + s
+    std::vector<float> palette;
+
+    void SkinRange(const SkinChunk& chunk, CpuSkinningKernel kernel) {
+        SoaMesh& mesh = meshes[chunk.mesh];
+        // chunks start on a multiple of the lanes, the last one runs into the padding
+        size_t end = (chunk.end + CPU_SKINNER_LANES - 1) / CPU_SKINNER_LANES * CPU_SKINNER_LANES;
+        for (size_t v = chunk.begin; v < end; v += CPU_SKINNER_LANES) {
+#if defined(CPU_SKINNER_AVX2)
+            if (kernel == CPU_SKINNING_AVX2) {
+                SkinAvx2(mesh, v);
+                continue;
+            }
+#endif
+#if defined(CPU_SKINNER_SSE2)
+            if (kernel == CPU_SKINNING_SSE2) {
+                SkinSse2(mesh, v);
+                SkinSse2(mesh, v + 4);
+                continue;
+            }
+#endif
+            for (size_t lane = 0; lane < CPU_SKINNER_LANES; lane++)
+                SkinScalar(mesh, v + lane);
+        }
+    }
+
+    const float* Element(int row, int col) const {
+        return palette.data() + (row * 4 + col) * CPU_SKINNER_PALETTE_STRIDE;
+    }
+
+    void SkinScalar(SoaMesh& mesh, size_t v) {
+        float in[SOA_ATTRIBUTES];
+        float out[SOA_ATTRIBUTES] = {0, 0, 0, 0, 0, 0};
+        for (int a = 0; a < SOA_ATTRIBUTES; a++)
+            in[a] = mesh.input[a][v];
+        for (int k = 0; k < MAX_BONE_INFLUENCE; k++) {
+            int id = mesh.ids[k][v];
+            float w = mesh.weights[k][v];
+            for (int row = 0; row < 3; row++) {
+                float m0 = Element(row, 0)[id], m1 = Element(row, 1)[id], m2 = Element(row, 2)[id];
+                out[row] += w * (m0 * in[0] + m1 * in[1] + m2 * in[2] + Element(row, 3)[id]);
+                out[3 + row] += w * (m0 * in[3] + m1 * in[4] + m2 * in[5]);
+            }
+        }
+        float length = std::sqrt(out[3] * out[3] + out[4] * out[4] + out[5] * out[5]);
+        float scale = length > 0 ? 1.0f / length : 0.0f;
+        for (int a = 0; a < 3; a++) {
+            mesh.output[a][v] = out[a];
+            if (skinNormals)
+                mesh.output[3 + a][v] = out[3 + a] * scale;
+        }
+    }
+
+#if defined(CPU_SKINNER_SSE2)
+    // 4 vertices, the palette is read with scalar loads since SSE2 has no gather
+    void SkinSse2(SoaMesh& mesh, size_t v) {
+        __m128 px = _mm_loadu_ps(&mesh.input[0][v]);
+        __m128 py = _mm_loadu_ps(&mesh.input[1][v]);
+        __m128 pz = _mm_loadu_ps(&mesh.input[2][v]);
+        __m128 nx = _mm_loadu_ps(&mesh.input[3][v]);
+        __m128 ny = _mm_loadu_ps(&mesh.input[4][v]);
+        __m128 nz = _mm_loadu_ps(&mesh.input[5][v]);
+        __m128 out[SOA_ATTRIBUTES];
+        for (int a = 0; a < SOA_ATTRIBUTES; a++)
+            out[a] = _mm_setzero_ps();
+
+        for (int k = 0; k < MAX_BONE_INFLUENCE; k++) {
+            const int32_t* id = &mesh.ids[k][v];
+            __m128 w = _mm_loadu_ps(&mesh.weights[k][v]);
+            for (int row = 0; row < 3; row++) {
+                const float* e0 = Element(row, 0);
+                const float* e1 = Element(row, 1);
+                const float* e2 = Element(row, 2);
+                const float* e3 = Element(row, 3);
+                __m128 m0 = _mm_setr_ps(e0[id[0]], e0[id[1]], e0[id[2]], e0[id[3]]);
+                __m128 m1 = _mm_setr_ps(e1[id[0]], e1[id[1]], e1[id[2]], e1[id[3]]);
+                __m128 m2 = _mm_setr_ps(e2[id[0]], e2[id[1]], e2[id[2]], e2[id[3]]);
+                __m128 m3 = _mm_setr_ps(e3[id[0]], e3[id[1]], e3[id[2]], e3[id[3]]);
+                __m128 p = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m0, px), _mm_mul_ps(m1, py)),
+                    _mm_add_ps(_mm_mul_ps(m2, pz), m3));
+                out[row] = _mm_add_ps(out[row], _mm_mul_ps(w, p));
+                if (skinNormals) {
+                    __m128 n = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m0, nx), _mm_mul_ps(m1, ny)), _mm_mul_ps(m2, nz));
+                    out[3 + row] = _mm_add_ps(out[3 + row], _mm_mul_ps(w, n));
+                }
+            }
+        }
+
+        for (int a = 0; a < 3; a++)
+            _mm_storeu_ps(&mesh.output[a][v], out[a]);
+        if (skinNormals) {
+            __m128 length_sq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(out[3], out[3]), _mm_mul_ps(out[4], out[4])),
+                _mm_mul_ps(out[5], out[5]));
+            __m128 nonzero = _mm_cmpgt_ps(length_sq, _mm_setzero_ps());
+            __m128 scale = _mm_and_ps(nonzero, _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(length_sq)));
+            for (int a = 3; a < SOA_ATTRIBUTES; a++)
+                _mm_storeu_ps(&mesh.output[a][v], _mm_mul_ps(out[a], scale));
+        }
+    }
+#endif
+
+#if defined(CPU_SKINNER_AVX2)
+    static __m256 MulAdd(__m256 a, __m256 b, __m256 c) {
+#if defined(__FMA__)
+        return _mm256_fmadd_ps(a, b, c);
+#else
+        return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+#endif
+    }
+
+    // 8 vertices, the palette elements of each influence are gathered by bone id
+    void SkinAvx2(SoaMesh& mesh, size_t v) {
+        __m256 px = _mm256_loadu_ps(&mesh.input[0][v]);
+        __m256 py = _mm256_loadu_ps(&mesh.input[1][v]);
+        __m256 pz = _mm256_loadu_ps(&mesh.input[2][v]);
+        __m256 nx = _mm256_loadu_ps(&mesh.input[3][v]);
+        __m256 ny = _mm256_loadu_ps(&mesh.input[4][v]);
+        __m256 nz = _mm256_loadu_ps(&mesh.input[5][v]);
+        __m256 out[SOA_ATTRIBUTES];
+        for (int a = 0; a < SOA_ATTRIBUTES; a++)
+            out[a] = _mm256_setzero_ps();
+
+        for (int k = 0; k < MAX_BONE_INFLUENCE; k++) {
+            __m256i id = _mm256_loadu_si256((const __m256i*) &mesh.ids[k][v]);
+            __m256 w = _mm256_loadu_ps(&mesh.weights[k][v]);
+            for (int row = 0; row < 3; row++) {
+                __m256 m0 = _mm256_i32gather_ps(Element(row, 0), id, 4);
+                __m256 m1 = _mm256_i32gather_ps(Element(row, 1), id, 4);
+                __m256 m2 = _mm256_i32gather_ps(Element(row, 2), id, 4);
+                __m256 m3 = _mm256_i32gather_ps(Element(row, 3), id, 4);
+                __m256 p = MulAdd(m0, px, MulAdd(m1, py, MulAdd(m2, pz, m3)));
+                out[row] = MulAdd(w, p, out[row]);
+                if (skinNormals) {
+                    __m256 n = MulAdd(m0, nx, MulAdd(m1, ny, _mm256_mul_ps(m2, nz)));
+                    out[3 + row] = MulAdd(w, n, out[3 + row]);
+                }
+            }
+        }
+
+        for (int a = 0; a < 3; a++)
+            _mm256_storeu_ps(&mesh.output[a][v], out[a]);
+        if (skinNormals) {
+            __m256 length_sq = MulAdd(out[3], out[3], MulAdd(out[4], out[4], _mm256_mul_ps(out[5], out[5])));
+            __m256 nonzero = _mm256_cmp_ps(length_sq, _mm256_setzero_ps(), _CMP_GT_OQ);
+            __m256 scale = _mm256_and_ps(nonzero, _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_sqrt_ps(length_sq)));
+            for (int a = 3; a < SOA_ATTRIBUTES; a++)
+                _mm256_storeu_ps(&mesh.output[a][v], _mm256_mul_ps(out[a], scale));
+        }
+    }
+#endif
+};
+
+#endif
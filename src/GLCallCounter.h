@@ -0,0 +1,31 @@
+#ifndef GL_CALL_COUNTER_H
+#define GL_CALL_COUNTER_H
+
+#include <cstdint>
+
+/**
+ * Counts the GL calls a frame makes (state, uniform, buffer and draw calls in Shader, Mesh,
+ * StreamingBuffer, BonePaletteBuffer and the render loop), so a frame's cost in driver round
+ * trips can be printed next to its time. glGetError checks are not counted. EndFrame() is
+ * called once per rendered frame.
+ */
+struct GLCallCounter {
+    uint64_t total = 0;
+    uint64_t lastFrame = 0;
+    uint64_t frameStart = 0;
+
+    void Add(unsigned int calls = 1) { total += calls; }
+
+    void EndFrame() {
+        lastFrame = total - frameStart;
+        frameStart = total;
+    }
+};
+
+GLCallCounter glCalls;
+
+// makes one gl call and counts it, the value of the call is passed through:
+// GL_COUNTED(glBindVertexArray(VAO)); GLsync fence = GL_COUNTED(glFenceSync(...));
+#define GL_COUNTED(call) (glCalls.Add(), (call))
+
+#endif
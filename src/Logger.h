@@ -0,0 +1,124 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+enum LogLevel {
+    LOG_LEVEL_DEBUG,
+    LOG_LEVEL_INFO,
+    LOG_LEVEL_WARN,
+    LOG_LEVEL_ERROR,
+    LOG_LEVEL_OFF
+};
+
+const char* const LOG_LEVEL_PREFIXES[LOG_LEVEL_OFF] = {"DEBUG: ", "", "WARNING: ", "ERROR: "};
+
+/**
+ * Leveled logger that writes on its own thread. The calling thread only checks the level
+ * and, when it passes, formats the message and queues it; the console write happens on
+ * the logger thread. Messages below the level are never formatted (see the LOG_ macros).
+ */
+class Logger {
+public:
+    Logger() {}
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+
+    ~Logger() {
+        Shutdown();
+    }
+
+    void SetLevel(LogLevel newLevel) { level.store(newLevel, std::memory_order_relaxed); }
+    LogLevel Level() const { return level.load(std::memory_order_relaxed); }
+    bool Enabled(LogLevel messageLevel) const { return messageLevel >= Level(); }
+
+    void Push(LogLevel messageLevel, std::string message) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping)
+            return;
+        if (!writer.joinable())
+            writer = std::thread(&Logger::Run, this);
+        message.insert(0, LOG_LEVEL_PREFIXES[messageLevel]);
+        pending.push_back(std::move(message));
+        wake.notify_one();
+    }
+
+    // blocks until everything queued so far is written
+    void Flush() {
+        std::unique_lock<std::mutex> lock(mutex);
+        drained.wait(lock, [&]() { return pending.empty() && !writing; });
+    }
+
+    // writes what is left and stops the logger thread, later messages are dropped
+    void Shutdown() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+            wake.notify_one();
+        }
+        if (writer.joinable())
+            writer.join();
+    }
+
+private:
+    std::atomic<LogLevel> level{LOG_LEVEL_INFO};
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable drained;
+    std::vector<std::string> pending;
+    std::thread writer;
+    bool stopping = false;
+    bool writing = false;
+
+    void Run() {
+        std::vector<std::string> batch;
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            wake.wait(lock, [&]() { return stopping || !pending.empty(); });
+            if (pending.empty() && stopping)
+                break;
+            batch.swap(pending);
+            writing = true;
+            lock.unlock();
+
+            std::string text;
+            for (const std::string& message : batch) {
+                text += message;
+                text += '\n';
+            }
+            std::cout << text;
+            std::cout.flush();
+            batch.clear();
+
+            lock.lock();
+            writing = false;
+            drained.notify_all();
+        }
+        drained.notify_all();
+    }
+};
+
+Logger logger;
+
+#define LOG_AT(messageLevel, expression) \
+    do { \
+        if (logger.Enabled(messageLevel)) { \
+            std::ostringstream logStream; \
+            logStream << expression; \
+            logger.Push(messageLevel, logStream.str()); \
+        } \
+    } while (0)
+
+#define LOG_DEBUG(expression) LOG_AT(LOG_LEVEL_DEBUG, expression)
+#define LOG_INFO(expression) LOG_AT(LOG_LEVEL_INFO, expression)
+#define LOG_WARN(expression) LOG_AT(LOG_LEVEL_WARN, expression)
+#define LOG_ERROR(expression) LOG_AT(LOG_LEVEL_ERROR, expression)
+
+#endif
@@ -10,24 +10,11 @@
 #include <vector>
 
 #include "Shader.h"
+#include "Vertex.h"
+#include "CompactVertex.h"
 
 const int BASE_SHINY_MULTIPLE = 128;
 
-#define MAX_BONE_INFLUENCE 4
-struct Vertex {
-    glm::vec3 Position;
-    glm::vec3 Normal;
-    glm::vec2 TexCoords;
-    // tangent
-    glm::vec3 Tangent;
-    // bitangent
-    glm::vec3 Bitangent;
-    //bone indexes which will influence this vertex
-    int m_BoneIDs[MAX_BONE_INFLUENCE];
-    //weights from each bone
-    float m_Weights[MAX_BONE_INFLUENCE];
-};
-
 struct Texture {
     unsigned int id;
     std::string type;
@@ -41,39 +28,67 @@ class Mesh {
         std::vector<Vertex> vertices;
         std::vector<unsigned int> indices;
         std::vector<Texture> textures;
+        // CPU copy kept with MESH_KEEP_SOA, vertices is empty then
+        VertexSoA soa;
+
+        Mesh (std::vector<Vertex> vertices, std::vector<Texture> textures, std::vector<unsigned int> indices,
+              MeshStorage storage = MeshStorage())
+            : vertices(std::move(vertices)), indices(std::move(indices)), textures(std::move(textures)), storage(storage)
+        {
+            vertexCount = this->vertices.size();
+            indexCount = this->indices.size();
+
+            setupMesh(this->vertices.data(), this->indices.data());
+            ReleaseCpuCopies();
+        }
+
+        /* uploads straight from arrays the mesh does not own (e.g. a mapped model cache),
+        CPU copies are only made for what storage.cpuCopy keeps*/
+        Mesh (const Vertex* vertexData, size_t vertexCount, const unsigned int* indexData, size_t indexCount,
+              std::vector<Texture> textures, MeshStorage storage = MeshStorage())
+            : textures(std::move(textures)), storage(storage), vertexCount(vertexCount), indexCount(indexCount)
+        {
+            setupMesh(vertexData, indexData);
+            if (storage.cpuCopy == MESH_KEEP_VERTICES)
+                vertices.assign(vertexData, vertexData + vertexCount);
+            else if (storage.cpuCopy == MESH_KEEP_SOA)
+                soa = VertexSoA(vertexData, vertexCount);
+            if (storage.cpuCopy != MESH_RELEASE_CPU)
+                indices.assign(indexData, indexData + indexCount);
+        }
+
+        const MeshStorage& Storage() const { return storage; }
+        size_t VertexCount() const { return vertexCount; }
+        size_t IndexCount() const { return indexCount; }
 
-        Mesh (std::vector<Vertex> vertices, std::vector<Texture> textures, std::vector<unsigned int> indices) {
-            this->vertices = vertices;
-            this->textures = textures;
-            this->indices = indices;
+        // bytes kept on the CPU for vertices and indices
+        size_t CpuBytes() const {
+            return vertices.capacity() * sizeof(Vertex) + soa.Bytes() + indices.capacity() * sizeof(unsigned int);
+        }
 
-            setupMesh();
+        // bytes uploaded into the vertex and index buffers
+        size_t GpuBytes() const {
+            return vertexCount * vertexStride + indexCount * sizeof(unsigned int);
         }
 
         void Draw(Shader &shader) 
         {
-            unsigned int diffuseNr = 1;
-            unsigned int specularNr = 1;
+            // sampler names only change with the shader, resolve them once per program
+            if (textureUniformsProgram != shader.ID || textureUniforms.size() != textures.size())
+                CacheTextureUniforms(shader);
+
             for(unsigned int i = 0; i < textures.size(); i++)
             {
-                glActiveTexture(GL_TEXTURE0 + i); // activate proper texture unit before binding
-                // retrieve texture number (the N in diffuse_textureN)
-                std::string number;
-                std::string name = textures[i].type;
-                if(name == "texture_diffuse")
-                    number = std::to_string(diffuseNr++);
-                else if(name == "texture_specular")
-                    number = std::to_string(specularNr++);
-
-                shader.setInt(("material." + name + number).c_str(), i);
-                glBindTexture(GL_TEXTURE_2D, textures[i].id);
+                GL_COUNTED(glActiveTexture(GL_TEXTURE0 + i)); // activate proper texture unit before binding
+                shader.setInt(textureUniforms[i], i);
+                GL_COUNTED(glBindTexture(GL_TEXTURE_2D, textures[i].id));
             }
-            glActiveTexture(GL_TEXTURE0);
+            GL_COUNTED(glActiveTexture(GL_TEXTURE0));
 
             // draw mesh
-            glBindVertexArray(VAO);
-            glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-            glBindVertexArray(0);
+            GL_COUNTED(glBindVertexArray(VAO));
+            GL_COUNTED(glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0));
+            GL_COUNTED(glBindVertexArray(0));
 
             GLenum e = glGetError();
             if (e != GL_NO_ERROR) {
@@ -85,20 +100,65 @@ class Mesh {
     private:
         // render data
         unsigned int VAO, VBO, EBO;
+        MeshStorage storage;
+        size_t vertexCount = 0;
+        size_t indexCount = 0;
+        size_t vertexStride = sizeof(Vertex);
+        // sampler uniform location per texture, valid for textureUniformsProgram
+        std::vector<int> textureUniforms;
+        unsigned int textureUniformsProgram = 0;
+
+        /* resolves "material.texture_diffuseN" style sampler names to locations in shader*/
+        void CacheTextureUniforms(const Shader &shader) {
+            unsigned int diffuseNr = 1;
+            unsigned int specularNr = 1;
+            textureUniforms.resize(textures.size());
+            for(unsigned int i = 0; i < textures.size(); i++)
+            {
+                // retrieve texture number (the N in diffuse_textureN)
+                std::string number;
+                std::string name = textures[i].type;
+                if(name == "texture_diffuse")
+                    number = std::to_string(diffuseNr++);
+                else if(name == "texture_specular")
+                    number = std::to_string(specularNr++);
 
-        void setupMesh() {
+                textureUniforms[i] = shader.GetUniformLocation("material." + name + number);
+            }
+            textureUniformsProgram = shader.ID;
+        }
+
+        void setupMesh(const Vertex* vertexData, const unsigned int* indexData) {
             glGenVertexArrays(1, &VAO);
             glGenBuffers(1, &VBO);
             glGenBuffers(1, &EBO);
             glBindVertexArray(VAO);
             glBindBuffer(GL_ARRAY_BUFFER, VBO);
-            
-            
-            glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
 
             glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), 
-                        &indices[0], GL_STATIC_DRAW);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(unsigned int), 
+                        indexData, GL_STATIC_DRAW);
+
+            if (storage.layout == MESH_LAYOUT_COMPACT) {
+                if (storage.weights8)
+                    SetupCompactAttributes<uint8_t>(vertexData, GL_UNSIGNED_BYTE);
+                else
+                    SetupCompactAttributes<uint16_t>(vertexData, GL_UNSIGNED_SHORT);
+            } else {
+                SetupFullAttributes(vertexData);
+            }
+            glBindVertexArray(0);
+        
+            GLenum e = glGetError();
+            if (e != GL_NO_ERROR) {
+                fprintf(stderr, "OpenGL error in \"%s\": %d (%d)\n", "mesh setup", e, e);
+                exit(20);
+            }
+        }
+
+        void SetupFullAttributes(const Vertex* vertexData) {
+            vertexStride = sizeof(Vertex);
+            glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(Vertex), vertexData, GL_STATIC_DRAW);
             // set the vertex attribute pointers
             // vertex Positions
             glEnableVertexAttribArray(0);	
@@ -122,13 +182,41 @@ class Mesh {
             // weights
             glEnableVertexAttribArray(6);
             glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, m_Weights));
-            glBindVertexArray(0);
-        
-            GLenum e = glGetError();
-            if (e != GL_NO_ERROR) {
-                fprintf(stderr, "OpenGL error in \"%s\": %d (%d)\n", "mesh setup", e, e);
-                exit(20);
-            }
+        }
+
+        /* packs the vertices (see CompactVertex.h), read by skeleton_animation_compact*/
+        template <typename WeightT>
+        void SetupCompactAttributes(const Vertex* vertexData, GLenum weightType) {
+            typedef CompactVertexT<WeightT> Packed;
+            std::vector<Packed> packed = PackVertices<WeightT>(vertexData, vertexCount);
+            vertexStride = sizeof(Packed);
+            glBufferData(GL_ARRAY_BUFFER, packed.size() * sizeof(Packed), packed.data(), GL_STATIC_DRAW);
+
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Packed), (void*)offsetof(Packed, Position));
+            // octahedral normal
+            glEnableVertexAttribArray(1);
+            glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(Packed), (void*)offsetof(Packed, Normal));
+            glEnableVertexAttribArray(2);
+            glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(Packed), (void*)offsetof(Packed, TexCoords));
+            // octahedral tangent, there is no bitangent attribute (4)
+            glEnableVertexAttribArray(3);
+            glVertexAttribPointer(3, 2, GL_SHORT, GL_TRUE, sizeof(Packed), (void*)offsetof(Packed, Tangent));
+            glEnableVertexAttribArray(5);
+            glVertexAttribIPointer(5, 4, GL_UNSIGNED_BYTE, sizeof(Packed), (void*)offsetof(Packed, BoneIDs));
+            glEnableVertexAttribArray(6);
+            glVertexAttribPointer(6, 4, weightType, GL_TRUE, sizeof(Packed), (void*)offsetof(Packed, Weights));
+        }
+
+        /* frees what storage.cpuCopy does not keep, the buffers have their own copy*/
+        void ReleaseCpuCopies() {
+            if (storage.cpuCopy == MESH_KEEP_VERTICES)
+                return;
+            if (storage.cpuCopy == MESH_KEEP_SOA)
+                soa = VertexSoA(vertices);
+            else
+                std::vector<unsigned int>().swap(indices);
+            std::vector<Vertex>().swap(vertices);
         }
 };
 
@@ -0,0 +1,762 @@
+#ifndef MODEL_CACHE_H
+#define MODEL_CACHE_H
+
+#include <glm/glm.hpp>
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "AssimpGLMHelpers.h"
+#include "Bone.hpp"
+#include "Vertex.h"
+#include "animdata.h"
+#include "mapped_file.hpp"
+
+/*
+ * Baked model cache (.vbake), written next to the source file. One assimp import of a
+ * model is flattened into a single file that is memory mapped on the next start; vertex,
+ * index and keyframe arrays are used straight out of the mapping. All values little endian:
+ *
+ *  ModelCacheHeader
+ *  meshes      count, then per mesh: vertex / index / texture counts, texture (type, path)
+ *              strings, Vertex array, unsigned int index array
+ *  bones       bone counter, count, then per bone: name, id, offset matrix
+ *  hierarchy   count, then nodes parents first (depth first): name, transformation,
+ *              children count
+ *  clips       count, then per clip: name, duration, ticks per second, channel count, then
+ *              per channel: name, bone id, position / rotation / scale key arrays
+ *
+ * strings are a uint32_t length and the bytes, arrays are a uint32_t count and start on a
+ * 16 byte boundary. The cache is only used when its header matches the source file's hash
+ * and size, the import flags and the struct sizes of this build, anything else re-bakes.
+ */
+
+// what Model and Animation import with, Model(path) and the cache both use it
+const unsigned int MODEL_IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_CalcTangentSpace;
+
+const char MODEL_CACHE_MAGIC[4] = {'V', 'B', 'A', 'K'};
+const uint32_t MODEL_CACHE_VERSION = 1;
+const std::string MODEL_CACHE_EXTENSION = ".vbake";
+
+/* identifies the source a cache was baked from*/
+struct ModelCacheKey
+{
+    uint64_t sourceHash = 0;
+    uint64_t sourceSize = 0;
+    uint32_t importFlags = 0;
+};
+
+struct ModelCacheHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t importFlags;
+    // layouts of the raw arrays, a build with different structs re-bakes
+    uint32_t vertexSize;
+    uint32_t keyPositionSize;
+    uint32_t keyRotationSize;
+    uint32_t keyScaleSize;
+    uint32_t reserved;
+    uint64_t sourceHash;
+    uint64_t sourceSize;
+    uint64_t fileSize;
+};
+
+/* a read only array owned by a ModelImport or a ModelCache*/
+template <typename T>
+struct ArrayView
+{
+    const T* data = nullptr;
+    size_t size = 0;
+
+    ArrayView() {}
+    ArrayView(const T* data, size_t size) : data(data), size(size) {}
+    ArrayView(const std::vector<T>& vector) : data(vector.data()), size(vector.size()) {}
+
+    const T* begin() const { return data; }
+    const T* end() const { return data + size; }
+    const T& operator[](size_t i) const { return data[i]; }
+    std::vector<T> ToVector() const { return std::vector<T>(begin(), end()); }
+};
+
+struct TextureRef
+{
+    // texture_diffuse, texture_specular, texture_normal or texture_height
+    std::string type;
+    // as written in the material, relative to the model's directory
+    std::string path;
+};
+
+struct MeshView
+{
+    ArrayView<Vertex> vertices;
+    ArrayView<unsigned int> indices;
+    std::vector<TextureRef> textures;
+};
+
+struct ModelNode
+{
+    std::string name;
+    glm::mat4 transformation;
+    int childrenCount;
+};
+
+struct ChannelView
+{
+    std::string name;
+    int boneID;
+    ArrayView<KeyPosition> positions;
+    ArrayView<KeyRotation> rotations;
+    ArrayView<KeyScale> scales;
+};
+
+struct ClipView
+{
+    std::string name;
+    float duration;
+    int ticksPerSecond;
+    std::vector<ChannelView> channels;
+};
+
+/* everything Model and Animation are built from, the arrays belong to whoever handed
+this out and stay valid as long as it lives*/
+struct ModelData
+{
+    std::string directory;
+    std::vector<MeshView> meshes;
+    // every bone of the meshes and of the clips' channels, ids are final matrix slots
+    std::shared_ptr<const BoneRegistry> bones;
+    // assimp's node tree, parents first
+    std::vector<ModelNode> nodes;
+    std::vector<ClipView> clips;
+};
+
+/* the directory part of a model path, textures are relative to it*/
+inline std::string ModelDirectory(const std::string& path)
+{
+    return path.substr(0, path.find_last_of('/'));
+}
+
+/**
+ * One assimp pass over a model file: meshes with their bone weights, the bone registry,
+ * the node hierarchy and every animation in the file. Bones only named by a channel are
+ * registered after the meshes' bones, in clip and channel order, so a model's meshes and
+ * all its clips index one BoneRegistry.
+ */
+class ModelImport
+{
+public:
+    bool Read(const std::string& path, unsigned int importFlags = MODEL_IMPORT_FLAGS)
+    {
+        Assimp::Importer importer;
+        const aiScene* scene = importer.ReadFile(path, importFlags);
+        if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
+        {
+            std::cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << std::endl;
+            return false;
+        }
+
+        data = ModelData();
+        vertexArrays.clear();
+        indexArrays.clear();
+        clipBones.clear();
+        registry = std::make_shared<BoneRegistry>();
+        data.directory = ModelDirectory(path);
+        data.bones = registry;
+
+        ReadNode(scene->mRootNode, scene);
+        ReadHierarchy(scene->mRootNode);
+        for (unsigned int i = 0; i < scene->mNumAnimations; i++)
+            ReadClip(scene->mAnimations[i]);
+
+        // the views are taken last, the vectors behind them do not move anymore
+        for (size_t i = 0; i < data.meshes.size(); i++)
+        {
+            data.meshes[i].vertices = ArrayView<Vertex>(vertexArrays[i]);
+            data.meshes[i].indices = ArrayView<unsigned int>(indexArrays[i]);
+        }
+        for (size_t c = 0; c < data.clips.size(); c++)
+        {
+            for (const Bone& bone : clipBones[c])
+            {
+                ChannelView channel;
+                channel.name = bone.GetBoneName();
+                channel.boneID = bone.GetBoneID();
+                channel.positions = ArrayView<KeyPosition>(bone.GetPositionKeys());
+                channel.rotations = ArrayView<KeyRotation>(bone.GetRotationKeys());
+                channel.scales = ArrayView<KeyScale>(bone.GetScaleKeys());
+                data.clips[c].channels.push_back(channel);
+            }
+        }
+        return true;
+    }
+
+    const ModelData& Data() const { return data; }
+
+private:
+    ModelData data;
+    std::vector<std::vector<Vertex>> vertexArrays;
+    std::vector<std::vector<unsigned int>> indexArrays;
+    std::vector<std::vector<Bone>> clipBones;
+    // data.bones, writable while reading
+    std::shared_ptr<BoneRegistry> registry;
+
+    // meshes in the order Model has always created them, node by node
+    void ReadNode(const aiNode* node, const aiScene* scene)
+    {
+        for (unsigned int i = 0; i < node->mNumMeshes; i++)
+            ReadMesh(scene->mMeshes[node->mMeshes[i]], scene);
+        for (unsigned int i = 0; i < node->mNumChildren; i++)
+            ReadNode(node->mChildren[i], scene);
+    }
+
+    void ReadMesh(const aiMesh* mesh, const aiScene* scene)
+    {
+        std::vector<Vertex> vertices(mesh->mNumVertices);
+        for (unsigned int i = 0; i < mesh->mNumVertices; i++)
+        {
+            Vertex& vertex = vertices[i];
+            for (int k = 0; k < MAX_BONE_INFLUENCE; k++)
+            {
+                vertex.m_BoneIDs[k] = -1;
+                vertex.m_Weights[k] = 0.0f;
+            }
+            vertex.Position = AssimpGLMHelpers::GetGLMVec(mesh->mVertices[i]);
+            vertex.Normal = AssimpGLMHelpers::GetGLMVec(mesh->mNormals[i]);
+
+            if (mesh->mTextureCoords[0])
+                vertex.TexCoords = glm::vec2(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y);
+            else
+                vertex.TexCoords = glm::vec2(0.0f, 0.0f);
+
+            // generated by aiProcess_CalcTangentSpace when the mesh has texture coordinates
+            if (mesh->mTangents && mesh->mBitangents)
+            {
+                vertex.Tangent = AssimpGLMHelpers::GetGLMVec(mesh->mTangents[i]);
+                vertex.Bitangent = AssimpGLMHelpers::GetGLMVec(mesh->mBitangents[i]);
+            }
+            else
+            {
+                vertex.Tangent = glm::vec3(0.0f);
+                vertex.Bitangent = glm::vec3(0.0f);
+            }
+        }
+
+        std::vector<unsigned int> indices;
+        indices.reserve(mesh->mNumFaces * 3);
+        for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+        {
+            const aiFace& face = mesh->mFaces[i];
+            indices.insert(indices.end(), face.mIndices, face.mIndices + face.mNumIndices);
+        }
+
+        MeshView view;
+        const aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+        ReadTextures(material, aiTextureType_DIFFUSE, "texture_diffuse", view.textures);
+        ReadTextures(material, aiTextureType_SPECULAR, "texture_specular", view.textures);
+        ReadTextures(material, aiTextureType_HEIGHT, "texture_normal", view.textures);
+        ReadTextures(material, aiTextureType_AMBIENT, "texture_height", view.textures);
+
+        ReadBoneWeights(vertices, mesh);
+
+        vertexArrays.push_back(std::move(vertices));
+        indexArrays.push_back(std::move(indices));
+        data.meshes.push_back(view);
+    }
+
+    static void ReadTextures(const aiMaterial* material, aiTextureType type, const char* typeName,
+        std::vector<TextureRef>& textures)
+    {
+        for (unsigned int i = 0; i < material->GetTextureCount(type); i++)
+        {
+            aiString path;
+            material->GetTexture(type, i, &path);
+            textures.push_back({typeName, path.C_Str()});
+        }
+    }
+
+    void ReadBoneWeights(std::vector<Vertex>& vertices, const aiMesh* mesh)
+    {
+        for (unsigned int boneIndex = 0; boneIndex < mesh->mNumBones; ++boneIndex)
+        {
+            const aiBone* bone = mesh->mBones[boneIndex];
+            std::string boneName = bone->mName.C_Str();
+            auto found = registry->bones.find(boneName);
+            int boneID;
+            if (found == registry->bones.end())
+            {
+                BoneInfo newBoneInfo;
+                newBoneInfo.id = registry->count;
+                newBoneInfo.offset = AssimpGLMHelpers::ConvertMatrixToGLMFormat(bone->mOffsetMatrix);
+                registry->bones[boneName] = newBoneInfo;
+                boneID = registry->count++;
+            }
+            else
+            {
+                boneID = found->second.id;
+            }
+
+            for (unsigned int weightIndex = 0; weightIndex < bone->mNumWeights; ++weightIndex)
+            {
+                unsigned int vertexId = bone->mWeights[weightIndex].mVertexId;
+                assert(vertexId < vertices.size());
+                Vertex& vertex = vertices[vertexId];
+                // the first free influence slot, weights past MAX_BONE_INFLUENCE are dropped
+                for (int k = 0; k < MAX_BONE_INFLUENCE; ++k)
+                {
+                    if (vertex.m_BoneIDs[k] < 0)
+                    {
+                        vertex.m_Weights[k] = bone->mWeights[weightIndex].mWeight;
+                        vertex.m_BoneIDs[k] = boneID;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    void ReadHierarchy(const aiNode* node)
+    {
+        ModelNode flat;
+        flat.name = node->mName.data;
+        flat.transformation = AssimpGLMHelpers::ConvertMatrixToGLMFormat(node->mTransformation);
+        flat.childrenCount = node->mNumChildren;
+        data.nodes.push_back(flat);
+        for (unsigned int i = 0; i < node->mNumChildren; i++)
+            ReadHierarchy(node->mChildren[i]);
+    }
+
+    void ReadClip(const aiAnimation* animation)
+    {
+        ClipView clip;
+        clip.name = animation->mName.C_Str();
+        clip.duration = animation->mDuration;
+        clip.ticksPerSecond = animation->mTicksPerSecond;
+        data.clips.push_back(clip);
+
+        std::vector<Bone> bones;
+        for (unsigned int i = 0; i < animation->mNumChannels; i++)
+        {
+            const aiNodeAnim* channel = animation->mChannels[i];
+            std::string boneName = channel->mNodeName.data;
+            if (registry->bones.find(boneName) == registry->bones.end())
+                registry->bones[boneName].id = registry->count++;
+            bones.push_back(Bone(boneName, registry->bones[boneName].id, channel));
+        }
+        clipBones.push_back(std::move(bones));
+    }
+};
+
+/**
+ * @brief FNV-1a over the file's 8 byte words and then its tail bytes, with its size it
+ * keys the cache to the exact source file
+ *
+ * @param path
+ * @param key sourceHash and sourceSize are set
+ * @return false when the file cannot be mapped
+ */
+bool HashModelSource(const std::string& path, ModelCacheKey& key)
+{
+    mapped_file file;
+    if (!file.open(path))
+        return false;
+
+    const uint64_t prime = 1099511628211ull;
+    uint64_t hash = 14695981039346656037ull;
+    const unsigned char* bytes = file.bytes();
+    size_t words = file.size() / 8;
+    for (size_t i = 0; i < words; i++)
+    {
+        uint64_t word;
+        std::memcpy(&word, bytes + i * 8, 8);
+        hash = (hash ^ word) * prime;
+    }
+    for (size_t i = words * 8; i < file.size(); i++)
+        hash = (hash ^ bytes[i]) * prime;
+
+    key.sourceHash = hash;
+    key.sourceSize = file.size();
+    return true;
+}
+
+class ModelCacheWriter
+{
+public:
+    std::vector<unsigned char> buffer;
+
+    template <typename T>
+    void Put(const T& value)
+    {
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&value);
+        buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+    }
+
+    void PutString(const std::string& text)
+    {
+        Put<uint32_t>(text.size());
+        buffer.insert(buffer.end(), text.begin(), text.end());
+    }
+
+    template <typename T>
+    void PutArray(const ArrayView<T>& values)
+    {
+        Put<uint32_t>(values.size);
+        buffer.resize((buffer.size() + 15) & ~size_t(15), 0);
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(values.data);
+        buffer.insert(buffer.end(), bytes, bytes + values.size * sizeof(T));
+    }
+};
+
+/* bounds checked cursor over a mapped cache, a short read leaves ok false*/
+class ModelCacheReader
+{
+public:
+    bool ok = true;
+
+    ModelCacheReader(const unsigned char* bytes, size_t size, size_t offset) : bytes(bytes), size(size), offset(offset) {}
+
+    template <typename T>
+    T Get()
+    {
+        T value = T();
+        if (!Has(sizeof(T)))
+            return value;
+        std::memcpy(&value, bytes + offset, sizeof(T));
+        offset += sizeof(T);
+        return value;
+    }
+
+    // a count of items at least minItemBytes each, checked against what is left
+    uint32_t GetCount(size_t minItemBytes)
+    {
+        uint32_t count = Get<uint32_t>();
+        return Has((size_t) count * minItemBytes) ? count : 0;
+    }
+
+    std::string GetString()
+    {
+        uint32_t length = Get<uint32_t>();
+        if (!Has(length))
+            return std::string();
+        std::string text(reinterpret_cast<const char*>(bytes + offset), length);
+        offset += length;
+        return text;
+    }
+
+    template <typename T>
+    ArrayView<T> GetArray()
+    {
+        uint32_t count = Get<uint32_t>();
+        offset = (offset + 15) & ~size_t(15);
+        if (!Has((size_t) count * sizeof(T)))
+            return ArrayView<T>();
+        ArrayView<T> view(reinterpret_cast<const T*>(bytes + offset), count);
+        offset += (size_t) count * sizeof(T);
+        return view;
+    }
+
+private:
+    const unsigned char* bytes;
+    size_t size;
+    size_t offset;
+
+    bool Has(size_t count)
+    {
+        ok = ok && offset <= size && count <= size - offset;
+        return ok;
+    }
+};
+
+/**
+ * @brief writes data into a cache file for key, see the layout at the top of the file
+ *
+ * @param path
+ * @param key
+ * @param data
+ * @return true on success
+ */
+bool WriteModelCache(const std::string& path, const ModelCacheKey& key, const ModelData& data)
+{
+    ModelCacheWriter writer;
+    ModelCacheHeader header = {};
+    writer.buffer.resize(sizeof(ModelCacheHeader), 0);
+
+    writer.Put<uint32_t>(data.meshes.size());
+    for (const MeshView& mesh : data.meshes)
+    {
+        writer.Put<uint32_t>(mesh.textures.size());
+        for (const TextureRef& texture : mesh.textures)
+        {
+            writer.PutString(texture.type);
+            writer.PutString(texture.path);
+        }
+        writer.PutArray(mesh.vertices);
+        writer.PutArray(mesh.indices);
+    }
+
+    writer.Put<int32_t>(data.bones->count);
+    writer.Put<uint32_t>(data.bones->bones.size());
+    for (const auto& bone : data.bones->bones)
+    {
+        writer.PutString(bone.first);
+        writer.Put<int32_t>(bone.second.id);
+        writer.Put(bone.second.offset);
+    }
+
+    writer.Put<uint32_t>(data.nodes.size());
+    for (const ModelNode& node : data.nodes)
+    {
+        writer.PutString(node.name);
+        writer.Put(node.transformation);
+        writer.Put<int32_t>(node.childrenCount);
+    }
+
+    writer.Put<uint32_t>(data.clips.size());
+    for (const ClipView& clip : data.clips)
+    {
+        writer.PutString(clip.name);
+        writer.Put<float>(clip.duration);
+        writer.Put<int32_t>(clip.ticksPerSecond);
+        writer.Put<uint32_t>(clip.channels.size());
+        for (const ChannelView& channel : clip.channels)
+        {
+            writer.PutString(channel.name);
+            writer.Put<int32_t>(channel.boneID);
+            writer.PutArray(channel.positions);
+            writer.PutArray(channel.rotations);
+            writer.PutArray(channel.scales);
+        }
+    }
+
+    std::memcpy(header.magic, MODEL_CACHE_MAGIC, 4);
+    header.version = MODEL_CACHE_VERSION;
+    header.importFlags = key.importFlags;
+    header.vertexSize = sizeof(Vertex);
+    header.keyPositionSize = sizeof(KeyPosition);
+    header.keyRotationSize = sizeof(KeyRotation);
+    header.keyScaleSize = sizeof(KeyScale);
+    header.sourceHash = key.sourceHash;
+    header.sourceSize = key.sourceSize;
+    header.fileSize = writer.buffer.size();
+    std::memcpy(writer.buffer.data(), &header, sizeof(ModelCacheHeader));
+
+    // written aside and renamed so a reader never maps a half written cache
+    std::string partialPath = path + ".partial";
+    {
+        std::ofstream file(partialPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+        {
+            std::cout << "ERROR: FAILED TO OPEN FILE " << partialPath << std::endl;
+            return false;
+        }
+        file.write(reinterpret_cast<const char*>(writer.buffer.data()), writer.buffer.size());
+        if (!file.good())
+        {
+            std::cout << "ERROR: FAILED TO WRITE MODEL CACHE " << partialPath << std::endl;
+            return false;
+        }
+    }
+    std::remove(path.c_str());
+    if (std::rename(partialPath.c_str(), path.c_str()) != 0)
+    {
+        std::cout << "ERROR: FAILED TO RENAME " << partialPath << " TO " << path << std::endl;
+        std::remove(partialPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+// where the time of ModelCache::Load went
+struct ModelCacheTimes
+{
+    double hashMs = 0;
+    // assimp import and bake, both 0 on a warm start
+    double importMs = 0;
+    double writeMs = 0;
+    double mapMs = 0;
+};
+
+/**
+ * A model's ModelData served from its baked cache. Load maps source + ".vbake" and on a
+ * miss (no cache, other source, other flags or struct sizes) imports the source with
+ * assimp, writes the cache and maps that. When the cache cannot be written the data
+ * comes from the import held in memory instead.
+ */
+class ModelCache
+{
+public:
+    ModelCache() = default;
+    ModelCache(const ModelCache&) = delete;
+    ModelCache& operator=(const ModelCache&) = delete;
+
+    bool Load(const std::string& sourcePath, unsigned int importFlags = MODEL_IMPORT_FLAGS)
+    {
+        typedef std::chrono::high_resolution_clock clock;
+        times = ModelCacheTimes();
+        warm = false;
+        fallback.reset();
+        std::string cachePath = sourcePath + MODEL_CACHE_EXTENSION;
+
+        auto start = clock::now();
+        ModelCacheKey key;
+        key.importFlags = importFlags;
+        if (!HashModelSource(sourcePath, key))
+        {
+            std::cout << "ERROR: FAILED TO READ MODEL " << sourcePath << std::endl;
+            return false;
+        }
+        auto hashed = clock::now();
+        times.hashMs = std::chrono::duration<double, std::milli>(hashed - start).count();
+
+        if (Open(cachePath, key, ModelDirectory(sourcePath)))
+        {
+            warm = true;
+            times.mapMs = std::chrono::duration<double, std::milli>(clock::now() - hashed).count();
+            return true;
+        }
+
+        std::unique_ptr<ModelImport> import(new ModelImport());
+        if (!import->Read(sourcePath, importFlags))
+            return false;
+        auto imported = clock::now();
+        times.importMs = std::chrono::duration<double, std::milli>(imported - hashed).count();
+
+        bool written = WriteModelCache(cachePath, key, import->Data());
+        auto wrote = clock::now();
+        times.writeMs = std::chrono::duration<double, std::milli>(wrote - imported).count();
+        if (written && Open(cachePath, key, ModelDirectory(sourcePath)))
+        {
+            times.mapMs = std::chrono::duration<double, std::milli>(clock::now() - wrote).count();
+            return true;
+        }
+        std::cout << "ERROR: MODEL CACHE UNUSABLE, KEEPING THE IMPORT OF " << sourcePath << std::endl;
+        fallback = std::move(import);
+        return true;
+    }
+
+    const ModelData& Data() const { return fallback ? fallback->Data() : data; }
+
+    // true when Load found an up to date cache and did not run assimp
+    bool Warm() const { return warm; }
+    const ModelCacheTimes& Times() const { return times; }
+    size_t Bytes() const { return file.size(); }
+
+    /**
+     * @brief maps a cache and reads its tables, the big arrays stay in the mapping
+     *
+     * @param cachePath
+     * @param key the cache must have been baked for this key
+     * @param directory what the textures' paths are relative to
+     * @return false on a missing, stale or damaged cache
+     */
+    bool Open(const std::string& cachePath, const ModelCacheKey& key, const std::string& directory)
+    {
+        data = ModelData();
+        if (!file.open(cachePath))
+            return false;
+
+        ModelCacheHeader header;
+        if (file.size() < sizeof(ModelCacheHeader))
+            return Reject();
+        std::memcpy(&header, file.bytes(), sizeof(ModelCacheHeader));
+        if (std::memcmp(header.magic, MODEL_CACHE_MAGIC, 4) != 0 || header.version != MODEL_CACHE_VERSION ||
+            header.importFlags != key.importFlags || header.sourceHash != key.sourceHash ||
+            header.sourceSize != key.sourceSize || header.fileSize != file.size() ||
+            header.vertexSize != sizeof(Vertex) || header.keyPositionSize != sizeof(KeyPosition) ||
+            header.keyRotationSize != sizeof(KeyRotation) || header.keyScaleSize != sizeof(KeyScale))
+            return Reject();
+
+        ModelCacheReader reader(file.bytes(), file.size(), sizeof(ModelCacheHeader));
+        data.directory = directory;
+
+        data.meshes.resize(reader.GetCount(12));
+        for (size_t m = 0; m < data.meshes.size() && reader.ok; m++)
+        {
+            MeshView& mesh = data.meshes[m];
+            mesh.textures.resize(reader.GetCount(8));
+            for (size_t t = 0; t < mesh.textures.size() && reader.ok; t++)
+            {
+                mesh.textures[t].type = reader.GetString();
+                mesh.textures[t].path = reader.GetString();
+            }
+            mesh.vertices = reader.GetArray<Vertex>();
+            mesh.indices = reader.GetArray<unsigned int>();
+        }
+
+        std::shared_ptr<BoneRegistry> registry = std::make_shared<BoneRegistry>();
+        registry->count = reader.Get<int32_t>();
+        uint32_t boneInfoCount = reader.GetCount(8 + sizeof(glm::mat4));
+        for (uint32_t b = 0; b < boneInfoCount && reader.ok; b++)
+        {
+            std::string name = reader.GetString();
+            BoneInfo info;
+            info.id = reader.Get<int32_t>();
+            info.offset = reader.Get<glm::mat4>();
+            registry->bones[name] = info;
+        }
+        data.bones = registry;
+
+        data.nodes.resize(reader.GetCount(8 + sizeof(glm::mat4)));
+        for (size_t n = 0; n < data.nodes.size() && reader.ok; n++)
+        {
+            data.nodes[n].name = reader.GetString();
+            data.nodes[n].transformation = reader.Get<glm::mat4>();
+            data.nodes[n].childrenCount = reader.Get<int32_t>();
+        }
+
+        data.clips.resize(reader.GetCount(16));
+        for (size_t c = 0; c < data.clips.size() && reader.ok; c++)
+        {
+            ClipView& clip = data.clips[c];
+            clip.name = reader.GetString();
+            clip.duration = reader.Get<float>();
+            clip.ticksPerSecond = reader.Get<int32_t>();
+            clip.channels.resize(reader.GetCount(20));
+            for (size_t i = 0; i < clip.channels.size() && reader.ok; i++)
+            {
+                ChannelView& channel = clip.channels[i];
+                channel.name = reader.GetString();
+                channel.boneID = reader.Get<int32_t>();
+                channel.positions = reader.GetArray<KeyPosition>();
+                channel.rotations = reader.GetArray<KeyRotation>();
+                channel.scales = reader.GetArray<KeyScale>();
+            }
+        }
+
+        if (!reader.ok)
+        {
+            std::cout << "ERROR: TRUNCATED MODEL CACHE " << cachePath << std::endl;
+            return Reject();
+        }
+        return true;
+    }
+
+private:
+    mapped_file file;
+    ModelData data;
+    std::unique_ptr<ModelImport> fallback;
+    ModelCacheTimes times;
+    bool warm = false;
+
+    bool Reject()
+    {
+        data = ModelData();
+        file.close();
+        return false;
+    }
+};
+
+#endif
@@ -3,12 +3,14 @@
 
 #include <glad/glad.h>
 #include "ShaderUtils.h"
+#include "GLCallCounter.h"
 
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <vector>
+#include <unordered_map>
 
 
 class Shader 
@@ -58,36 +60,153 @@ public:
 
         glDeleteShader(vertex);
         glDeleteShader(fragment);
+
+        CacheUniformLocations();
     }   
     void use() {
-        glUseProgram(ID);
+        GL_COUNTED(glUseProgram(ID));
+    }
+
+    /**
+     * @brief location of an active uniform, looked up in the table filled at link time
+     * so it costs no gl call. Keep the result and use the location setters in hot loops.
+     *
+     * @param name e.g. "model", "finalBonesMatrices" or "finalBonesMatrices[3]"
+     * @return location, -1 if the uniform is not active
+     */
+    int GetUniformLocation(const std::string &name) const {
+        auto iter = uniformLocations.find(name);
+        return iter == uniformLocations.end() ? -1 : iter->second;
+    }
+
+    /**
+     * @brief points a uniform block at a binding point, e.g. the one a BonePaletteBuffer is bound to
+     *
+     * @param blockName
+     * @param bindingPoint
+     * @return false if the program has no such block
+     */
+    bool BindUniformBlock(const std::string &blockName, unsigned int bindingPoint) const {
+        unsigned int index = glGetUniformBlockIndex(ID, blockName.c_str());
+        if (index == GL_INVALID_INDEX) {
+            std::cout << "ERROR::SHADER::UNIFORM_BLOCK_NOT_FOUND " << blockName << std::endl;
+            return false;
+        }
+        glUniformBlockBinding(ID, index, bindingPoint);
+        return true;
     }
 
     void setBool(const std::string &name, bool value) const {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+        setBool(GetUniformLocation(name), value);
     }
 
     void setInt(const std::string &name, int value) const {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+        setInt(GetUniformLocation(name), value);
     }
 
     void setFloat (const std::string &name, float value) const {
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+        setFloat(GetUniformLocation(name), value);
     }
 
     void setVec3(const std::string &name, const float a, const float b, const float c) const {
-        // glm::vec3 new_vec = glm::vec3(a, b, c);
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), a, b, c);
+        setVec3(GetUniformLocation(name), a, b, c);
     }
 
     void setVec3(const std::string &name, glm::vec3 &new_vec) const {
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &new_vec[0]);
+        setVec3(GetUniformLocation(name), new_vec);
     }
 
     void setMat4(const std::string &name,  const glm::mat4 &mat4) const {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, false, &mat4[0][0]);
+        setMat4(GetUniformLocation(name), mat4);
     }
 
+    // location setters, inactive uniforms (-1) are skipped without a gl call
+
+    void setBool(int location, bool value) const {
+        setInt(location, (int)value);
+    }
+
+    void setInt(int location, int value) const {
+        if (location < 0) return;
+        GL_COUNTED(glUniform1i(location, value));
+    }
+
+    void setFloat(int location, float value) const {
+        if (location < 0) return;
+        GL_COUNTED(glUniform1f(location, value));
+    }
+
+    void setVec3(int location, const float a, const float b, const float c) const {
+        if (location < 0) return;
+        GL_COUNTED(glUniform3f(location, a, b, c));
+    }
+
+    void setVec3(int location, const glm::vec3 &new_vec) const {
+        if (location < 0) return;
+        GL_COUNTED(glUniform3fv(location, 1, &new_vec[0]));
+    }
+
+    void setMat4(int location, const glm::mat4 &mat4) const {
+        if (location < 0) return;
+        GL_COUNTED(glUniformMatrix4fv(location, 1, false, &mat4[0][0]));
+    }
+
+    /**
+     * @brief uploads a whole mat4 array uniform, e.g. the bone matrices, in one call
+     *
+     * @param location of the array, GetUniformLocation("finalBonesMatrices")
+     * @param mats
+     * @param count clamped to the array size the shader declares
+     */
+    void setMat4Array(int location, const glm::mat4 *mats, int count) const {
+        if (location < 0 || count <= 0) return;
+        auto size = arraySizes.find(location);
+        if (size != arraySizes.end() && count > size->second)
+            count = size->second;
+        GL_COUNTED(glUniformMatrix4fv(location, count, false, &mats[0][0][0]));
+    }
+
+private:
+    std::unordered_map<std::string, int> uniformLocations;
+    // element count of every array uniform, keyed by the location of element 0
+    std::unordered_map<int, int> arraySizes;
+
+    /* asks the linked program for all active uniforms once, arrays are reachable both by
+    their plain name and per element*/
+    void CacheUniformLocations() {
+        int count = 0;
+        int maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<char> nameBuffer(maxLength > 0 ? maxLength : 1);
+
+        for (int i = 0; i < count; i++) {
+            int size = 0;
+            GLenum type;
+            GLsizei length = 0;
+            glGetActiveUniform(ID, i, nameBuffer.size(), &length, &size, &type, nameBuffer.data());
+            std::string name(nameBuffer.data(), length);
+
+            // uniform block members have no location
+            int location = glGetUniformLocation(ID, name.c_str());
+            if (location < 0)
+                continue;
+            uniformLocations[name] = location;
+
+            // arrays are reported as "name[0]"
+            if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0) {
+                std::string base = name.substr(0, name.size() - 3);
+                uniformLocations[base] = location;
+                arraySizes[location] = size;
+                for (int element = 1; element < size; element++) {
+                    std::string elementName = base + "[" + std::to_string(element) + "]";
+                    int elementLocation = glGetUniformLocation(ID, elementName.c_str());
+                    if (elementLocation >= 0)
+                        uniformLocations[elementName] = elementLocation;
+                }
+            }
+        }
+    }
 };
 
 
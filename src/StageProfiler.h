@@ -0,0 +1,221 @@
+#ifndef STAGE_PROFILER_H
+#define STAGE_PROFILER_H
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <memory>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+
+/*
+ * Scoped stage timers. Build with -DSTAGE_PROFILING=0 and PROFILE_STAGE expands to
+ * nothing, no clock reads and no ring writes are left in the code.
+ */
+#ifndef STAGE_PROFILING
+#define STAGE_PROFILING 1
+#endif
+
+enum ProfileStage {
+    STAGE_PARSE,
+    STAGE_RETARGET,
+    STAGE_FLATTEN,
+    STAGE_UPLOAD,
+    STAGE_DRAW,
+    STAGE_SWAP,
+    // a whole render loop iteration
+    STAGE_FRAME,
+    STAGE_COUNT
+};
+
+const char* const PROFILE_STAGE_NAMES[STAGE_COUNT] = {
+    "parse", "retarget", "flatten", "upload", "draw", "swap", "frame"
+};
+
+// events kept per thread, older ones are overwritten
+const size_t STAGE_RING_EVENTS = 1 << 16;
+
+struct StageEvent {
+    int64_t startNs;
+    int64_t durationNs;
+    uint32_t stage;
+};
+
+struct StagePercentiles {
+    uint64_t count = 0;
+    double meanMs = 0;
+    double p50Ms = 0;
+    double p95Ms = 0;
+    double p99Ms = 0;
+    double maxMs = 0;
+};
+
+/**
+ * One thread's events. Only the owning thread writes; readers take what was published
+ * through head. Export while the thread is busy can catch the oldest few entries
+ * mid-overwrite, so summaries are meant for quiet points (between frames, at exit).
+ */
+struct StageRing {
+    std::vector<StageEvent> events;
+    std::atomic<uint64_t> head{0};
+    uint32_t threadIndex = 0;
+
+    StageRing() : events(STAGE_RING_EVENTS) {}
+
+    void Push(uint32_t stage, int64_t startNs, int64_t durationNs) {
+        uint64_t h = head.load(std::memory_order_relaxed);
+        StageEvent& e = events[h & (STAGE_RING_EVENTS - 1)];
+        e.startNs = startNs;
+        e.durationNs = durationNs;
+        e.stage = stage;
+        head.store(h + 1, std::memory_order_release);
+    }
+};
+
+inline int64_t StageClockNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * Owns every thread's ring. A thread's ring is created on its first event, the only
+ * point that takes the lock; rings outlive their threads so late exports still see them.
+ */
+class StageProfiler {
+public:
+    StageRing& ThreadRing() {
+        thread_local StageRing* ring = nullptr;
+        if (ring == nullptr) {
+            std::lock_guard<std::mutex> lock(mutex);
+            rings.emplace_back(new StageRing());
+            ring = rings.back().get();
+            ring->threadIndex = rings.size() - 1;
+        }
+        return *ring;
+    }
+
+    // forgets recorded events, e.g. after warm up
+    void Reset() {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& ring : rings)
+            ring->head.store(0);
+    }
+
+    /**
+     * @brief p50 / p95 / p99 of one stage over all threads' retained events
+     */
+    StagePercentiles Percentiles(ProfileStage stage) {
+        std::vector<int64_t> durations;
+        ForEachEvent([&](const StageRing&, const StageEvent& e) {
+            if (e.stage == (uint32_t) stage)
+                durations.push_back(e.durationNs);
+        });
+
+        StagePercentiles result;
+        if (durations.empty())
+            return result;
+        std::sort(durations.begin(), durations.end());
+        double sum = 0;
+        for (int64_t d : durations)
+            sum += d;
+        auto at = [&](double q) {
+            return durations[std::min(durations.size() - 1, (size_t) (durations.size() * q))] / 1e6;
+        };
+        result.count = durations.size();
+        result.meanMs = sum / durations.size() / 1e6;
+        result.p50Ms = at(0.50);
+        result.p95Ms = at(0.95);
+        result.p99Ms = at(0.99);
+        result.maxMs = durations.back() / 1e6;
+        return result;
+    }
+
+    // one line per stage that has events
+    void PrintSummary(std::ostream& out) {
+        char line[160];
+        for (int s = 0; s < STAGE_COUNT; s++) {
+            StagePercentiles p = Percentiles((ProfileStage) s);
+            if (p.count == 0)
+                continue;
+            snprintf(line, sizeof(line), "%-9s n=%-7llu mean %.3f ms  p50 %.3f  p95 %.3f  p99 %.3f  max %.3f",
+                PROFILE_STAGE_NAMES[s], (unsigned long long) p.count, p.meanMs, p.p50Ms, p.p95Ms, p.p99Ms, p.maxMs);
+            out << line << "\n";
+        }
+        out.flush();
+    }
+
+    /**
+     * @brief writes the retained events as Chrome trace event JSON, open it in
+     * chrome://tracing or Perfetto
+     *
+     * @param path
+     * @return true on success
+     */
+    bool WriteChromeTrace(const std::string& path) {
+        std::ofstream out(path, std::ios::binary);
+        if (!out.is_open()) {
+            std::cout << "ERROR: FAILED TO OPEN FILE " << path << std::endl;
+            return false;
+        }
+        out << "{\"traceEvents\":[\n";
+        bool first = true;
+        char event[192];
+        ForEachEvent([&](const StageRing& ring, const StageEvent& e) {
+            snprintf(event, sizeof(event), "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                first ? "" : ",\n", PROFILE_STAGE_NAMES[e.stage], ring.threadIndex, e.startNs / 1e3, e.durationNs / 1e3);
+            out << event;
+            first = false;
+        });
+        out << "\n]}\n";
+        return out.good();
+    }
+
+private:
+    std::mutex mutex;
+    std::vector<std::unique_ptr<StageRing>> rings;
+
+    template <typename Fn>
+    void ForEachEvent(Fn fn) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& ring : rings) {
+            uint64_t head = ring->head.load(std::memory_order_acquire);
+            uint64_t first = head > STAGE_RING_EVENTS ? head - STAGE_RING_EVENTS : 0;
+            for (uint64_t i = first; i < head; i++)
+                fn(*ring, ring->events[i & (STAGE_RING_EVENTS - 1)]);
+        }
+    }
+};
+
+StageProfiler stageProfiler;
+
+/**
+ * Times the enclosing scope into the calling thread's ring.
+ */
+class ScopedStageTimer {
+public:
+    explicit ScopedStageTimer(ProfileStage stage) : stage(stage), startNs(StageClockNs()) {}
+
+    ~ScopedStageTimer() {
+        stageProfiler.ThreadRing().Push(stage, startNs, StageClockNs() - startNs);
+    }
+
+private:
+    ProfileStage stage;
+    int64_t startNs;
+};
+
+#define STAGE_PROFILER_CONCAT_INNER(a, b) a##b
+#define STAGE_PROFILER_CONCAT(a, b) STAGE_PROFILER_CONCAT_INNER(a, b)
+
+#if STAGE_PROFILING
+#define PROFILE_STAGE(stage) ScopedStageTimer STAGE_PROFILER_CONCAT(stageTimer, __LINE__)(stage)
+#else
+#define PROFILE_STAGE(stage) ((void) 0)
+#endif
+
+#endif
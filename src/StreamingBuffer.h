@@ -0,0 +1,178 @@
+#ifndef STREAMING_BUFFER_H
+#define STREAMING_BUFFER_H
+
+#include <glad/glad.h>
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <cstring>
+#include <cstdint>
+
+#include "GLCallCounter.h"
+
+// regions in the ring, the cpu writes one while the gpu may still read the other two
+const unsigned int STREAMING_BUFFER_REGIONS = 3;
+
+struct StreamingBufferStats {
+    uint64_t frames = 0;
+    // bytes handed to the driver, either written into the mapping or passed to glBufferSubData
+    uint64_t bytesUploaded = 0;
+    // times BeginWrite had to wait on the gpu before reusing a region
+    uint64_t stalls = 0;
+    double stallSeconds = 0;
+
+    double BytesPerFrame() const { return frames ? (double) bytesUploaded / frames : 0; }
+};
+
+/**
+ * Per frame vertex upload for data that changes every frame.
+ *
+ * With GL 4.4 (glBufferStorage) the buffer is a persistently mapped ring of
+ * STREAMING_BUFFER_REGIONS regions, each guarded by a fence: the cpu writes straight into
+ * the mapped region and the draw reads it at FirstVertex(). Without it, the buffer is
+ * orphaned with glBufferData(NULL, GL_STREAM_DRAW) and refilled with glBufferSubData
+ * from a cpu staging copy.
+ */
+class StreamingBuffer {
+public:
+    unsigned int VBO = 0;
+
+    StreamingBuffer(size_t regionBytes, unsigned int vertexStride, bool allowPersistent = true)
+        : regionBytes(regionBytes), vertexStride(vertexStride)
+    {
+        glGenBuffers(1, &VBO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+
+        persistent = allowPersistent && GLAD_GL_VERSION_4_4 && glBufferStorage != NULL;
+        if (persistent) {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_ARRAY_BUFFER, regionBytes * STREAMING_BUFFER_REGIONS, NULL, flags);
+            mapped = (unsigned char*) glMapBufferRange(GL_ARRAY_BUFFER, 0,
+                regionBytes * STREAMING_BUFFER_REGIONS, flags);
+            if (mapped == NULL) {
+                std::cout << "StreamingBuffer: persistent map failed, falling back to glBufferSubData" << std::endl;
+                persistent = false;
+                glDeleteBuffers(1, &VBO);
+                glGenBuffers(1, &VBO);
+                glBindBuffer(GL_ARRAY_BUFFER, VBO);
+            }
+        }
+        if (!persistent) {
+            staging.resize(regionBytes);
+            glBufferData(GL_ARRAY_BUFFER, regionBytes, NULL, GL_STREAM_DRAW);
+        }
+        for (unsigned int i = 0; i < STREAMING_BUFFER_REGIONS; i++)
+            fences[i] = 0;
+    }
+
+    StreamingBuffer(const StreamingBuffer&) = delete;
+    StreamingBuffer& operator=(const StreamingBuffer&) = delete;
+
+    ~StreamingBuffer() {
+        Release();
+    }
+
+    /**
+     * @brief frees the gl objects, call before the context goes away if the buffer outlives it
+     */
+    void Release() {
+        if (VBO == 0)
+            return;
+        for (unsigned int i = 0; i < STREAMING_BUFFER_REGIONS; i++) {
+            if (fences[i])
+                glDeleteSync(fences[i]);
+            fences[i] = 0;
+        }
+        if (persistent) {
+            glBindBuffer(GL_ARRAY_BUFFER, VBO);
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+            mapped = NULL;
+        }
+        glDeleteBuffers(1, &VBO);
+        VBO = 0;
+    }
+
+    bool IsPersistent() const { return persistent; }
+    size_t RegionBytes() const { return regionBytes; }
+    const StreamingBufferStats& Stats() const { return stats; }
+    void ResetStats() { stats = StreamingBufferStats(); }
+
+    /**
+     * @brief returns where this frame's vertices go, waiting for the gpu if it is still
+     * reading the region. The pointer is valid until EndWrite.
+     */
+    void* BeginWrite() {
+        if (!persistent)
+            return staging.data();
+
+        region = (region + 1) % STREAMING_BUFFER_REGIONS;
+        GLsync fence = fences[region];
+        if (fence) {
+            GLenum status = GL_COUNTED(glClientWaitSync(fence, 0, 0));
+            if (status == GL_TIMEOUT_EXPIRED) {
+                stats.stalls++;
+                auto start = std::chrono::high_resolution_clock::now();
+                do {
+                    status = GL_COUNTED(glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000));
+                } while (status == GL_TIMEOUT_EXPIRED);
+                auto stop = std::chrono::high_resolution_clock::now();
+                stats.stallSeconds += std::chrono::duration<double>(stop - start).count();
+            }
+            GL_COUNTED(glDeleteSync(fence));
+            fences[region] = 0;
+        }
+        return mapped + region * regionBytes;
+    }
+
+    /**
+     * @brief publishes the bytes written since BeginWrite
+     *
+     * @param bytesWritten at most RegionBytes()
+     */
+    void EndWrite(size_t bytesWritten) {
+        if (!persistent) {
+            GL_COUNTED(glBindBuffer(GL_ARRAY_BUFFER, VBO));
+            // orphan so the driver hands out fresh storage instead of syncing with the last draw
+            GL_COUNTED(glBufferData(GL_ARRAY_BUFFER, regionBytes, NULL, GL_STREAM_DRAW));
+            GL_COUNTED(glBufferSubData(GL_ARRAY_BUFFER, 0, bytesWritten, staging.data()));
+        }
+        stats.frames++;
+        stats.bytesUploaded += bytesWritten;
+    }
+
+    /**
+     * @brief copies a ready made frame in, for data that was not written in place
+     */
+    void Upload(const void* data, size_t bytes) {
+        void* dst = BeginWrite();
+        std::memcpy(dst, data, bytes);
+        EndWrite(bytes);
+    }
+
+    // first vertex of the current region, pass to glDrawArrays
+    GLint FirstVertex() const {
+        return persistent ? (GLint) (region * regionBytes / vertexStride) : 0;
+    }
+
+    /**
+     * @brief call once the draws reading the current region are submitted
+     */
+    void FenceDraws() {
+        if (persistent) {
+            fences[region] = GL_COUNTED(glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+        }
+    }
+
+private:
+    size_t regionBytes;
+    unsigned int vertexStride;
+    bool persistent = false;
+    unsigned char* mapped = NULL;
+    std::vector<unsigned char> staging;
+    unsigned int region = 0;
+    GLsync fences[STREAMING_BUFFER_REGIONS];
+    StreamingBufferStats stats;
+};
+
+#endif
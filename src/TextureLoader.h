@@ -0,0 +1,211 @@
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <glad/glad.h>
+
+#include "stb_image.h"
+#include "work_stealing_pool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// where the time of one Finish went, the decode part runs on the worker threads
+struct TextureLoadStats {
+    unsigned int textureCount = 0;
+    unsigned int failedCount = 0;
+    size_t pixelBytes = 0;
+    double decodeMs = 0;
+    double uploadMs = 0;
+    // false when the PBO could not be mapped and the pixels went through client memory
+    bool stagedInPbo = false;
+};
+
+/**
+ * Defers texture loading so the images of a model decode in parallel. Request only hands
+ * out a texture name, a path asked for twice gets the same name; Finish decodes everything
+ * requested on a worker pool, each worker copying its image into one mapped pixel unpack
+ * buffer (stb_image only decodes into its own allocation, so that is one memcpy per image),
+ * and then does the glTexImage2D / mipmap calls from it on the calling thread. Request and
+ * Finish need the GL context current, the workers never touch GL.
+ */
+class TextureLoader {
+public:
+    TextureLoader() = default;
+    TextureLoader(const TextureLoader&) = delete;
+    TextureLoader& operator=(const TextureLoader&) = delete;
+
+    /**
+     * @brief the texture name for path, a new one when path was not asked for before.
+     * The texture has no storage until Finish.
+     *
+     * @param path the file to decode
+     * @return unsigned int
+     */
+    unsigned int Request(const std::string& path) {
+        auto found = textureIds.find(path);
+        if (found != textureIds.end())
+            return found->second;
+
+        PendingTexture pending;
+        pending.path = path;
+        glGenTextures(1, &pending.id);
+        textureIds.emplace(path, pending.id);
+        pendingTextures.push_back(pending);
+        return pending.id;
+    }
+
+    size_t PendingCount() const { return pendingTextures.size(); }
+
+    /**
+     * @brief decodes and uploads everything requested since the last Finish
+     *
+     * @param pool workers for the decode, nullptr starts one sized to the work
+     * @return TextureLoadStats
+     */
+    TextureLoadStats Finish(work_stealing_pool* pool = nullptr) {
+        TextureLoadStats stats;
+        stats.textureCount = pendingTextures.size();
+        if (pendingTextures.empty())
+            return stats;
+
+        auto start = std::chrono::high_resolution_clock::now();
+        std::unique_ptr<work_stealing_pool> ownPool;
+        if (pool == nullptr) {
+            unsigned int workers = std::max(1u, std::min((unsigned int) pendingTextures.size(), std::thread::hardware_concurrency()));
+            ownPool.reset(new work_stealing_pool(workers));
+            pool = ownPool.get();
+        }
+
+        // the headers give every image's size so the buffer can be laid out before decoding
+        pool->parallel_for(pendingTextures.size(), 1, [this](size_t begin, size_t end, unsigned int) {
+            for (size_t i = begin; i < end; i++) {
+                PendingTexture& pending = pendingTextures[i];
+                if (!stbi_info(pending.path.c_str(), &pending.width, &pending.height, &pending.components))
+                    pending.width = pending.height = pending.components = 0;
+            }
+        });
+        size_t totalBytes = 0;
+        for (PendingTexture& pending : pendingTextures) {
+            pending.offset = totalBytes;
+            // offsets stay 16 byte aligned for the copy into the mapped buffer
+            totalBytes += (pending.Bytes() + 15) & ~size_t(15);
+        }
+
+        unsigned int pbo = 0;
+        unsigned char* staging = nullptr;
+        std::vector<unsigned char> clientPixels;
+        if (totalBytes > 0) {
+            glGenBuffers(1, &pbo);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, totalBytes, nullptr, GL_STREAM_DRAW);
+            staging = (unsigned char*) glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, totalBytes,
+                GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            stats.stagedInPbo = staging != nullptr;
+            if (staging == nullptr) {
+                glDeleteBuffers(1, &pbo);
+                pbo = 0;
+                clientPixels.resize(totalBytes);
+                staging = clientPixels.data();
+            }
+        }
+
+        pool->parallel_for(pendingTextures.size(), 1, [this, staging](size_t begin, size_t end, unsigned int) {
+            // the flip flag is per thread since stb_image 2.24
+            stbi_set_flip_vertically_on_load_thread(1);
+            for (size_t i = begin; i < end; i++)
+                DecodeInto(pendingTextures[i], staging);
+        });
+        auto decoded = std::chrono::high_resolution_clock::now();
+
+        if (pbo != 0) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        }
+        GLint unpackAlignment;
+        glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpackAlignment);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        for (PendingTexture& pending : pendingTextures) {
+            if (!pending.decoded) {
+                std::cout << "Texture failed to load at path: " << pending.path << std::endl;
+                stats.failedCount++;
+                continue;
+            }
+            // with a PBO bound the pointer argument is an offset into it
+            const void* pixels = pbo != 0 ? (const void*) (uintptr_t) pending.offset : staging + pending.offset;
+            Upload(pending, pixels);
+            stats.pixelBytes += pending.Bytes();
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, unpackAlignment);
+        if (pbo != 0) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            glDeleteBuffers(1, &pbo);
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+        auto uploaded = std::chrono::high_resolution_clock::now();
+
+        stats.decodeMs = std::chrono::duration<double, std::milli>(decoded - start).count();
+        stats.uploadMs = std::chrono::duration<double, std::milli>(uploaded - decoded).count();
+        pendingTextures.clear();
+        return stats;
+    }
+
+private:
+    struct PendingTexture {
+        std::string path;
+        unsigned int id = 0;
+        int width = 0;
+        int height = 0;
+        int components = 0;
+        size_t offset = 0;
+        bool decoded = false;
+
+        size_t Bytes() const { return (size_t) width * height * components; }
+    };
+
+    std::unordered_map<std::string, unsigned int> textureIds;
+    std::vector<PendingTexture> pendingTextures;
+
+    // on a worker thread, no GL calls here. stb_image decodes into a heap buffer of its own,
+    // the pixels are copied from there into their place in the unpack buffer
+    static void DecodeInto(PendingTexture& pending, unsigned char* staging) {
+        if (pending.Bytes() == 0)
+            return;
+        int width, height, components;
+        unsigned char* data = stbi_load(pending.path.c_str(), &width, &height, &components, 0);
+        if (data && width == pending.width && height == pending.height && components == pending.components) {
+            std::memcpy(staging + pending.offset, data, pending.Bytes());
+            pending.decoded = true;
+        }
+        stbi_image_free(data);
+    }
+
+    static void Upload(const PendingTexture& pending, const void* pixels) {
+        GLenum format = GL_RGBA;
+        if (pending.components == 1)
+            format = GL_RED;
+        else if (pending.components == 2)
+            format = GL_RG;
+        else if (pending.components == 3)
+            format = GL_RGB;
+
+        glBindTexture(GL_TEXTURE_2D, pending.id);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, pending.width, pending.height, 0, format, GL_UNSIGNED_BYTE, pixels);
+        glGenerateMipmap(GL_TEXTURE_2D);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+};
+
+#endif
@@ -0,0 +1,277 @@
+#ifndef ANIMATION_BENCHMARKS_HPP
+#define ANIMATION_BENCHMARKS_HPP
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <cmath>
+
+#include <assimp/anim.h>
+
+#include "Bone.hpp"
+#include "Animation.hpp"
+#include "Animator.hpp"
+#include "work_stealing_pool.hpp"
+#include "CpuSkinner.h"
+#include "mesh_benchmarks.hpp"
+#include "benchmark_common.hpp"
+
+/**
+ * @brief builds an aiNodeAnim with key_count position, rotation and scale keys one tick apart
+ *
+ * @param channel filled in place, aiNodeAnim frees the key arrays itself
+ * @param key_count
+ */
+void fill_synthetic_channel(aiNodeAnim& channel, unsigned int key_count) {
+    channel.mNodeName = aiString(std::string("synthetic"));
+    channel.mNumPositionKeys = key_count;
+    channel.mNumRotationKeys = key_count;
+    channel.mNumScalingKeys = key_count;
+    channel.mPositionKeys = new aiVectorKey[key_count];
+    channel.mRotationKeys = new aiQuatKey[key_count];
+    channel.mScalingKeys = new aiVectorKey[key_count];
+    for (unsigned int i = 0; i < key_count; i++) {
+        float angle = 0.01f * i;
+        channel.mPositionKeys[i] = aiVectorKey(i, aiVector3D(std::sin(angle), std::cos(angle), 0.1f * angle));
+        channel.mRotationKeys[i] = aiQuatKey(i, aiQuaternion(aiVector3D(0, 1, 0), angle));
+        channel.mScalingKeys[i] = aiVectorKey(i, aiVector3D(1, 1, 1));
+    }
+}
+
+// the lookup Bone did before keeping cursors: scan from key 0 every time
+int linear_key_index(const std::vector<float>& timestamps, float animationTime) {
+    for (int index = 0; index + 1 < (int) timestamps.size(); ++index) {
+        if (animationTime < timestamps[index + 1])
+            return index;
+    }
+    return (int) timestamps.size() - 2;
+}
+
+/**
+ * @brief compares keyframe lookup on one synthetic channel: the old linear scan against
+ * Bone's cursor / binary search lookup, for monotonic playback and for random seeks
+ *
+ * @param key_count keys per channel
+ * @param samples lookups per measurement
+ */
+void benchmark_keyframe_lookup(unsigned int key_count = 10000, unsigned int samples = 20000) {
+    aiNodeAnim channel;
+    fill_synthetic_channel(channel, key_count);
+    Bone bone("synthetic", 0, &channel);
+
+    std::vector<float> timestamps(key_count);
+    for (unsigned int i = 0; i < key_count; i++)
+        timestamps[i] = i;
+
+    float duration = key_count - 1;
+    std::vector<float> playback_times(samples);
+    std::vector<float> seek_times(samples);
+    unsigned int seed = 12345;
+    for (unsigned int i = 0; i < samples; i++) {
+        playback_times[i] = duration * i / samples;
+        seed = seed * 1664525u + 1013904223u;
+        seek_times[i] = duration * (seed >> 8) / float(1u << 24);
+    }
+
+    auto time_ns = [&](const std::vector<float>& times, bool linear) {
+        long long sum = 0;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (float t : times) {
+            if (linear)
+                // one scan per channel, as Update used to do
+                sum += linear_key_index(timestamps, t) + linear_key_index(timestamps, t) + linear_key_index(timestamps, t);
+            else
+                sum += bone.GetPositionIndex(t) + bone.GetRotationIndex(t) + bone.GetScaleIndex(t);
+        }
+        auto stop = std::chrono::high_resolution_clock::now();
+        benchmark_sink = sum;
+        return std::chrono::duration<double, std::nano>(stop - start).count() / times.size();
+    };
+
+    std::cout << "keyframe lookup, " << key_count << " keys per channel (ns per bone update):" << std::endl;
+    std::cout << "  playback linear: " << time_ns(playback_times, true)
+        << "  cursor: " << time_ns(playback_times, false) << std::endl;
+    std::cout << "  seeks    linear: " << time_ns(seek_times, true)
+        << "  binary: " << time_ns(seek_times, false) << std::endl;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (float t : playback_times)
+        bone.Update(t);
+    // past the last key holds the final pose instead of asserting
+    bone.Update(duration + 10.0f);
+    auto stop = std::chrono::high_resolution_clock::now();
+    benchmark_sink = bone.GetLocalTransform()[3][0];
+    std::cout << "  full Update: " << std::chrono::duration<double, std::nano>(stop - start).count() / samples
+        << " ns" << std::endl;
+}
+
+/**
+ * @brief builds a synthetic skeleton where node i hangs off node (i - 1) / branching,
+ * every node animated by its own key_count key channel and owning a final matrix slot
+ *
+ * @param bone_count
+ * @param key_count keys per channel
+ * @param branching children per node
+ * @return Animation
+ */
+Animation build_synthetic_animation(unsigned int bone_count, unsigned int key_count = 64, unsigned int branching = 2) {
+    std::vector<AssimpNodeData> nodes(bone_count);
+    std::vector<Bone> bones;
+    std::map<std::string, BoneInfo> bone_info;
+    for (unsigned int i = 0; i < bone_count; i++) {
+        std::string name = "bone_" + std::to_string(i);
+        nodes[i].name = name;
+        nodes[i].transformation = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        nodes[i].childrenCount = 0;
+
+        aiNodeAnim channel;
+        fill_synthetic_channel(channel, key_count);
+        channel.mNodeName = aiString(name);
+        bones.push_back(Bone(name, i, &channel));
+
+        BoneInfo info;
+        info.id = i;
+        info.offset = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -1.0f * i, 0.0f));
+        bone_info[name] = info;
+    }
+
+    // children are attached deepest first so every copied subtree is already complete
+    for (int i = (int) bone_count - 1; i > 0; i--) {
+        AssimpNodeData& parent = nodes[(i - 1) / branching];
+        parent.children.insert(parent.children.begin(), nodes[i]);
+        parent.childrenCount++;
+    }
+    AssimpNodeData root = bone_count ? nodes[0] : AssimpNodeData();
+    return Animation(root, bones, bone_info, key_count - 1, 30);
+}
+
+/**
+ * @brief times Animator::UpdateAnimation on a synthetic skeleton
+ *
+ * @param bone_count
+ * @param updates
+ * @return microseconds per update
+ */
+double benchmark_animator_update(unsigned int bone_count = 64, unsigned int updates = 2000) {
+    Animation animation = build_synthetic_animation(bone_count);
+    Animator animator(&animation);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (unsigned int i = 0; i < updates; i++)
+        animator.UpdateAnimation(1.0f / 60.0f);
+    auto stop = std::chrono::high_resolution_clock::now();
+    benchmark_sink = animator.GetFinalBoneMatrices()[0][3][1];
+
+    double us_per_update = std::chrono::duration<double, std::micro>(stop - start).count() / updates;
+    std::cout << "animator update, " << bone_count << " bones: " << us_per_update << " us ("
+        << us_per_update * 1000.0 / bone_count << " ns per bone)" << std::endl;
+    return us_per_update;
+}
+
+/**
+ * @brief a crowd of Animators sharing one synthetic clip, each started at a staggered
+ * time and updated across the pool, instance by instance
+ *
+ * @param instance_count
+ * @param bone_count bones per skeleton
+ * @param updates crowd updates to time
+ * @param pool defaults to benchmark_pool()
+ * @return instances evaluated per millisecond
+ */
+double benchmark_animator_crowd(
+    unsigned int instance_count = 512,
+    unsigned int bone_count = 64,
+    unsigned int updates = 20,
+    work_stealing_pool& pool = benchmark_pool())
+{
+    Animation animation = build_synthetic_animation(bone_count);
+    std::vector<Animator> crowd(instance_count, Animator(&animation));
+    for (unsigned int i = 0; i < instance_count; i++)
+        crowd[i].SetCurrentTime(animation.GetDuration() * i / instance_count);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (unsigned int u = 0; u < updates; u++) {
+        pool.parallel_for(instance_count, 8, [&](size_t begin, size_t end, unsigned int) {
+            for (size_t i = begin; i < end; i++)
+                crowd[i].UpdateAnimation(1.0f / 60.0f);
+        });
+    }
+    auto stop = std::chrono::high_resolution_clock::now();
+    benchmark_sink = crowd[instance_count / 2].GetFinalBoneMatrices()[0][3][1];
+
+    double ms = std::chrono::duration<double, std::milli>(stop - start).count();
+    double instances_per_ms = ms > 0 ? (double) instance_count * updates / ms : 0;
+    std::cout << "animator crowd, " << instance_count << " instances x " << bone_count << " bones on "
+        << pool.size() << " threads: " << instances_per_ms << " instances/ms" << std::endl;
+    return instances_per_ms;
+}
+
+/**
+ * @brief CpuSkinner over synthetic meshes posed by an animated synthetic skeleton: checks
+ * every kernel against SkinVertexLikeShader and prints vertices per second single
+ * threaded and across the pool
+ *
+ * @param vertex_count vertices per mesh
+ * @param mesh_count
+ * @param bone_count
+ * @param passes skinning passes timed per kernel
+ * @param pool defaults to benchmark_pool()
+ * @return vertices per second of the best kernel on the pool
+ */
+double benchmark_cpu_skinning(
+    unsigned int vertex_count = 50000,
+    unsigned int mesh_count = 4,
+    unsigned int bone_count = 64,
+    unsigned int passes = 20,
+    work_stealing_pool& pool = benchmark_pool())
+{
+    Animation animation = build_synthetic_animation(bone_count);
+    Animator animator(&animation);
+    animator.UpdateAnimation(0.5f);
+    const std::vector<glm::mat4>& palette = animator.GetFinalBoneMatrices();
+
+    std::vector<std::vector<Vertex>> meshes;
+    CpuSkinner skinner;
+    for (unsigned int m = 0; m < mesh_count; m++) {
+        meshes.push_back(build_synthetic_skinned_vertices(vertex_count + m, bone_count));
+        skinner.AddMesh(meshes.back());
+    }
+    skinner.SetPalette(palette);
+    double total_vertices = (double) skinner.TotalVertexCount() * passes;
+
+    auto vertices_per_second = [&](work_stealing_pool* on_pool, CpuSkinningKernel kernel) {
+        skinner.Skin(on_pool, kernel);
+        auto start = std::chrono::high_resolution_clock::now();
+        for (unsigned int p = 0; p < passes; p++)
+            skinner.Skin(on_pool, kernel);
+        auto stop = std::chrono::high_resolution_clock::now();
+        double seconds = std::chrono::duration<double>(stop - start).count();
+        return seconds > 0 ? total_vertices / seconds : 0;
+    };
+    auto max_error = [&]() {
+        float error = 0;
+        for (unsigned int m = 0; m < mesh_count; m++) {
+            for (size_t v = 0; v < meshes[m].size(); v++) {
+                glm::vec3 expected = glm::vec3(SkinVertexLikeShader(meshes[m][v], palette));
+                glm::vec3 skinned = skinner.Position(m, v);
+                error = std::max(error, glm::length(expected - skinned) / std::max(1.0f, glm::length(expected)));
+            }
+        }
+        return error;
+    };
+
+    double best = 0;
+    for (int kernel = CPU_SKINNING_SCALAR; kernel <= CpuSkinningBestKernel(); kernel++) {
+        double single = vertices_per_second(NULL, (CpuSkinningKernel) kernel);
+        double pooled = vertices_per_second(&pool, (CpuSkinningKernel) kernel);
+        best = pooled;
+        std::cout << "cpu skinning " << CPU_SKINNING_KERNEL_NAMES[kernel] << ", " << mesh_count << " meshes x "
+            << vertex_count << " vertices, " << bone_count << " bones: " << single / 1e6 << " Mvertices/s, "
+            << pooled / 1e6 << " Mvertices/s on " << pool.size() << " threads, max relative error vs shader "
+            << max_error() << std::endl;
+    }
+    benchmark_sink = skinner.Position(0, vertex_count / 2).x;
+    return best;
+}
+
+#endif
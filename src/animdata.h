@@ -1,6 +1,8 @@
 #pragma once
 
 #include<glm/glm.hpp>
+#include<map>
+#include<string>
 
 struct BoneInfo
 {
@@ -11,4 +13,14 @@ struct BoneInfo
 	glm::mat4 offset;
 
 };
-#pragma once
\ No newline at end of file
+
+typedef std::map<std::string, BoneInfo> BoneInfoMap;
+
+/*every bone of a model and of all its clips, one registry is shared by the Model
+and each Animation built from the same import*/
+struct BoneRegistry
+{
+	BoneInfoMap bones;
+	/*next free id, equal to bones.size() for an import*/
+	int count = 0;
+};
@@ -0,0 +1,24 @@
+#ifndef BENCHMARK_COMMON_HPP
+#define BENCHMARK_COMMON_HPP
+
+#include "work_stealing_pool.hpp"
+
+/*
+ * State shared by the benchmark headers, so each suite does not carry its own copy.
+ */
+
+// keeps the optimizer from throwing away benchmark results
+volatile float benchmark_sink = 0;
+
+/**
+ * @brief the pool the parallel benchmarks run on when the caller does not pass one,
+ * one worker per hardware thread, created on first use and kept for the rest of the run
+ *
+ * @return work_stealing_pool&
+ */
+work_stealing_pool& benchmark_pool() {
+    static work_stealing_pool pool;
+    return pool;
+}
+
+#endif
@@ -0,0 +1,113 @@
+#ifndef BONE_UPLOAD_BENCHMARK_HPP
+#define BONE_UPLOAD_BENCHMARK_HPP
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+
+#include "Shader.h"
+#include "GLCallCounter.h"
+#include "BonePaletteBuffer.h"
+
+enum bone_upload_mode {
+    // glGetUniformLocation + glUniformMatrix4fv per bone with a built name, what Shader used to do
+    BONE_UPLOAD_LOOKUP_PER_BONE,
+    // setMat4("finalBonesMatrices[i]") through the location cache
+    BONE_UPLOAD_CACHED_PER_BONE,
+    // one setMat4Array on the array location
+    BONE_UPLOAD_ARRAY,
+    // one BonePaletteBuffer::Upload into the std140 block
+    BONE_UPLOAD_UNIFORM_BUFFER
+};
+
+const char* bone_upload_mode_name(bone_upload_mode mode) {
+    switch (mode) {
+        case BONE_UPLOAD_LOOKUP_PER_BONE: return "lookup per bone";
+        case BONE_UPLOAD_CACHED_PER_BONE: return "cached per bone";
+        case BONE_UPLOAD_ARRAY: return "one array call";
+        default: return "uniform buffer";
+    }
+}
+
+struct bone_upload_result {
+    double calls_per_frame = 0;
+    double us_per_frame = 0;
+};
+
+/**
+ * @brief uploads a full bone palette every frame with one of the upload modes and
+ * reports gl calls and cpu time per frame. Needs a current GL context.
+ *
+ * @param mode
+ * @param frames
+ * @param bone_count matrices in the palette, e.g. Animator::GetFinalBoneMatrices().size()
+ * @return bone_upload_result
+ */
+bone_upload_result run_bone_upload_benchmark(bone_upload_mode mode, unsigned int frames = 1000, unsigned int bone_count = 100) {
+    bool block = mode == BONE_UPLOAD_UNIFORM_BUFFER;
+    Shader shader(block ? "skeleton_animation" : "skeleton_animation_uniforms");
+    shader.use();
+
+    std::vector<glm::mat4> bones(bone_count, glm::mat4(1.0f));
+    std::vector<std::string> names(bone_count);
+    for (unsigned int i = 0; i < bone_count; i++)
+        names[i] = "finalBonesMatrices[" + std::to_string(i) + "]";
+    int array_location = shader.GetUniformLocation("finalBonesMatrices");
+
+    BonePaletteBuffer palette;
+    if (block)
+        shader.BindUniformBlock("BonePalette", palette.BindingPoint());
+
+    uint64_t calls_before = glCalls.total;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (unsigned int frame = 0; frame < frames; frame++) {
+        bones[frame % bone_count][3][0] = (float) frame;
+        switch (mode) {
+            case BONE_UPLOAD_LOOKUP_PER_BONE:
+                for (unsigned int i = 0; i < bone_count; i++) {
+                    std::string name = "finalBonesMatrices[" + std::to_string(i) + "]";
+                    GL_COUNTED(glUniformMatrix4fv(GL_COUNTED(glGetUniformLocation(shader.ID, name.c_str())), 1, false, &bones[i][0][0]));
+                }
+                break;
+            case BONE_UPLOAD_CACHED_PER_BONE:
+                for (unsigned int i = 0; i < bone_count; i++)
+                    shader.setMat4(names[i], bones[i]);
+                break;
+            case BONE_UPLOAD_ARRAY:
+                shader.setMat4Array(array_location, bones.data(), bone_count);
+                break;
+            case BONE_UPLOAD_UNIFORM_BUFFER:
+                palette.Upload(bones);
+                break;
+        }
+    }
+    glFinish();
+    auto stop = std::chrono::high_resolution_clock::now();
+
+    bone_upload_result result;
+    result.calls_per_frame = (double) (glCalls.total - calls_before) / frames;
+    result.us_per_frame = std::chrono::duration<double, std::micro>(stop - start).count() / frames;
+
+    GLenum e = glGetError();
+    if (e != GL_NO_ERROR)
+        fprintf(stderr, "OpenGL error in \"%s\": %d (%d)\n", "bone upload benchmark", e, e);
+    palette.Release();
+    glDeleteProgram(shader.ID);
+
+    std::cout << "bone upload, " << bone_upload_mode_name(mode) << ": " << result.calls_per_frame
+        << " GL calls/frame, " << result.us_per_frame << " us/frame" << std::endl;
+    return result;
+}
+
+void run_bone_upload_benchmarks(unsigned int frames = 1000) {
+    run_bone_upload_benchmark(BONE_UPLOAD_LOOKUP_PER_BONE, frames);
+    run_bone_upload_benchmark(BONE_UPLOAD_CACHED_PER_BONE, frames);
+    run_bone_upload_benchmark(BONE_UPLOAD_ARRAY, frames);
+    run_bone_upload_benchmark(BONE_UPLOAD_UNIFORM_BUFFER, frames);
+}
+
+#endif
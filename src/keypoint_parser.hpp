@@ -0,0 +1,178 @@
+#ifndef KEYPOINT_PARSER_HPP
+#define KEYPOINT_PARSER_HPP
+
+#include <charconv>
+#include <cstring>
+#include <cstddef>
+#include <cctype>
+#include <system_error>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define KEYPOINT_PARSER_SSE2 1
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+/*
+ * Single pass number scanner for capture text. Everything between numbers (brackets,
+ * commas, spaces, dangling commas) is skipped, numbers are parsed in place with
+ * std::from_chars, so nothing is allocated and nothing throws. Handles both layouts
+ * the captures use:
+ *
+ *   keypoint lines  [[-0.871807, 1.004028, -0.091635], [-0.868156, 1.075018, -0.074993], ...]
+ *   FRAME lines     FRAME: 6 l_knee_foot: {[0.991476,-0.000614,0.130288,],[...],[...]}, ...
+ */
+
+inline bool can_start_number(char ch) {
+    return ('0' <= ch && ch <= '9') || ch == '-' || ch == '.' || ch == '+';
+}
+
+inline unsigned int keypoint_parser_lowest_bit(unsigned int mask) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return index;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+/**
+ * @brief first character in [p, end) that can start a number, end if there is none.
+ * Checks 16 bytes at a time with SSE2, byte by byte for the tail or without SSE2.
+ *
+ * @param p
+ * @param end
+ * @return const char*
+ */
+inline const char* find_number_start(const char* p, const char* end) {
+#ifdef KEYPOINT_PARSER_SSE2
+    // '0'..'9' shifted to -128..-119, so one signed compare finds digits
+    const __m128i digit_bias = _mm_set1_epi8((char) (0x80 - '0'));
+    const __m128i digit_limit = _mm_set1_epi8((char) (-128 + 10));
+    const __m128i minus = _mm_set1_epi8('-');
+    const __m128i dot = _mm_set1_epi8('.');
+    const __m128i plus = _mm_set1_epi8('+');
+    while (end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*) p);
+        __m128i digits = _mm_cmplt_epi8(_mm_add_epi8(chunk, digit_bias), digit_limit);
+        __m128i signs = _mm_or_si128(_mm_cmpeq_epi8(chunk, minus),
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, dot), _mm_cmpeq_epi8(chunk, plus)));
+        unsigned int mask = _mm_movemask_epi8(_mm_or_si128(digits, signs));
+        if (mask)
+            return p + keypoint_parser_lowest_bit(mask);
+        p += 16;
+    }
+#endif
+    while (p < end && !can_start_number(*p))
+        p++;
+    return p;
+}
+
+/**
+ * @brief parses every number in [begin, end) into out, in order, until out is full
+ *
+ * @param begin
+ * @param end
+ * @param out
+ * @param capacity floats out can hold
+ * @return number of floats written
+ */
+inline size_t scan_floats(const char* begin, const char* end, float* out, size_t capacity) {
+    size_t count = 0;
+    const char* p = begin;
+    while (count < capacity) {
+        p = find_number_start(p, end);
+        if (p == end)
+            break;
+        // from_chars takes no leading '+'
+        const char* number = *p == '+' ? p + 1 : p;
+        std::from_chars_result result = std::from_chars(number, end, out[count]);
+        if (result.ec == std::errc()) {
+            count++;
+            p = result.ptr;
+        } else if (result.ec == std::errc::result_out_of_range) {
+            // stof threw on these, skip the number
+            p = result.ptr;
+        } else {
+            // a lone '-', '.' or '+'
+            p++;
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief reads x, y, z keypoints, every three numbers form one keypoint
+ *
+ * @param begin
+ * @param end
+ * @param out 3 floats per keypoint
+ * @param max_keypoints keypoints out can hold
+ * @param reverse_y negates every y
+ * @return number of keypoints written
+ */
+inline size_t parse_keypoints(const char* begin, const char* end, float* out, size_t max_keypoints, bool reverse_y = false) {
+    size_t keypoints = scan_floats(begin, end, out, max_keypoints * 3) / 3;
+    if (reverse_y) {
+        for (size_t i = 0; i < keypoints; i++)
+            out[i*3 + 1] *= -1;
+    }
+    return keypoints;
+}
+
+/**
+ * @brief upper bound on the floats a line can hold, each needs a digit and a separator
+ */
+inline size_t max_floats_in(size_t length) {
+    return length / 2 + 1;
+}
+
+/**
+ * @brief walks one FRAME line and calls fn(name, name_length, rotation) for every
+ * "name: {[..],[..],[..]}" entry, rotation being 9 row major floats. Names are the
+ * whitespace separated word before each colon, the frame prefix up to the first colon
+ * is skipped. Entries without 9 numbers are left out.
+ *
+ * @param begin
+ * @param end
+ * @param fn
+ * @return number of matrices passed to fn
+ */
+template <typename Fn>
+size_t for_each_matrix_in_line(const char* begin, const char* end, Fn fn) {
+    // skip past frame info
+    const char* p = (const char*) memchr(begin, ':', end - begin);
+    if (p == NULL)
+        return 0;
+    p++;
+
+    size_t count = 0;
+    float rotation[9];
+    while (p < end) {
+        const char* colon = (const char*) memchr(p, ':', end - p);
+        if (colon == NULL)
+            break;
+        const char* name = colon;
+        while (name > p && !isspace((unsigned char) name[-1]))
+            name--;
+
+        const char* open = (const char*) memchr(colon, '{', end - colon);
+        if (open == NULL)
+            break;
+        const char* close = (const char*) memchr(open, '}', end - open);
+        if (close == NULL)
+            close = end;
+
+        if (name < colon && scan_floats(open, close, rotation, 9) == 9) {
+            fn(name, (size_t) (colon - name), rotation);
+            count++;
+        }
+        p = close;
+    }
+    return count;
+}
+
+#endif
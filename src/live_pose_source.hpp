@@ -0,0 +1,352 @@
+#ifndef LIVE_POSE_SOURCE_HPP
+#define LIVE_POSE_SOURCE_HPP
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+
+#include "skeleton_utils.h"
+#include "keypoint_parser.hpp"
+#include "pose_stream.hpp"
+#include "pose_frame_queue.hpp"
+#include "retarget_plan.hpp"
+#include "StageProfiler.h"
+
+// how long reader threads sleep when there is nothing to read
+const unsigned int POSE_FOLLOW_POLL_MICROSECONDS = 1000;
+// how long they sleep while the queue is full, short so a slot freed by the render loop
+// is refilled well within its next frame
+const unsigned int POSE_FOLLOW_FULL_WAIT_MICROSECONDS = 100;
+
+/*
+ * What the consumer does when more than one frame is waiting, i.e. when capture runs
+ * ahead of rendering.
+ */
+enum pose_follow_policy {
+    // every frame in order, latency grows while behind; nothing is lost, the reader
+    // waits on a full queue
+    POSE_FOLLOW_EVERY_FRAME,
+    // jump to the newest frame and drop the ones before it, lowest latency
+    POSE_FOLLOW_LATEST,
+    // keep the newest two and blend from the older to the newer over one capture
+    // interval, frames before them are dropped. Smooth, about one interval behind
+    POSE_FOLLOW_INTERPOLATE
+};
+
+// one pose handed to the render loop by live_pose_source::poll
+struct live_pose_sample {
+    // newest frame, rotations in slot layout (9 floats per slot)
+    const float* rotations = NULL;
+    // frame to blend from, same as rotations unless interpolating
+    const float* previous = NULL;
+    // 0 shows previous, 1 shows rotations
+    float blend = 1.0f;
+    uint64_t sequence = 0;
+    // true the first time a frame is returned
+    bool fresh = false;
+    // seconds since the frame was received
+    double age_seconds = 0;
+};
+
+double pose_follow_clock() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * Frames arriving from outside the process (a growing file, a socket) on a reader thread.
+ * The reader decodes each frame straight into a slot of a lock free pose_frame_queue and
+ * the render loop reads it from that slot with poll(), nothing is copied in between: the
+ * frames a sample points at stay in the queue until a newer one replaces them.
+ *
+ * Subclasses implement run(), the reader thread body, and must call stop() in their
+ * destructor.
+ */
+class live_pose_source {
+public:
+    live_pose_source(const live_pose_source&) = delete;
+    live_pose_source& operator=(const live_pose_source&) = delete;
+
+    virtual ~live_pose_source() {}
+
+    void start() {
+        if (reader.joinable())
+            return;
+        stopping.store(false);
+        reader = std::thread(&live_pose_source::run, this);
+    }
+
+    void stop() {
+        stopping.store(true);
+        if (reader.joinable())
+            reader.join();
+    }
+
+    /**
+     * @brief blocks until base positions have been received
+     *
+     * @param timeout_seconds
+     * @return false on timeout
+     */
+    bool wait_for_base_positions(double timeout_seconds) {
+        double deadline = pose_follow_clock() + timeout_seconds;
+        while (!base_ready.load(std::memory_order_acquire)) {
+            if (pose_follow_clock() > deadline)
+                return false;
+            std::this_thread::sleep_for(std::chrono::microseconds(POSE_FOLLOW_POLL_MICROSECONDS));
+        }
+        return true;
+    }
+
+    // valid once wait_for_base_positions returned true
+    const std::vector<position>& base_positions() const { return base; }
+    const std::vector<std::string>& slot_names() const { return names; }
+
+    /**
+     * @brief render loop side: takes waiting frames according to the policy. The sample
+     * points into the queue and stays valid until the next poll.
+     *
+     * @param policy
+     * @param sample
+     * @return false until the first frame has arrived
+     */
+    bool poll(pose_follow_policy policy, live_pose_sample& sample) {
+        double now = pose_follow_clock();
+        size_t waiting = queue.size();
+        sample.fresh = false;
+
+        // the first held frames are the ones the last sample pointed at
+        if (waiting > held) {
+            size_t current = policy == POSE_FOLLOW_EVERY_FRAME ? held : waiting - 1;
+            size_t previous = policy == POSE_FOLLOW_INTERPOLATE && current > 0 ? current - 1 : current;
+            size_t used = 1 + (previous != current && previous >= held);
+            if (policy != POSE_FOLLOW_EVERY_FRAME)
+                frames_dropped += waiting - held - used;
+
+            queue.pop(previous);
+            held = current - previous + 1;
+            sample.fresh = true;
+
+            frames_shown++;
+            double latency = now - queue.peek_seconds(held - 1);
+            latency_sum += latency;
+            latency_max = std::max(latency_max, latency);
+        }
+        if (held == 0)
+            return false;
+
+        double current_seconds = queue.peek_seconds(held - 1);
+        sample.rotations = queue.peek(held - 1);
+        sample.previous = queue.peek(0);
+        sample.blend = 1.0f;
+        if (held > 1) {
+            double interval = current_seconds - queue.peek_seconds(0);
+            sample.blend = interval > 0 ? (float) std::min(1.0, std::max(0.0, (now - current_seconds) / interval)) : 1.0f;
+        }
+        sample.sequence = queue.peek_sequence(held - 1);
+        sample.age_seconds = now - current_seconds;
+        return true;
+    }
+
+    // reader side counters, safe to read from any thread
+    uint64_t FramesReceived() const { return frames_received.load(std::memory_order_relaxed); }
+    uint64_t BytesRead() const { return bytes_read.load(std::memory_order_relaxed); }
+    uint64_t ReaderWaits() const { return reader_waits.load(std::memory_order_relaxed); }
+
+    // render loop side counters
+    uint64_t FramesShown() const { return frames_shown; }
+    uint64_t FramesDropped() const { return frames_dropped; }
+    double MeanLatencySeconds() const { return frames_shown ? latency_sum / frames_shown : 0; }
+    double MaxLatencySeconds() const { return latency_max; }
+
+protected:
+    /**
+     * @param slot_names rotation name per slot, the layout frames are written in
+     * @param queue_capacity frames buffered between reader and render loop, at least 4
+     * since the render loop holds up to two
+     */
+    live_pose_source(const std::vector<std::string>& slot_names, size_t queue_capacity)
+        : names(slot_names),
+          queue(std::max<size_t>(queue_capacity, 4), slot_names.size() * POSE_STREAM_FLOATS_PER_ROTATION)
+    {}
+
+    // reader thread body, returns once stopping is set
+    virtual void run() = 0;
+
+    std::atomic<bool> stopping{false};
+    std::atomic<uint64_t> bytes_read{0};
+
+    /**
+     * @brief stores the base positions, only the first set received is kept since the
+     * render loop reads them without locking
+     *
+     * @param xyz 3 floats per position
+     * @param count positions
+     */
+    void publish_base_positions(const float* xyz, size_t count) {
+        if (base_ready.load(std::memory_order_relaxed))
+            return;
+        base.resize(count);
+        for (size_t i = 0; i < count; i++)
+            base[i] = position(xyz[i*3], xyz[i*3 + 1], xyz[i*3 + 2]);
+        base_ready.store(true, std::memory_order_release);
+    }
+
+    /**
+     * @brief next queue slot to decode a frame into, waits while the render loop is
+     * behind. Returns NULL once stopping is set.
+     */
+    float* wait_for_slot() {
+        float* slot = queue.begin_push();
+        while (slot == NULL) {
+            reader_waits.fetch_add(1, std::memory_order_relaxed);
+            if (stopping.load())
+                return NULL;
+            std::this_thread::sleep_for(std::chrono::microseconds(POSE_FOLLOW_FULL_WAIT_MICROSECONDS));
+            slot = queue.begin_push();
+        }
+        return slot;
+    }
+
+    // hands the slot from wait_for_slot to the render loop
+    void publish_slot(uint64_t sequence) {
+        queue.end_push(sequence, pose_follow_clock());
+        frames_received.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // every slot identity, for names a frame does not carry
+    void fill_identity(float* slot) const {
+        for (size_t i = 0; i < names.size(); i++) {
+            float* rotation = slot + i * POSE_STREAM_FLOATS_PER_ROTATION;
+            std::fill(rotation, rotation + POSE_STREAM_FLOATS_PER_ROTATION, 0.0f);
+            rotation[0] = rotation[4] = rotation[8] = 1.0f;
+        }
+    }
+
+    int find_slot(const char* name, size_t length) const {
+        for (size_t i = 0; i < names.size(); i++) {
+            if (names[i].size() == length && std::memcmp(names[i].data(), name, length) == 0)
+                return i;
+        }
+        return -1;
+    }
+
+    // the next text line is a base positions line again, e.g. on a new connection
+    void restart_text() {
+        text_started = false;
+    }
+
+    /**
+     * @brief parses the complete lines in data, the capture text format: base positions
+     * on the first line, FRAME lines after it
+     *
+     * @param data
+     * @param size
+     * @return bytes consumed, a trailing partial line is left for the next call
+     */
+    size_t parse_text_lines(const char* data, size_t size) {
+        size_t line_start = 0;
+        while (!stopping.load()) {
+            const char* newline = (const char*) memchr(data + line_start, '\n', size - line_start);
+            if (newline == NULL)
+                break;
+            parse_text_line(data + line_start, newline);
+            line_start = newline - data + 1;
+        }
+        return line_start;
+    }
+
+private:
+    std::vector<std::string> names;
+    pose_frame_queue queue;
+
+    std::thread reader;
+    std::atomic<bool> base_ready{false};
+    std::vector<position> base;
+
+    // reader state
+    bool text_started = false;
+    uint64_t text_sequence = 0;
+    std::atomic<uint64_t> frames_received{0};
+    std::atomic<uint64_t> reader_waits{0};
+
+    // render loop state, frames at the front of the queue the last sample points at
+    size_t held = 0;
+    uint64_t frames_shown = 0;
+    uint64_t frames_dropped = 0;
+    double latency_sum = 0;
+    double latency_max = 0;
+
+    void parse_text_line(const char* begin, const char* end) {
+        if (end > begin && end[-1] == '\r')
+            end--;
+        if (end == begin)
+            return;
+
+        if (!text_started) {
+            text_started = true;
+            std::vector<float> xyz(max_floats_in(end - begin));
+            size_t count = parse_keypoints(begin, end, xyz.data(), xyz.size() / 3);
+            publish_base_positions(xyz.data(), count);
+            return;
+        }
+
+        float* slot = wait_for_slot();
+        if (slot == NULL)
+            return;
+        PROFILE_STAGE(STAGE_PARSE);
+        fill_identity(slot);
+        size_t matrices = for_each_matrix_in_line(begin, end,
+            [&](const char* name, size_t length, const float* rotation) {
+                int index = find_slot(name, length);
+                if (index >= 0)
+                    std::memcpy(slot + index * POSE_STREAM_FLOATS_PER_ROTATION, rotation,
+                        POSE_STREAM_FLOATS_PER_ROTATION * sizeof(float));
+            });
+        if (matrices > 0)
+            publish_slot(text_sequence++);
+    }
+};
+
+/**
+ * @brief retargets a live sample and writes it in draw order into out, blending the
+ * previous frame in when the source is interpolating. out may be a mapped buffer, it is
+ * only written.
+ *
+ * @param plan compiled against the source's slot names
+ * @param sample
+ * @param base_positions
+ * @param draw_order
+ * @param scratch working positions
+ * @param current_xyz scratch, draw_order.size() * 3 floats
+ * @param previous_xyz scratch, draw_order.size() * 3 floats
+ * @param out draw_order.size() * 3 floats
+ */
+void retarget_live_sample_into(
+    const retarget_plan& plan,
+    const live_pose_sample& sample,
+    const std::vector<position>& base_positions,
+    const std::vector<int>& draw_order,
+    std::vector<position>& scratch,
+    std::vector<float>& current_xyz,
+    std::vector<float>& previous_xyz,
+    float* out)
+{
+    if (sample.blend >= 1.0f || sample.previous == sample.rotations) {
+        retarget_frame_into(plan, sample.rotations, base_positions, draw_order, scratch, out);
+        return;
+    }
+    current_xyz.resize(draw_order.size() * 3);
+    previous_xyz.resize(draw_order.size() * 3);
+    retarget_frame_into(plan, sample.rotations, base_positions, draw_order, scratch, current_xyz.data());
+    retarget_frame_into(plan, sample.previous, base_positions, draw_order, scratch, previous_xyz.data());
+    for (size_t i = 0; i < current_xyz.size(); i++)
+        out[i] = previous_xyz[i] + (current_xyz[i] - previous_xyz[i]) * sample.blend;
+}
+
+#endif
@@ -18,6 +18,7 @@
 #include <cmath>
 #include <chrono>
 #include <fstream>
+#include <memory>
 #include <regex>
 
 #include "ShaderUtils.h"
@@ -31,16 +32,51 @@
 #include "filesystem.h"
 #include "Animator.hpp"
 #include "skeleton_loader_helper.hpp"
+#include "pose_stream.hpp"
+#include "retarget_plan.hpp"
+#include "pose_cache.hpp"
+#include "pose_playback.hpp"
+#include "pose_pipeline.hpp"
+#include "pose_follower.hpp"
+#include "pose_ingest.hpp"
+#include "StreamingBuffer.h"
+#include "BonePaletteBuffer.h"
+#include "StageProfiler.h"
+#include "Logger.h"
 #include "rotations_test.hpp"
+#include "pose_benchmarks.hpp"
+#include "animation_benchmarks.hpp"
 #include "dancingVampireUtils.hpp"
 #include "AssimpGLMHelpers.h"
 
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
 
-const unsigned int ANIMATION_UPDATE_FRAMES = 5;
+// rate the joints_output clips were captured at, playback follows wall time at this rate
+const double POSE_CAPTURE_FPS = 30.0;
+// how a render frame between two capture frames is posed, POSE_INTERPOLATE_NONE shows the
+// pre-retargeted clip_cache frames as they are
+const pose_interpolation POSE_PLAYBACK_INTERPOLATION = POSE_INTERPOLATE_FAST_SLERP;
 
-unsigned int current_frame = 0;
+// the vampire model is only read for its bones, so its CPU vertex copies are dropped. Its
+// meshes stay on the full layout the skeleton_animation shader reads, MESH_LAYOUT_COMPACT
+// only for models drawn with skeleton_animation_compact
+const MeshStorage MODEL_MESH_STORAGE = {MESH_LAYOUT_FULL, false, MESH_RELEASE_CPU};
+
+// LOG_LEVEL_DEBUG brings back the model dumps and the per frame "at frame" line
+const LogLevel LOG_LEVEL = LOG_LEVEL_INFO;
+// stage timings of the run are written here on exit, open in chrome://tracing
+const std::string PROFILE_TRACE_PATH = "frame_trace.json";
+
+pose_playback_clock playback;
+
+// capture file another process is appending to. When set, its poses are shown as they
+// arrive instead of looping the clip
+const std::string LIVE_CAPTURE_PATH = "";
+// or a socket / pipe the capture process connects to, e.g. POSE_INGEST_DEFAULT_ENDPOINT
+// (tools/pose_replay.cpp --connect stands in for one)
+const std::string LIVE_INGEST_ENDPOINT = "";
+const pose_follow_policy LIVE_CAPTURE_POLICY = POSE_FOLLOW_INTERPOLATE;
 
 bool should_stop = false;
 
@@ -54,16 +90,17 @@ auto joint_to_index = name_to_index();
 auto index_to_joint = hashtable_from_const();
 std::vector<position> vamp_pos(64);
 
-void processInput(GLFWwindow *window, Shader shader) {
+void processInput(GLFWwindow *window, Shader &shader) {
 
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
         glfwSetWindowShouldClose(window, true);
     } 
     if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS) {
         should_stop = !should_stop;
+        playback.paused = should_stop;
     }
     if (glfwGetKey(window, GLFW_KEY_ENTER) == GLFW_PRESS) {
-        current_frame += 1;
+        playback.step(1);
     } 
 
     camera.processInputForCamera(window);
@@ -92,7 +129,7 @@ void getBaseWorldPosFromChildren(AssimpNodeData currentNode, glm::mat4 transform
         
     if (joint_to_index.find(name) != joint_to_index.end()) {
         vamp_pos[joint_to_index[name]] = position(localPosition.x, localPosition.y, localPosition.z);
-        std::cout << name << ": " << position(localPosition.x, localPosition.y, localPosition.z).toString() << std::endl;
+        LOG_DEBUG(name << ": " << position(localPosition.x, localPosition.y, localPosition.z).toString());
 
         for (auto child : currentNode.children) {
             getBaseWorldPosFromChildren(child, localTransform, scale);
@@ -111,38 +148,34 @@ void getWorldPositionFromBones(AssimpNodeData baseNode, float scale) {
 
     vamp_pos[joint_to_index[name]] = position(localPosition.x, localPosition.y, localPosition.z);
 
-    std::cout << name << ": " << position(localPosition.x, localPosition.y, localPosition.z).toString() << std::endl;
+    LOG_DEBUG(name << ": " << position(localPosition.x, localPosition.y, localPosition.z).toString());
 
     for (auto child : baseNode.children) {
         getBaseWorldPosFromChildren(child, localTransform, scale);
     }
 }
 
-void dump_vampire_into_file(bodymodel vamp) {
-
-    std::ofstream vamp_dump_file ("vamp_dump.txt");
-    std::string vamp_line = "[";
-    for (int i = 0; i < vamp.positions.size(); i++) {
-        position pos = vamp.positions[i];
-        vamp_line += pos.toString();
-        if (i != vamp.positions.size() - 1)
-            vamp_line += ", ";
-    }
-    vamp_line += "]";
-    vamp_dump_file << vamp_line << std::endl;
-    vamp_dump_file.close();
-    std::cout << "POSITONS SIZE:";
-    std::cout << split_blaze_keypoints(vamp_line, false).size() << std::endl;
-    std::cout << "POSITIONS DUMP: " << std::endl;
-    std::cout << vamp_line << std::endl;
-} 
-
 int main()
 {
 
     // test_basic_rotations();
+    // test_fk_matches_single_bone_rotations();
+    // return 0;
+
+    // benchmark_bone_rotation();
+    // benchmark_keyframe_lookup();
+    // benchmark_animator_update();
+    // benchmark_animator_crowd();
+    // benchmark_cpu_skinning();
+    // benchmark_compact_vertices();
+    // benchmark_keypoint_parser();
+    // benchmark_pose_follow_latency();
+    // benchmark_pose_playback();
+    // benchmark_pose_archive();
     // return 0;
 
+    logger.SetLevel(LOG_LEVEL);
+
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
@@ -175,88 +208,153 @@ int main()
 
     Shader lightingShader("point_shader");
     lightingShader.use();
-
-    auto [base_model, name_rotation_list] = load_vamp_model_from_file("ymca_blaze_vamp.txt");
-    // auto [base_model, name_rotation_list] = load_vamp_model_from_file("head_test_blaze_vamp.txt");
+    // uniform locations are resolved once, the render loop sets them by location
+    int projectionLocation = lightingShader.GetUniformLocation("projection");
+    int viewLocation = lightingShader.GetUniformLocation("view");
+    int modelLocation = lightingShader.GetUniformLocation("model");
+
+    // text captures are converted to a binary pose stream once, then mapped on every launch
+    pose_stream pose_frames;
+    bodymodel base_model = load_vamp_model_from_stream(ensure_pose_stream("ymca_blaze_vamp.txt"), pose_frames);
+    // bodymodel base_model = load_vamp_model_from_stream(ensure_pose_stream("head_test_blaze_vamp.txt"), pose_frames);
+    if (pose_frames.frame_count() == 0) {
+        std::cout << "Failed to load pose frames" << std::endl;
+        return -1;
+    }
     bodymodel current_model = base_model;
-    std::vector<std::vector<float>> positions = base_model.vectorify_positions_in_order();
-    // flatten vertices seperate by time to single list for easy retrieval
-    std::vector<float> flat_positions = flatten(positions);
 
     // path from models folder to desired obj files...
     std::string path = std::string("./src/models/dancing_vampire/dancing_vampire.dae");
 
-    Model local_model(path);
-
-    std::cout << "CREATED SHADER" << std::endl;    
+    // meshes, bones, hierarchy and clips come from the baked cache next to the file, assimp
+    // only runs when it is missing or stale
+    ModelCache model_cache;
+    if (!model_cache.Load(FileSystem::getPath(path))) {
+        std::cerr << "Error loading model: " << path << std::endl;
+        return -1;
+    }
+    const ModelCacheTimes& cacheTimes = model_cache.Times();
+    LOG_INFO("vampire model cache " << (model_cache.Warm() ? "warm" : "cold") << ": hash " << cacheTimes.hashMs
+        << " ms, assimp " << cacheTimes.importMs << " ms, bake " << cacheTimes.writeMs << " ms, map " << cacheTimes.mapMs << " ms");
+    Model local_model(model_cache.Data(), false, MODEL_MESH_STORAGE);
+    size_t modelCpuBytes, modelGpuBytes;
+    local_model.MemoryFootprint(modelCpuBytes, modelGpuBytes);
+    LOG_INFO("vampire model meshes: " << modelCpuBytes / 1024 << " KB on the CPU, " << modelGpuBytes / 1024 << " KB in GL buffers");
+    LOG_INFO("vampire model load: " << local_model.textureStats.textureCount
+        << " textures decoded in " << local_model.textureStats.decodeMs << " ms, uploaded in "
+        << local_model.textureStats.uploadMs << " ms" << (local_model.textureStats.stagedInPbo ? " through a PBO" : ""));
+
+    LOG_DEBUG("CREATED SHADER");
 
     // create camera
     camera = AccelerationCamera(SCR_WIDTH, SCR_HEIGHT);
 
     // setting up animation
 
-    Animation danceAnimation(FileSystem::getPath(path),
-        &local_model);
+    // every clip in the file, sharing the model's bone registry
+    std::vector<Animation> clips = LoadAnimations(model_cache.Data());
+    if (clips.empty()) {
+        std::cerr << "Error loading model: no animation in " << path << std::endl;
+        return -1;
+    }
+    Animation& danceAnimation = clips[0];
     Animator animator(&danceAnimation);
 
     
     bodymodel dancing_vampire = create_local_dancing_vampire_model();
-    std::cout << "_____" << std::endl;
+    LOG_DEBUG("_____");
     auto baseNode = danceAnimation.m_RootNode.children[0];
     getWorldPositionFromBones(baseNode, 0.01f);
 
-    
-    Assimp::Importer importer;
-    const aiScene* scene = importer.ReadFile(FileSystem::getPath(path), aiProcess_Triangulate | aiProcess_FlipUVs);
-
-    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
-        std::cerr << "Error loading model: " << importer.GetErrorString() << std::endl;
-        return -1;
-    }
 
     dancing_vampire.set_positions(vamp_pos);
-    std::cout << dancing_vampire.toString() << std::endl;
-    std::cout << "___________________" << std::endl;
-    std::cout << current_model.toString() << std::endl;
+    LOG_DEBUG(dancing_vampire.toString());
+    LOG_DEBUG("___________________");
+    LOG_DEBUG(current_model.toString());
 
     // TODO !! this grabs out position information to calc rotations for blazepoze model... keep
-    // around to send over utf8 pipe
+    // around, live poses now come in over LIVE_INGEST_ENDPOINT (pose_ingest.hpp)
     // dump_vampire_into_file(dancing_vampire);
     bodymodel blaze_model = create_adjusted_blaze_model();
+    // resolve bone names and chains once, the render loop only walks the plan
+    retarget_plan retarget = compile_retarget_plan(blaze_model, base_model, pose_frames.bone_names());
+    std::vector<int> clip_draw_order = base_model.position_indices_in_order();
+    // xyz per drawn position, the size of one frame in the streaming ring
+    const size_t clip_floats_per_frame = clip_draw_order.size() * 3;
+    // frames loop, so without interpolation the whole clip is retargeted up front and only
+    // indexed while rendering
+    pose_cache clip_cache;
+    if (POSE_PLAYBACK_INTERPOLATION == POSE_INTERPOLATE_NONE) {
+        work_stealing_pool retarget_pool;
+        clip_cache = build_pose_cache(retarget, pose_frames, base_model, retarget_pool);
+    }
+    // the same clip as quaternions, blended between capture frames at the render rate
+    pose_quaternion_track clip_track(pose_frames);
+    std::vector<float> clip_rotations;
+    pose_interpolation_scratch clip_interpolation;
+    std::vector<position> clip_scratch;
+    playback = pose_playback_clock(pose_frames.frame_count(), POSE_CAPTURE_FPS);
+    playback.paused = should_stop;
+
+    // live capture: frames use the same slots as the stream, the plan is rebuilt against
+    // the capture's own base positions once they arrive
+    std::unique_ptr<live_pose_source> live_source;
+    if (!LIVE_CAPTURE_PATH.empty())
+        live_source.reset(new pose_file_follower(LIVE_CAPTURE_PATH, pose_frames.bone_names()));
+    else if (!LIVE_INGEST_ENDPOINT.empty())
+        live_source.reset(new pose_ingest_server(LIVE_INGEST_ENDPOINT, pose_frames.bone_names()));
+    bool live = live_source != nullptr;
+    bodymodel live_model = base_model;
+    retarget_plan live_retarget = retarget;
+    std::vector<int> live_draw_order = base_model.position_indices_in_order();
+    live_pose_sample live_sample;
+    std::vector<position> live_scratch;
+    std::vector<float> live_current_xyz;
+    std::vector<float> live_previous_xyz;
+    if (live) {
+        live_source->start();
+        if (!live_source->wait_for_base_positions(10.0) ||
+            live_source->base_positions().size() != base_model.positions.size()) {
+            std::cout << "ERROR: NO BASE POSITIONS FROM LIVE CAPTURE" << std::endl;
+            return -1;
+        }
+        live_model.set_positions(live_source->base_positions());
+        live_retarget = compile_retarget_plan(blaze_model, live_model, live_source->slot_names());
+    }
 
-    auto [new_current_model, translation_map] = apply_rotations_to_vamp_model(name_rotation_list[0], current_model, blaze_model);
-    std::cout << "APPLIED ROTATIONS TO MODEL" << std::endl;
+    auto [new_current_model, translation_map] = apply_rotations_to_vamp_model(pose_frames.frame(0), current_model, blaze_model);
+    LOG_DEBUG("APPLIED ROTATIONS TO MODEL");
     current_model = new_current_model;
-    std::cout << "_____________" << std::endl;
-    for (bone bj : dancing_vampire.base_bones) {
+    LOG_DEBUG("_____________");
+    for (bone bj : dancing_vampire.skel->base_bones) {
         position new_pos;
         if (translation_map.find(bj.name) != translation_map.end()) 
             new_pos = translation_map[bj.name].add(dancing_vampire.positions[bj.child_index]);
         else 
             new_pos = dancing_vampire.positions[bj.child_index];
 
-        std::cout << "joint: " << bj.name << " pos: " << dancing_vampire.positions[bj.child_index].toString() 
-            << ", new pos: "  << new_pos.toString() << std::endl;
-        for (bone cj : dancing_vampire.bones_flow[bj]) {
+        LOG_DEBUG("joint: " << bj.name << " pos: " << dancing_vampire.positions[bj.child_index].toString() 
+            << ", new pos: "  << new_pos.toString());
+        for (bone cj : dancing_vampire.flow(bj)) {
         position new_pos;
         if (translation_map.find(cj.name) != translation_map.end()) 
             new_pos = translation_map[cj.name].add(dancing_vampire.positions[cj.child_index]);
         else 
             new_pos = dancing_vampire.positions[cj.child_index];
 
-        std::cout << "joint: " << cj.name << " pos: " << dancing_vampire.positions[cj.child_index].toString() 
-            << ", new pos: "  << new_pos.toString() << std::endl;
+        LOG_DEBUG("joint: " << cj.name << " pos: " << dancing_vampire.positions[cj.child_index].toString() 
+            << ", new pos: "  << new_pos.toString());
         }
     }
 
-    unsigned int VBO, VAO;
+    unsigned int VAO;
     glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
+    // pose vertices change every frame, so they go through a streaming ring instead of a static buffer
+    StreamingBuffer pose_vertices(sizeof(float) * clip_floats_per_frame, 3 * sizeof(float));
     // bind the Vertex Array Object first, then bind and set vertex buffer(s), and then configure vertex attributes(s).
     glBindVertexArray(VAO);
 
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * flat_positions.size(), &flat_positions[0], GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, pose_vertices.VBO);
 
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
@@ -278,6 +376,7 @@ int main()
     glPointSize(10.0f);
     unsigned int starting_pos = 0;
     while (!glfwWindowShouldClose(window)) {
+        PROFILE_STAGE(STAGE_FRAME);
 
         // per frame logic 
 
@@ -287,74 +386,114 @@ int main()
 
 
         processInput(window, lightingShader);
-        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        GL_COUNTED(glClearColor(0.0f, 0.0f, 0.0f, 0.0f));
+        GL_COUNTED(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
 
         // setting up shader lighting uniforms
         
         glm::mat4 projection = camera.getProjection();
         glm::mat4 view = camera.getView();
-        lightingShader.setMat4("projection", projection);
-        lightingShader.setMat4("view", view);
+        lightingShader.setMat4(projectionLocation, projection);
+        lightingShader.setMat4(viewLocation, view);
 
-        // // auto transforms = animator.GetFinalBoneMatrices();
-        // // for (int i = 0; i < transforms.size(); ++i)
-        // //     lightingShader.setMat4("finalBonesMatrices[" + std::to_string(i) + "]", transforms[i]);
+        // skinned shaders read the bones from the BonePalette block, one buffer write per frame:
+        // // BonePaletteBuffer bonePalette;   // once, with skinningShader.BindUniformBlock("BonePalette", bonePalette.BindingPoint())
+        // // animator.UpdateAnimation(deltaTime);
+        // // bonePalette.Upload(animator.GetFinalBoneMatrices());
 
 
         glm::mat4 model = glm::mat4(1.0f);
         model = glm::translate(model, glm::vec3(0.0f, 0.0f, 0.0f));
         model = glm::scale(model, glm::vec3(1.0f, 1.0f, 1.0f));	
-        lightingShader.setMat4("model", model);
+        lightingShader.setMat4(modelLocation, model);
+
+        // write this frame's pose into the streaming ring
+        // the upload stage covers only the ring writes. The pose is retargeted straight into
+        // the mapped range in between, apply_retarget_plan and write_positions_in_order time
+        // themselves under the retarget and flatten stages
+        if (live) {
+            // the rest pose until the first frame arrives
+            float* live_vertices;
+            {
+                PROFILE_STAGE(STAGE_UPLOAD);
+                live_vertices = (float*) pose_vertices.BeginWrite();
+            }
+            if (live_source->poll(LIVE_CAPTURE_POLICY, live_sample))
+                retarget_live_sample_into(live_retarget, live_sample, live_model.positions, live_draw_order,
+                    live_scratch, live_current_xyz, live_previous_xyz, live_vertices);
+            else
+                write_positions_in_order(live_model.positions, live_draw_order, live_vertices);
+            {
+                PROFILE_STAGE(STAGE_UPLOAD);
+                pose_vertices.EndWrite(sizeof(float) * clip_floats_per_frame);
+            }
+        } else {
+            playback.advance(deltaTime);
+            LOG_DEBUG("at frame: " << playback.frame_position());
+            if (POSE_PLAYBACK_INTERPOLATION == POSE_INTERPOLATE_NONE) {
+                PROFILE_STAGE(STAGE_UPLOAD);
+                pose_vertices.Upload(clip_cache.frame(playback.frame()), sizeof(float) * clip_floats_per_frame);
+            } else {
+                float* clip_vertices;
+                {
+                    PROFILE_STAGE(STAGE_UPLOAD);
+                    clip_vertices = (float*) pose_vertices.BeginWrite();
+                }
+                retarget_playback_frame_into(retarget, clip_track, playback.frame_position(), POSE_PLAYBACK_INTERPOLATION,
+                    base_model.positions, clip_draw_order, clip_rotations, clip_interpolation, clip_scratch, clip_vertices);
+                {
+                    PROFILE_STAGE(STAGE_UPLOAD);
+                    pose_vertices.EndWrite(sizeof(float) * clip_floats_per_frame);
+                }
+            }
+        }
+
         // render the loaded model
-        glBindVertexArray(VAO); 
-        glDrawArrays(GL_POINTS, 0, flat_positions.size()/3);
-        glDrawArrays(GL_LINES, 0, flat_positions.size()/3);
+        {
+            PROFILE_STAGE(STAGE_DRAW);
+            GL_COUNTED(glBindVertexArray(VAO));
+            GL_COUNTED(glDrawArrays(GL_POINTS, pose_vertices.FirstVertex(), (GLsizei) clip_draw_order.size()));
+            GL_COUNTED(glDrawArrays(GL_LINES, pose_vertices.FirstVertex(), (GLsizei) clip_draw_order.size()));
+            pose_vertices.FenceDraws();
+        }
         e = glGetError();
         if (e != GL_NO_ERROR) {
             fprintf(stderr, "OpenGL error in \"%s\": %d (%d)\n", "draw", e, e);
             exit(20);
         }
 
-        // // update animation every 5 frames
-        // if (false) {
-        if (true) {
-            std::cout << "at frame: " << current_frame << std::endl;
-            current_frame %= name_rotation_list.size();
-            auto [new_current_model, new_translation_map] = apply_rotations_to_vamp_model(name_rotation_list[current_frame], base_model, blaze_model);
-            current_model = new_current_model;
-            translation_map = new_translation_map;
-            flat_positions = flatten(current_model.vectorify_positions_in_order());
-            glBindVertexArray(VAO);
-
-            glBindBuffer(GL_ARRAY_BUFFER, VBO);
-
-            glBufferData(GL_ARRAY_BUFFER, sizeof(float) * flat_positions.size(), &flat_positions[0], GL_STATIC_DRAW);
-
-            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-
-            glEnableVertexAttribArray(0);
-            glBindVertexArray(0); 
-
-
-            if (num_renders % ANIMATION_UPDATE_FRAMES == 0 && !should_stop)
-                current_frame = (current_frame + 1);
+        {
+            PROFILE_STAGE(STAGE_SWAP);
+            glfwSwapBuffers(window);
         }
-
-        glfwSwapBuffers(window);
         glfwPollEvents();
+        glCalls.EndFrame();
 
         // time it takes for it to render 60 frames ...
         auto stop = std::chrono::high_resolution_clock::now();
         num_renders++;
         if (num_renders % 60 == 0) {
             auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start);
-            std::cout << "Has taken " << duration.count() << " mili seconds for 60 frames..." << std::endl;
+            LOG_INFO("Has taken " << duration.count() << " mili seconds for 60 frames, "
+                << glCalls.lastFrame << " GL calls last frame");
+            if (live)
+                LOG_INFO("live: " << live_source->FramesShown() << " frames shown, " << live_source->FramesDropped()
+                    << " dropped, latency mean " << live_source->MeanLatencySeconds() * 1000.0 << " ms, max "
+                    << live_source->MaxLatencySeconds() * 1000.0 << " ms");
             start = std::chrono::high_resolution_clock::now();
         }
     }
 
+    pose_vertices.Release();
     glfwTerminate();
+
+    if (live)
+        live_source->stop();
+    logger.Flush();
+    // per stage percentiles of the whole run, the details go to the trace
+    stageProfiler.PrintSummary(std::cout);
+    if (stageProfiler.WriteChromeTrace(PROFILE_TRACE_PATH))
+        std::cout << "wrote stage trace to " << PROFILE_TRACE_PATH << std::endl;
     return 0;
 }
 
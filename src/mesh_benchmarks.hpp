@@ -0,0 +1,178 @@
+#ifndef MESH_BENCHMARKS_HPP
+#define MESH_BENCHMARKS_HPP
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <cmath>
+
+#include "Vertex.h"
+#include "CompactVertex.h"
+#include "CpuSkinner.h"
+#include "benchmark_common.hpp"
+
+/**
+ * @brief vertices weighted to a synthetic skeleton, 1 to 4 influences each with the
+ * rest -1, and every 97th vertex given an id past MAX_BONES to cover the shader's rules
+ *
+ * @param vertex_count
+ * @param bone_count
+ * @return std::vector<Vertex>
+ */
+std::vector<Vertex> build_synthetic_skinned_vertices(unsigned int vertex_count, unsigned int bone_count) {
+    std::vector<Vertex> vertices(vertex_count);
+    for (unsigned int i = 0; i < vertex_count; i++) {
+        Vertex& vertex = vertices[i];
+        float angle = 0.013f * i;
+        vertex.Position = glm::vec3(std::sin(angle), 0.001f * i, std::cos(angle));
+        vertex.Normal = glm::normalize(glm::vec3(std::sin(angle), 0.2f, std::cos(angle)));
+        vertex.Tangent = glm::normalize(glm::cross(glm::vec3(0.0f, 1.0f, 0.0f), vertex.Normal));
+        vertex.Bitangent = glm::cross(vertex.Normal, vertex.Tangent);
+        vertex.TexCoords = glm::vec2(std::fmod(0.37f * i, 1.0f), std::fmod(0.0011f * i, 1.0f));
+        unsigned int influences = 1 + i % MAX_BONE_INFLUENCE;
+        float weight_sum = 0;
+        for (unsigned int k = 0; k < MAX_BONE_INFLUENCE; k++) {
+            bool used = k < influences;
+            vertex.m_BoneIDs[k] = used ? (i * 7 + k * 13) % bone_count : -1;
+            vertex.m_Weights[k] = used ? 1.0f + k : 0.0f;
+            weight_sum += vertex.m_Weights[k];
+        }
+        for (unsigned int k = 0; k < MAX_BONE_INFLUENCE; k++)
+            vertex.m_Weights[k] /= weight_sum;
+        if (i % 97 == 0)
+            vertex.m_BoneIDs[i % MAX_BONE_INFLUENCE] = CPU_SKINNER_MAX_BONES + 5;
+    }
+    return vertices;
+}
+
+// a posed palette, every bone rotated and moved a little differently
+std::vector<glm::mat4> synthetic_bone_palette(unsigned int bone_count) {
+    std::vector<glm::mat4> palette(bone_count);
+    for (unsigned int i = 0; i < bone_count; i++) {
+        glm::mat4 moved = glm::translate(glm::mat4(1.0f), glm::vec3(0.01f * i, -0.02f * i, 0.5f));
+        palette[i] = glm::rotate(moved, 0.05f * i, glm::normalize(glm::vec3(1.0f, 0.3f * i, 0.5f)));
+    }
+    return palette;
+}
+
+/**
+ * @brief packing throughput and round trip error of one compact layout: normal / tangent
+ * angle, UV error in texels of a 4096 texture, weight error and the resulting skinned
+ * position error relative to the mesh's extent
+ *
+ * @param name
+ * @param vertices
+ * @param palette
+ */
+template <typename WeightT>
+void report_compact_vertices(const char* name, const std::vector<Vertex>& vertices, const std::vector<glm::mat4>& palette) {
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<CompactVertexT<WeightT>> packed = PackVertices<WeightT>(vertices);
+    auto stop = std::chrono::high_resolution_clock::now();
+    double ms = std::chrono::duration<double, std::milli>(stop - start).count();
+    benchmark_sink = packed[packed.size() / 2].Position.x;
+
+    CompactVertexError error = MeasureCompactVertexError<WeightT>(vertices, CPU_SKINNER_MAX_BONES);
+    glm::vec3 low(1e30f), high(-1e30f);
+    double position_error = 0;
+    for (size_t i = 0; i < vertices.size(); i++) {
+        glm::vec3 expected = glm::vec3(SkinVertexLikeShader(vertices[i], palette));
+        glm::vec3 decoded = glm::vec3(SkinVertexLikeShader(UnpackVertex(packed[i]), palette));
+        low = glm::min(low, expected);
+        high = glm::max(high, expected);
+        position_error = std::max(position_error, (double) glm::length(expected - decoded));
+    }
+    double extent = glm::length(high - low);
+
+    std::cout << name << ": " << sizeof(CompactVertexT<WeightT>) << " bytes per vertex, packed " << vertices.size()
+        << " in " << ms << " ms (" << vertices.size() / ms / 1e3 << " Mvertices/s); normal " << error.maxNormalDegrees
+        << " deg, tangent " << error.maxTangentDegrees << " deg, uv " << error.maxTexCoord * 4096.0
+        << " texels @4096, weight " << error.maxWeight << ", bone id mismatches " << error.boneIDMismatches
+        << ", skinned position " << (extent > 0 ? position_error / extent : 0) << " of the mesh extent" << std::endl;
+}
+
+/**
+ * @brief bytes per vertex of each layout and the compact layouts' precision, see
+ * report_compact_vertices
+ *
+ * @param vertex_count
+ * @param bone_count
+ */
+void benchmark_compact_vertices(unsigned int vertex_count = 200000, unsigned int bone_count = 100) {
+    std::vector<Vertex> vertices = build_synthetic_skinned_vertices(vertex_count, bone_count);
+    std::vector<glm::mat4> palette = synthetic_bone_palette(bone_count);
+    VertexSoA soa(vertices);
+    std::cout << "bytes per vertex: full " << sizeof(Vertex) << ", soa " << soa.Bytes() / vertex_count << std::endl;
+    report_compact_vertices<uint16_t>("compact", vertices, palette);
+    report_compact_vertices<uint8_t>("compact 8 bit weights", vertices, palette);
+}
+
+struct mesh_upload_result {
+    size_t bytes = 0;
+    double pack_ms = 0;
+    double upload_ms = 0;
+};
+
+/**
+ * @brief times static vertex buffer uploads (glBufferData + glFinish) in the full and the
+ * compact layouts, packing included for compact. Needs a current GL context.
+ *
+ * @param vertices
+ * @param storage layout and weight width
+ * @param uploads
+ * @return per upload averages
+ */
+mesh_upload_result run_mesh_upload_benchmark(const std::vector<Vertex>& vertices, MeshStorage storage, unsigned int uploads) {
+    unsigned int VBO;
+    glGenBuffers(1, &VBO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+
+    mesh_upload_result result;
+    std::vector<CompactVertex> packed;
+    std::vector<CompactVertex8> packed8;
+    for (unsigned int u = 0; u < uploads; u++) {
+        auto start = std::chrono::high_resolution_clock::now();
+        const void* data = vertices.data();
+        result.bytes = vertices.size() * sizeof(Vertex);
+        if (storage.layout == MESH_LAYOUT_COMPACT && storage.weights8) {
+            packed8 = PackVertices<uint8_t>(vertices);
+            data = packed8.data();
+            result.bytes = packed8.size() * sizeof(CompactVertex8);
+        } else if (storage.layout == MESH_LAYOUT_COMPACT) {
+            packed = PackVertices<uint16_t>(vertices);
+            data = packed.data();
+            result.bytes = packed.size() * sizeof(CompactVertex);
+        }
+        auto packed_at = std::chrono::high_resolution_clock::now();
+        glBufferData(GL_ARRAY_BUFFER, result.bytes, data, GL_STATIC_DRAW);
+        glFinish();
+        auto stop = std::chrono::high_resolution_clock::now();
+        result.pack_ms += std::chrono::duration<double, std::milli>(packed_at - start).count() / uploads;
+        result.upload_ms += std::chrono::duration<double, std::milli>(stop - packed_at).count() / uploads;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glDeleteBuffers(1, &VBO);
+    return result;
+}
+
+void run_mesh_upload_benchmarks(unsigned int vertex_count = 200000, unsigned int uploads = 50) {
+    std::vector<Vertex> vertices = build_synthetic_skinned_vertices(vertex_count, 100);
+    const char* names[] = {"full", "compact", "compact 8 bit weights"};
+    MeshStorage storages[3];
+    storages[1].layout = MESH_LAYOUT_COMPACT;
+    storages[2].layout = MESH_LAYOUT_COMPACT;
+    storages[2].weights8 = true;
+    for (int i = 0; i < 3; i++) {
+        mesh_upload_result r = run_mesh_upload_benchmark(vertices, storages[i], uploads);
+        std::cout << "mesh upload " << names[i] << ", " << vertex_count << " vertices: " << r.bytes / 1e6 << " MB, pack "
+            << r.pack_ms << " ms, upload " << r.upload_ms << " ms ("
+            << (r.upload_ms > 0 ? r.bytes / r.upload_ms / 1e3 : 0) << " MB/s)" << std::endl;
+    }
+}
+
+#endif
@@ -0,0 +1,127 @@
+#ifndef MODEL_CACHE_BENCHMARK_HPP
+#define MODEL_CACHE_BENCHMARK_HPP
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+#include "ModelCache.h"
+#include "model_animation.h"
+#include "Animation.hpp"
+
+struct model_startup_result {
+    ModelCacheTimes cache;
+    double model_ms = 0;
+    double texture_decode_ms = 0;
+    double texture_upload_ms = 0;
+    double animation_ms = 0;
+    double total_ms = 0;
+    size_t clip_count = 0;
+};
+
+/**
+ * @brief the model + animation part of startup without the cache: one ModelImport pass,
+ * then the Model and every clip built from it
+ *
+ * @param path
+ * @param storage
+ * @return model_startup_result
+ */
+model_startup_result run_uncached_model_startup(const std::string& path, MeshStorage storage) {
+    typedef std::chrono::high_resolution_clock clock;
+    model_startup_result result;
+    auto start = clock::now();
+    ModelImport import;
+    if (!import.Read(path))
+        return result;
+    auto imported = clock::now();
+    Model model(import.Data(), false, storage);
+    auto modelled = clock::now();
+    std::vector<Animation> clips = LoadAnimations(import.Data());
+    auto stop = clock::now();
+
+    result.cache.importMs = std::chrono::duration<double, std::milli>(imported - start).count();
+    result.model_ms = std::chrono::duration<double, std::milli>(modelled - imported).count();
+    result.texture_decode_ms = model.textureStats.decodeMs;
+    result.texture_upload_ms = model.textureStats.uploadMs;
+    result.animation_ms = std::chrono::duration<double, std::milli>(stop - modelled).count();
+    result.total_ms = std::chrono::duration<double, std::milli>(stop - start).count();
+    result.clip_count = clips.size();
+    return result;
+}
+
+/**
+ * @brief ModelCache::Load followed by Model and Animation built from its data. Cold removes
+ * the cache first so Load imports and bakes, warm maps the cache the previous run left.
+ *
+ * @param path
+ * @param storage
+ * @param cold
+ * @return model_startup_result
+ */
+model_startup_result run_cached_model_startup(const std::string& path, MeshStorage storage, bool cold) {
+    typedef std::chrono::high_resolution_clock clock;
+    if (cold)
+        std::remove((path + MODEL_CACHE_EXTENSION).c_str());
+
+    model_startup_result result;
+    auto start = clock::now();
+    ModelCache cache;
+    if (!cache.Load(path))
+        return result;
+    auto loaded = clock::now();
+    Model model(cache.Data(), false, storage);
+    auto modelled = clock::now();
+    std::vector<Animation> clips = LoadAnimations(cache.Data());
+    auto stop = clock::now();
+
+    result.cache = cache.Times();
+    result.model_ms = std::chrono::duration<double, std::milli>(modelled - loaded).count();
+    result.texture_decode_ms = model.textureStats.decodeMs;
+    result.texture_upload_ms = model.textureStats.uploadMs;
+    result.animation_ms = std::chrono::duration<double, std::milli>(stop - modelled).count();
+    result.total_ms = std::chrono::duration<double, std::milli>(stop - start).count();
+    result.clip_count = clips.size();
+    if (cold == cache.Warm())
+        std::cout << "ERROR: EXPECTED A " << (cold ? "COLD" : "WARM") << " MODEL CACHE LOAD" << std::endl;
+    return result;
+}
+
+void print_model_startup_result(const char* name, const model_startup_result& r) {
+    std::cout << name << ": " << r.total_ms << " ms = hash " << r.cache.hashMs << " + assimp " << r.cache.importMs
+        << " + bake " << r.cache.writeMs << " + map " << r.cache.mapMs << " + model " << r.model_ms
+        << " (textures: decode " << r.texture_decode_ms << ", upload " << r.texture_upload_ms << ") + "
+        << r.clip_count << " clip(s) " << r.animation_ms << std::endl;
+}
+
+/**
+ * @brief startup time of the model and its animation without the cache, with a cold cache
+ * (import + bake) and with a warm one, the best of runs each. Needs a current GL context.
+ *
+ * @param path model file
+ * @param runs
+ * @param storage mesh layout, as main uses it
+ */
+void run_model_cache_benchmark(const std::string& path, unsigned int runs = 5, MeshStorage storage = MeshStorage()) {
+    model_startup_result best[3];
+    for (unsigned int run = 0; run < runs; run++) {
+        model_startup_result results[3] = {
+            run_uncached_model_startup(path, storage),
+            run_cached_model_startup(path, storage, true),
+            run_cached_model_startup(path, storage, false)
+        };
+        for (int i = 0; i < 3; i++)
+            if (run == 0 || results[i].total_ms < best[i].total_ms)
+                best[i] = results[i];
+    }
+
+    std::cout << "model startup, best of " << runs << ", " << path << std::endl;
+    print_model_startup_result("uncached (1 assimp parse)", best[0]);
+    print_model_startup_result("cold cache", best[1]);
+    print_model_startup_result("warm cache", best[2]);
+    if (best[2].total_ms > 0)
+        std::cout << "warm cache is " << best[0].total_ms / best[2].total_ms << "x faster than uncached" << std::endl;
+}
+
+#endif
@@ -0,0 +1,535 @@
+#ifndef PIPELINE_BENCHMARKS_HPP
+#define PIPELINE_BENCHMARKS_HPP
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <ctime>
+#include <algorithm>
+#include <functional>
+
+#include "skeleton_utils.h"
+#include "skeleton_loader_helper.hpp"
+#include "animation_benchmarks.hpp"
+#include "benchmark_common.hpp"
+
+/*
+ * Suite over the hot paths of the pose pipeline with fixed inputs, run by
+ * tools/pipeline_bench. Skeleton sized cases run on synthetic skeletons from the blaze
+ * model's 13 bones up to thousands, results are written as JSON (Google Benchmark's
+ * field names) so two commits can be compared with --compare.
+ */
+
+// skeleton sizes the sized cases run at
+const std::vector<unsigned int> PIPELINE_BENCHMARK_BONES = {13, 64, 256, 1024, 4096};
+
+struct pipeline_benchmark_options {
+    // a case's repetitions together run at least this long
+    double min_seconds = 0.5;
+    unsigned int repetitions = 5;
+    // cases whose name does not contain this are skipped
+    std::string filter;
+    unsigned int max_bones = 4096;
+};
+
+struct pipeline_benchmark_result {
+    // case name, "/bones" appended for sized cases
+    std::string name;
+    // skeleton size, 0 for cases without one
+    unsigned int bones = 0;
+    // per repetition
+    uint64_t iterations = 0;
+    // median over the repetitions
+    double ns_per_iteration = 0;
+    double min_ns_per_iteration = 0;
+    // bones, matrices or positions processed per second at the median
+    double items_per_second = 0;
+};
+
+/**
+ * @brief times run(iterations) the way Google Benchmark does: the iteration count grows
+ * until one repetition takes min_seconds / repetitions, then every repetition is timed
+ * and the median and minimum are kept
+ *
+ * @param name
+ * @param bones
+ * @param items_per_iteration
+ * @param options
+ * @param run runs the case the given number of times
+ * @return pipeline_benchmark_result
+ */
+template <typename Fn>
+pipeline_benchmark_result measure_pipeline_benchmark(
+    const std::string& name,
+    unsigned int bones,
+    double items_per_iteration,
+    const pipeline_benchmark_options& options,
+    Fn run)
+{
+    auto time_ns = [&](uint64_t iterations) {
+        auto start = std::chrono::steady_clock::now();
+        run(iterations);
+        auto stop = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::nano>(stop - start).count();
+    };
+
+    unsigned int repetitions = std::max(1u, options.repetitions);
+    double target_ns = options.min_seconds * 1e9 / repetitions;
+    uint64_t iterations = 1;
+    double elapsed = time_ns(iterations);
+    while (elapsed < target_ns) {
+        // aim a little past the target, at most 10x per step while timings are noisy
+        double scale = elapsed > 0 ? target_ns * 1.4 / elapsed : 10.0;
+        iterations = std::max<uint64_t>(iterations + 1, (uint64_t) (iterations * std::min(10.0, scale)));
+        elapsed = time_ns(iterations);
+    }
+
+    std::vector<double> per_iteration(repetitions);
+    for (unsigned int r = 0; r < repetitions; r++)
+        per_iteration[r] = time_ns(iterations) / iterations;
+    std::sort(per_iteration.begin(), per_iteration.end());
+
+    pipeline_benchmark_result result;
+    result.name = bones ? name + "/" + std::to_string(bones) : name;
+    result.bones = bones;
+    result.iterations = iterations;
+    result.ns_per_iteration = per_iteration[repetitions / 2];
+    result.min_ns_per_iteration = per_iteration[0];
+    result.items_per_second = items_per_iteration * 1e9 / result.ns_per_iteration;
+    return result;
+}
+
+/**
+ * @brief positions of a synthetic skeleton: position 0 is the root and position i hangs
+ * off position (i - 1) / branching, one bone length away in a direction set by i and phase
+ *
+ * @param bone_count
+ * @param branching
+ * @param phase moves every bone direction, two phases give a base and a posed skeleton
+ * @return bone_count + 1 positions
+ */
+std::vector<position> synthetic_skeleton_positions(unsigned int bone_count, unsigned int branching, float phase) {
+    std::vector<position> positions(bone_count + 1);
+    positions[0] = position(0, 0, 0);
+    for (unsigned int i = 1; i <= bone_count; i++) {
+        float angle = 0.7f * i + phase;
+        position direction(0.3f * std::sin(angle), 1.0f, 0.3f * std::cos(1.3f * angle));
+        positions[i] = positions[(i - 1) / branching].add(direction.normalize().scale(0.1f));
+    }
+    return positions;
+}
+
+/**
+ * @brief bodymodel with bone_count bones laid out like synthetic_skeleton_positions,
+ * bone i runs from position i / branching to position i + 1 and is named "bone_i"
+ *
+ * @param bone_count
+ * @param phase
+ * @param branching children per position, the root's children are the base bones
+ * @return bodymodel
+ */
+bodymodel build_synthetic_bodymodel(unsigned int bone_count, float phase = 0.0f, unsigned int branching = 2) {
+    std::vector<bone> bones;
+    for (unsigned int i = 0; i < bone_count; i++)
+        bones.push_back(bone(i / branching, i + 1, "bone_" + std::to_string(i)));
+    bodymodel model(bones, 0);
+    model.set_positions(synthetic_skeleton_positions(bone_count, branching, phase));
+    return model;
+}
+
+/**
+ * @brief a FRAME line in the capture format carrying one rotation per bone
+ *
+ * @param rotations
+ * @param frame
+ * @return std::string
+ */
+std::string synthetic_frame_line(const std::unordered_map<std::string, matrix>& rotations, unsigned int frame) {
+    std::vector<std::string> names;
+    for (auto& entry : rotations)
+        names.push_back(entry.first);
+    std::sort(names.begin(), names.end());
+
+    std::string line = "FRAME: " + std::to_string(frame);
+    char matrix_text[256];
+    for (const std::string& name : names) {
+        const matrix& m = rotations.at(name);
+        snprintf(matrix_text, sizeof(matrix_text), " %s: {[%f,%f,%f,],[%f,%f,%f,],[%f,%f,%f,]},", name.c_str(),
+            m.mat[0][0], m.mat[0][1], m.mat[0][2],
+            m.mat[1][0], m.mat[1][1], m.mat[1][2],
+            m.mat[2][0], m.mat[2][1], m.mat[2][2]);
+        line += matrix_text;
+    }
+    return line;
+}
+
+// 64 fixed direction pairs, never parallel so rodrigues always has an axis
+void fixed_direction_pairs(std::vector<position>& base_dirs, std::vector<position>& new_dirs) {
+    base_dirs.clear();
+    new_dirs.clear();
+    for (unsigned int i = 0; i < 64; i++) {
+        float angle = 0.1f * i;
+        base_dirs.push_back(position(std::cos(angle), std::sin(angle), 0.25f));
+        new_dirs.push_back(position(0.5f, std::cos(angle), std::sin(angle)));
+    }
+}
+
+pipeline_benchmark_result benchmark_rodrigues(const pipeline_benchmark_options& options) {
+    std::vector<position> base_dirs, new_dirs;
+    fixed_direction_pairs(base_dirs, new_dirs);
+    return measure_pipeline_benchmark("rodrigues", 0, 1, options, [&](uint64_t iterations) {
+        float sum = 0;
+        for (uint64_t i = 0; i < iterations; i++)
+            sum += rodrigues(base_dirs[i & 63], new_dirs[i & 63]).mat[0][1];
+        benchmark_sink = sum;
+    });
+}
+
+pipeline_benchmark_result benchmark_matrix_dot_matrix(const pipeline_benchmark_options& options) {
+    std::vector<position> base_dirs, new_dirs;
+    fixed_direction_pairs(base_dirs, new_dirs);
+    std::vector<matrix> rotations;
+    for (unsigned int i = 0; i < 64; i++)
+        rotations.push_back(rodrigues(base_dirs[i], new_dirs[i]));
+    return measure_pipeline_benchmark("matrix_dot_matrix", 0, 1, options, [&](uint64_t iterations) {
+        matrix accumulated = identity();
+        for (uint64_t i = 0; i < iterations; i++)
+            accumulated = rotations[i & 63].dot(accumulated);
+        benchmark_sink = accumulated.mat[1][2];
+    });
+}
+
+pipeline_benchmark_result benchmark_matrix_dot_position(const pipeline_benchmark_options& options) {
+    std::vector<position> base_dirs, new_dirs;
+    fixed_direction_pairs(base_dirs, new_dirs);
+    std::vector<matrix> rotations;
+    for (unsigned int i = 0; i < 64; i++)
+        rotations.push_back(rodrigues(base_dirs[i], new_dirs[i]));
+    return measure_pipeline_benchmark("matrix_dot_position", 0, 1, options, [&](uint64_t iterations) {
+        float sum = 0;
+        for (uint64_t i = 0; i < iterations; i++) {
+            position rotated = rotations[i & 63].dot(base_dirs[(i + 1) & 63]);
+            sum += rotated.x + rotated.y + rotated.z;
+        }
+        benchmark_sink = sum;
+    });
+}
+
+pipeline_benchmark_result benchmark_construct_rotations(unsigned int bones, const pipeline_benchmark_options& options) {
+    bodymodel base = build_synthetic_bodymodel(bones);
+    bodymodel posed = build_synthetic_bodymodel(bones, 0.5f);
+    return measure_pipeline_benchmark("construct_rotations", bones, bones, options, [&](uint64_t iterations) {
+        float sum = 0;
+        for (uint64_t i = 0; i < iterations; i++)
+            sum += posed.construct_rotations(base)["bone_0"].mat[0][0];
+        benchmark_sink = sum;
+    });
+}
+
+pipeline_benchmark_result benchmark_rotate_self_by_rotations(unsigned int bones, const pipeline_benchmark_options& options) {
+    bodymodel base = build_synthetic_bodymodel(bones);
+    std::unordered_map<std::string, matrix> rotations = build_synthetic_bodymodel(bones, 0.5f).construct_rotations(base);
+    return measure_pipeline_benchmark("rotate_self_by_rotations", bones, bones, options, [&](uint64_t iterations) {
+        float sum = 0;
+        for (uint64_t i = 0; i < iterations; i++)
+            sum += base.rotate_self_by_rotations(rotations, base).positions[bones].x;
+        benchmark_sink = sum;
+    });
+}
+
+pipeline_benchmark_result benchmark_rotate_self_by_single_bones(unsigned int bones, const pipeline_benchmark_options& options) {
+    bodymodel base = build_synthetic_bodymodel(bones);
+    std::unordered_map<std::string, matrix> rotations = build_synthetic_bodymodel(bones, 0.5f).construct_rotations(base);
+    return measure_pipeline_benchmark("rotate_self_by_single_bones", bones, bones, options, [&](uint64_t iterations) {
+        float sum = 0;
+        for (uint64_t i = 0; i < iterations; i++)
+            sum += base.rotate_self_by_single_bones(rotations, base).positions[bones].x;
+        benchmark_sink = sum;
+    });
+}
+
+// the solve alone, rotations already in tree order
+pipeline_benchmark_result benchmark_fk_solve(unsigned int bones, const pipeline_benchmark_options& options) {
+    bodymodel base = build_synthetic_bodymodel(bones);
+    std::unordered_map<std::string, matrix> rotations = build_synthetic_bodymodel(bones, 0.5f).construct_rotations(base);
+    std::vector<matrix> joint_rotations;
+    for (int bone_index : base.skel->fk.joint_bone)
+        joint_rotations.push_back(rotations[base.skel->bones[bone_index].name]);
+    std::vector<position> solved;
+    return measure_pipeline_benchmark("fk_solve", bones, bones, options, [&](uint64_t iterations) {
+        float sum = 0;
+        for (uint64_t i = 0; i < iterations; i++) {
+            base.skel->fk.solve(base.positions, joint_rotations.data(), solved);
+            sum += solved[bones].x;
+        }
+        benchmark_sink = sum;
+    });
+}
+
+// rotate_self_by_rotations on pose buffers: rotations out of two poses of one skeleton and
+// the solve, both into buffers kept between frames
+pipeline_benchmark_result benchmark_pose_rotate(unsigned int bones, const pipeline_benchmark_options& options) {
+    bodymodel base = build_synthetic_bodymodel(bones);
+    bodymodel posed = build_synthetic_bodymodel(bones, 0.5f);
+    const skeleton& shape = *base.skel;
+    std::vector<matrix> joint_rotations;
+    pose solved;
+    return measure_pipeline_benchmark("pose_rotate", bones, bones, options, [&](uint64_t iterations) {
+        float sum = 0;
+        for (uint64_t i = 0; i < iterations; i++) {
+            shape.rotations_into(base.positions, posed.positions, joint_rotations);
+            shape.solve(base.positions, joint_rotations, solved);
+            sum += solved[bones].x;
+        }
+        benchmark_sink = sum;
+    });
+}
+
+// per bone lookups through the topology: the bones leaving its parent, its children and
+// everything downstream of it
+pipeline_benchmark_result benchmark_topology_walk(unsigned int bones, const pipeline_benchmark_options& options) {
+    bodymodel model = build_synthetic_bodymodel(bones);
+    return measure_pipeline_benchmark("topology_walk", bones, bones, options, [&](uint64_t iterations) {
+        size_t sum = 0;
+        for (uint64_t i = 0; i < iterations; i++) {
+            for (const bone& j : model.skel->bones) {
+                sum += model.get_first_parent_bone_instance(j.parent_index).child_index;
+                sum += model.children(j).size() + model.flow(j).size();
+            }
+        }
+        benchmark_sink = sum;
+    });
+}
+
+pipeline_benchmark_result benchmark_matrices_from_line(unsigned int bones, const pipeline_benchmark_options& options) {
+    bodymodel base = build_synthetic_bodymodel(bones);
+    std::string line = synthetic_frame_line(build_synthetic_bodymodel(bones, 0.5f).construct_rotations(base), 0);
+    return measure_pipeline_benchmark("matrices_from_line", bones, bones, options, [&](uint64_t iterations) {
+        size_t sum = 0;
+        for (uint64_t i = 0; i < iterations; i++)
+            sum += matrices_from_line(line).size();
+        benchmark_sink = sum;
+    });
+}
+
+pipeline_benchmark_result benchmark_vectorify_flatten(unsigned int bones, const pipeline_benchmark_options& options) {
+    bodymodel model = build_synthetic_bodymodel(bones);
+    return measure_pipeline_benchmark("vectorify_flatten", bones, bones, options, [&](uint64_t iterations) {
+        float sum = 0;
+        for (uint64_t i = 0; i < iterations; i++)
+            sum += flatten(model.vectorify_positions_in_order()).back();
+        benchmark_sink = sum;
+    });
+}
+
+pipeline_benchmark_result benchmark_animator_update_case(unsigned int bones, const pipeline_benchmark_options& options) {
+    Animation animation = build_synthetic_animation(bones);
+    Animator animator(&animation);
+    return measure_pipeline_benchmark("animator_update", bones, bones, options, [&](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; i++)
+            animator.UpdateAnimation(1.0f / 60.0f);
+        benchmark_sink = animator.GetFinalBoneMatrices()[0][3][1];
+    });
+}
+
+/**
+ * @brief apply_rotations_to_vamp_model over the frames of a vampire capture, the fixed
+ * input is the tracked ymca capture. The model's size is fixed by the blaze -> vampire map.
+ *
+ * @param options
+ * @param capture path of a vampire capture
+ * @param result filled on success
+ * @return false when the capture can not be read
+ */
+bool benchmark_apply_rotations_to_vamp_model(
+    const pipeline_benchmark_options& options,
+    const std::string& capture,
+    pipeline_benchmark_result& result)
+{
+    auto [vampire, frames] = load_vamp_model_from_path(capture, false);
+    if (frames.empty() || vampire.positions.empty())
+        return false;
+    bodymodel blaze = create_adjusted_blaze_model();
+    unsigned int bones = vampire.skel->bones.size();
+    result = measure_pipeline_benchmark("apply_rotations_to_vamp_model", bones, bones, options, [&](uint64_t iterations) {
+        float sum = 0;
+        for (uint64_t i = 0; i < iterations; i++) {
+            auto [posed, translations] = apply_rotations_to_vamp_model(frames[i % frames.size()], vampire, blaze);
+            sum += posed.positions[0].y + translations.size();
+        }
+        benchmark_sink = sum;
+    });
+    return true;
+}
+
+/**
+ * @brief runs every case passing the filter, printing one line per case as it finishes
+ *
+ * @param options
+ * @param capture vampire capture for apply_rotations_to_vamp_model
+ * @return std::vector<pipeline_benchmark_result>
+ */
+std::vector<pipeline_benchmark_result> run_pipeline_benchmarks(
+    const pipeline_benchmark_options& options,
+    const std::string& capture = JOINT_FILEPATH + "ymca_blaze_vamp.txt")
+{
+    std::vector<pipeline_benchmark_result> results;
+    auto selected = [&](const std::string& name) {
+        return options.filter.empty() || name.find(options.filter) != std::string::npos;
+    };
+    auto report = [&](const pipeline_benchmark_result& result) {
+        char line[192];
+        snprintf(line, sizeof(line), "%-36s %12.1f ns  %12llu its  %14.0f items/s",
+            result.name.c_str(), result.ns_per_iteration, (unsigned long long) result.iterations, result.items_per_second);
+        std::cout << line << std::endl;
+        results.push_back(result);
+    };
+
+    if (selected("rodrigues"))
+        report(benchmark_rodrigues(options));
+    if (selected("matrix_dot_matrix"))
+        report(benchmark_matrix_dot_matrix(options));
+    if (selected("matrix_dot_position"))
+        report(benchmark_matrix_dot_position(options));
+
+    pipeline_benchmark_result vampire_result;
+    if (selected("apply_rotations_to_vamp_model")) {
+        if (benchmark_apply_rotations_to_vamp_model(options, capture, vampire_result))
+            report(vampire_result);
+        else
+            std::cout << "ERROR: NO FRAMES IN " << capture << ", apply_rotations_to_vamp_model skipped" << std::endl;
+    }
+
+    typedef pipeline_benchmark_result (*sized_case)(unsigned int, const pipeline_benchmark_options&);
+    const std::vector<std::pair<std::string, sized_case>> sized_cases = {
+        {"construct_rotations", benchmark_construct_rotations},
+        {"rotate_self_by_rotations", benchmark_rotate_self_by_rotations},
+        {"rotate_self_by_single_bones", benchmark_rotate_self_by_single_bones},
+        {"fk_solve", benchmark_fk_solve},
+        {"pose_rotate", benchmark_pose_rotate},
+        {"topology_walk", benchmark_topology_walk},
+        {"matrices_from_line", benchmark_matrices_from_line},
+        {"vectorify_flatten", benchmark_vectorify_flatten},
+        {"animator_update", benchmark_animator_update_case},
+    };
+    for (auto& sized : sized_cases) {
+        for (unsigned int bones : PIPELINE_BENCHMARK_BONES) {
+            if (bones <= options.max_bones && selected(sized.first + "/" + std::to_string(bones)))
+                report(sized.second(bones, options));
+        }
+    }
+    return results;
+}
+
+/**
+ * @brief writes results as JSON, a context object and one benchmark object per line.
+ * real_time / cpu_time are the median wall time so Google Benchmark's compare.py reads it.
+ *
+ * @param results
+ * @param options
+ * @param path
+ * @return true on success
+ */
+bool write_pipeline_benchmark_json(
+    const std::vector<pipeline_benchmark_result>& results,
+    const pipeline_benchmark_options& options,
+    const std::string& path)
+{
+    std::ofstream out(path, std::ios::binary);
+    if (!out.is_open()) {
+        std::cout << "ERROR: FAILED TO OPEN FILE " << path << std::endl;
+        return false;
+    }
+
+    char date[32];
+    std::time_t now = std::time(nullptr);
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+#ifdef NDEBUG
+    const char* build_type = "release";
+#else
+    const char* build_type = "debug";
+#endif
+    out << "{\n\"context\": {\"date\": \"" << date << "\", \"library_build_type\": \"" << build_type
+        << "\", \"min_time\": " << options.min_seconds << ", \"repetitions\": " << options.repetitions
+        << ", \"stage_profiling\": " << STAGE_PROFILING << "},\n\"benchmarks\": [\n";
+
+    char entry[384];
+    for (size_t i = 0; i < results.size(); i++) {
+        const pipeline_benchmark_result& r = results[i];
+        snprintf(entry, sizeof(entry),
+            "{\"name\": \"%s\", \"run_type\": \"iteration\", \"bones\": %u, \"iterations\": %llu, "
+            "\"real_time\": %.3f, \"cpu_time\": %.3f, \"min_real_time\": %.3f, \"time_unit\": \"ns\", \"items_per_second\": %.1f}%s\n",
+            r.name.c_str(), r.bones, (unsigned long long) r.iterations, r.ns_per_iteration, r.ns_per_iteration,
+            r.min_ns_per_iteration, r.items_per_second, i + 1 < results.size() ? "," : "");
+        out << entry;
+    }
+    out << "]\n}\n";
+    return out.good();
+}
+
+/**
+ * @brief reads name -> real_time back from a file written by write_pipeline_benchmark_json
+ *
+ * @param path
+ * @param times filled with one entry per benchmark
+ * @return false when the file can not be read
+ */
+bool read_pipeline_benchmark_json(const std::string& path, std::vector<std::pair<std::string, double>>& times) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) {
+        std::cout << "ERROR: FAILED TO OPEN FILE " << path << std::endl;
+        return false;
+    }
+    const std::string name_key = "\"name\": \"";
+    const std::string time_key = "\"real_time\": ";
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t name_at = line.find(name_key);
+        size_t time_at = line.find(time_key);
+        if (name_at == std::string::npos || time_at == std::string::npos)
+            continue;
+        name_at += name_key.size();
+        size_t name_end = line.find('"', name_at);
+        times.push_back({line.substr(name_at, name_end - name_at), std::strtod(line.c_str() + time_at + time_key.size(), NULL)});
+    }
+    return true;
+}
+
+/**
+ * @brief prints every case next to its baseline time and flags the ones slower by more
+ * than threshold
+ *
+ * @param results
+ * @param baseline
+ * @param threshold allowed slowdown, 0.1 = 10%
+ * @return number of regressions
+ */
+unsigned int compare_pipeline_benchmarks(
+    const std::vector<pipeline_benchmark_result>& results,
+    const std::vector<std::pair<std::string, double>>& baseline,
+    double threshold)
+{
+    unsigned int regressions = 0;
+    char line[192];
+    for (const pipeline_benchmark_result& r : results) {
+        auto found = std::find_if(baseline.begin(), baseline.end(),
+            [&](const std::pair<std::string, double>& b) { return b.first == r.name; });
+        if (found == baseline.end() || found->second <= 0)
+            continue;
+        double change = r.ns_per_iteration / found->second - 1.0;
+        bool regressed = change > threshold;
+        regressions += regressed;
+        snprintf(line, sizeof(line), "%-36s %12.1f -> %12.1f ns  %+7.1f%%%s",
+            r.name.c_str(), found->second, r.ns_per_iteration, change * 100.0, regressed ? "  REGRESSION" : "");
+        std::cout << line << std::endl;
+    }
+    return regressions;
+}
+
+#endif
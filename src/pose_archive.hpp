@@ -0,0 +1,540 @@
+#ifndef POSE_ARCHIVE_HPP
+#define POSE_ARCHIVE_HPP
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+
+#include "mapped_file.hpp"
+#include "pose_stream.hpp"
+#include "pose_playback.hpp"
+
+/*
+ * Compressed pose archive (.parc), the long capture counterpart of a .pstream. All values
+ * little endian:
+ *
+ *  pose_archive_header
+ *  name table      bone_count * POSE_STREAM_NAME_SIZE bytes, null padded
+ *  base positions  position_count * 3 floats
+ *  block table     block_count + 1 uint32 file offsets, the last one is the end of the data
+ *  blocks          block_frames frames each (the last one may be shorter)
+ *
+ * A block stands alone, so any frame decodes from its block only:
+ *
+ *  key counts      bone_count uint16
+ *  key frames      per slot, its key count uint8 frame indices inside the block
+ *  keys            per slot, its key count quaternions of POSE_ARCHIVE_KEY_BYTES
+ *
+ * Every slot keys the first and last frame of a block. The frames in between are the
+ * nlerp of the surrounding keys, keys are only added where that lands further than the
+ * archive's tolerance from the captured rotation. Keys are smallest three quaternions:
+ * the largest component is dropped (the sign makes it positive) and the other three are
+ * 15 bit fixed point in [-1/sqrt(2), 1/sqrt(2)], the dropped index in the two top bits.
+ */
+
+const char POSE_ARCHIVE_MAGIC[4] = {'P', 'A', 'R', 'C'};
+const uint32_t POSE_ARCHIVE_VERSION = 1;
+const std::string POSE_ARCHIVE_EXTENSION = ".parc";
+const uint32_t POSE_ARCHIVE_KEY_BYTES = 6;
+// range of the three smallest components of a unit quaternion, spelled out since M_SQRT2 and
+// M_SQRT1_2 are POSIX extensions
+constexpr float POSE_ARCHIVE_SQRT2 = 1.41421356237309504880f;
+constexpr float POSE_ARCHIVE_SQRT1_2 = 0.70710678118654752440f;
+// frames per block, key frame indices are stored in a byte
+const uint32_t POSE_ARCHIVE_BLOCK_FRAMES = 64;
+// furthest a decoded rotation may be from the captured one
+const float POSE_ARCHIVE_DEFAULT_TOLERANCE_DEGREES = 0.5f;
+
+struct pose_archive_header {
+    char magic[4];
+    uint32_t version;
+    uint32_t bone_count;
+    uint32_t frame_count;
+    uint32_t position_count;
+    uint32_t block_frames;
+    uint32_t block_count;
+    float tolerance_degrees;
+    uint32_t names_offset;
+    uint32_t positions_offset;
+    uint32_t blocks_offset;
+    uint32_t key_count;
+};
+
+struct pose_archive_stats {
+    uint32_t frames = 0;
+    uint32_t slots = 0;
+    // keys kept out of frames * slots
+    uint32_t keys = 0;
+    size_t bytes = 0;
+    // measured on every frame against the stream, quantization included
+    double max_error_degrees = 0;
+    double encode_ms = 0;
+};
+
+void pose_archive_pack_key(const float* q, unsigned char* out) {
+    int largest = 0;
+    for (int c = 1; c < 4; c++)
+        if (std::fabs(q[c]) > std::fabs(q[largest]))
+            largest = c;
+    float sign = q[largest] < 0 ? -1.0f : 1.0f;
+
+    uint16_t words[3];
+    for (int c = 0, w = 0; c < 4; c++) {
+        if (c == largest)
+            continue;
+        float unit = (q[c] * sign * POSE_ARCHIVE_SQRT2 + 1.0f) * 0.5f;
+        words[w++] = (uint16_t) std::lround(std::min(1.0f, std::max(0.0f, unit)) * 32767.0f);
+    }
+    words[0] |= (uint16_t) ((largest >> 1) << 15);
+    words[1] |= (uint16_t) ((largest & 1) << 15);
+    std::memcpy(out, words, POSE_ARCHIVE_KEY_BYTES);
+}
+
+void pose_archive_unpack_key(const unsigned char* in, float* q) {
+    uint16_t words[3];
+    std::memcpy(words, in, POSE_ARCHIVE_KEY_BYTES);
+    int largest = ((words[0] >> 15) << 1) | (words[1] >> 15);
+
+    float sum = 0;
+    for (int c = 0, w = 0; c < 4; c++) {
+        if (c == largest)
+            continue;
+        float value = ((words[w++] & 0x7fff) / 32767.0f * 2.0f - 1.0f) * POSE_ARCHIVE_SQRT1_2;
+        q[c] = value;
+        sum += value * value;
+    }
+    q[largest] = std::sqrt(std::max(0.0f, 1.0f - sum));
+}
+
+// what the decoder shows between two keys, the encoder measures its error with the same
+void pose_archive_blend(const float* a, const float* b, float t, float* q) {
+    float dot = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+    float t1 = dot < 0 ? -t : t;
+    float t0 = 1.0f - t;
+    float length = 0;
+    for (int c = 0; c < 4; c++) {
+        q[c] = a[c] * t0 + b[c] * t1;
+        length += q[c] * q[c];
+    }
+    float inverse_length = 1.0f / std::sqrt(length);
+    for (int c = 0; c < 4; c++)
+        q[c] *= inverse_length;
+}
+
+/**
+ * @brief picks the keys of one slot of one block: first and last frame, then the frame
+ * furthest from its reconstruction between each pair of keys until all are in tolerance
+ *
+ * @param captured the slot's quaternion per frame of the block
+ * @param quantized the same after a pack / unpack round trip
+ * @param tolerance_degrees
+ * @param keys sorted frame indices inside the block, out
+ * @return double largest error left, in degrees
+ */
+double reduce_pose_archive_keys(
+    const std::vector<float>& captured,
+    const std::vector<float>& quantized,
+    double tolerance_degrees,
+    std::vector<uint32_t>& keys)
+{
+    uint32_t frames = captured.size() / 4;
+    keys.clear();
+    keys.push_back(0);
+    if (frames > 1)
+        keys.push_back(frames - 1);
+
+    double max_error = 0;
+    for (uint32_t k : keys)
+        max_error = std::max(max_error, quaternion_angle_degrees(&captured[k * 4], &quantized[k * 4]));
+
+    // intervals still to check, split on their worst frame
+    std::vector<std::pair<uint32_t, uint32_t>> pending;
+    if (frames > 2)
+        pending.push_back({0, frames - 1});
+    while (!pending.empty()) {
+        auto [first, last] = pending.back();
+        pending.pop_back();
+        uint32_t worst = first;
+        double worst_error = -1;
+        for (uint32_t f = first + 1; f < last; f++) {
+            float q[4];
+            pose_archive_blend(&quantized[first * 4], &quantized[last * 4], (float) (f - first) / (last - first), q);
+            double error = quaternion_angle_degrees(&captured[f * 4], q);
+            if (error > worst_error) {
+                worst_error = error;
+                worst = f;
+            }
+        }
+        if (worst_error <= tolerance_degrees) {
+            max_error = std::max(max_error, worst_error);
+            continue;
+        }
+        keys.push_back(worst);
+        max_error = std::max(max_error, quaternion_angle_degrees(&captured[worst * 4], &quantized[worst * 4]));
+        if (worst - first > 1)
+            pending.push_back({first, worst});
+        if (last - worst > 1)
+            pending.push_back({worst, last});
+    }
+    std::sort(keys.begin(), keys.end());
+    return max_error;
+}
+
+/**
+ * @brief compresses a pose stream into a .parc file
+ *
+ * @param path output path
+ * @param stream
+ * @param tolerance_degrees largest angle a decoded rotation may be off by
+ * @param block_frames frames per independently decodable block, at most 256
+ * @param stats filled in when not null
+ * @return true on success
+ */
+bool write_pose_archive(
+    const std::string& path,
+    const pose_stream& stream,
+    float tolerance_degrees = POSE_ARCHIVE_DEFAULT_TOLERANCE_DEGREES,
+    uint32_t block_frames = POSE_ARCHIVE_BLOCK_FRAMES,
+    pose_archive_stats* stats = nullptr)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    block_frames = std::max(2u, std::min(256u, block_frames));
+    std::vector<position> base_positions = stream.base_positions();
+
+    pose_archive_header header = {};
+    std::memcpy(header.magic, POSE_ARCHIVE_MAGIC, 4);
+    header.version = POSE_ARCHIVE_VERSION;
+    header.bone_count = stream.bone_count();
+    header.frame_count = stream.frame_count();
+    header.position_count = base_positions.size();
+    header.block_frames = block_frames;
+    header.block_count = (header.frame_count + block_frames - 1) / block_frames;
+    header.tolerance_degrees = tolerance_degrees;
+    header.names_offset = pose_stream_align(sizeof(pose_archive_header));
+    header.positions_offset = pose_stream_align(header.names_offset + header.bone_count * POSE_STREAM_NAME_SIZE);
+    header.blocks_offset = pose_stream_align(header.positions_offset + header.position_count * 3 * sizeof(float));
+    uint32_t data_offset = pose_stream_align(header.blocks_offset + (header.block_count + 1) * sizeof(uint32_t));
+
+    std::vector<unsigned char> buffer(data_offset, 0);
+    for (uint32_t i = 0; i < header.bone_count; i++) {
+        const std::string& name = stream.bone_names()[i];
+        std::memcpy(buffer.data() + header.names_offset + i * POSE_STREAM_NAME_SIZE, name.data(), name.size());
+    }
+    float* positions = reinterpret_cast<float*>(buffer.data() + header.positions_offset);
+    for (uint32_t i = 0; i < header.position_count; i++) {
+        positions[i*3] = base_positions[i].x;
+        positions[i*3 + 1] = base_positions[i].y;
+        positions[i*3 + 2] = base_positions[i].z;
+    }
+
+    double max_error = 0;
+    std::vector<uint32_t> block_offsets;
+    std::vector<float> captured, quantized;
+    std::vector<std::vector<uint32_t>> slot_keys(header.bone_count);
+    std::vector<std::vector<unsigned char>> slot_packed(header.bone_count);
+    for (uint32_t block = 0; block < header.block_count; block++) {
+        uint32_t first = block * block_frames;
+        uint32_t frames = std::min(block_frames, header.frame_count - first);
+        block_offsets.push_back(buffer.size());
+        buffer.resize(buffer.size() + header.bone_count * sizeof(uint16_t));
+
+        for (uint32_t s = 0; s < header.bone_count; s++) {
+            captured.resize(frames * 4);
+            quantized.resize(frames * 4);
+            slot_packed[s].resize(frames * POSE_ARCHIVE_KEY_BYTES);
+            for (uint32_t f = 0; f < frames; f++) {
+                quaternion_from_rotation(stream.frame_data(first + f) + s * POSE_STREAM_FLOATS_PER_ROTATION, &captured[f * 4]);
+                pose_archive_pack_key(&captured[f * 4], &slot_packed[s][f * POSE_ARCHIVE_KEY_BYTES]);
+                pose_archive_unpack_key(&slot_packed[s][f * POSE_ARCHIVE_KEY_BYTES], &quantized[f * 4]);
+            }
+            max_error = std::max(max_error, reduce_pose_archive_keys(captured, quantized, tolerance_degrees, slot_keys[s]));
+            header.key_count += slot_keys[s].size();
+            uint16_t count = slot_keys[s].size();
+            std::memcpy(buffer.data() + block_offsets.back() + s * sizeof(uint16_t), &count, sizeof(uint16_t));
+        }
+        for (uint32_t s = 0; s < header.bone_count; s++)
+            for (uint32_t k : slot_keys[s])
+                buffer.push_back((unsigned char) k);
+        for (uint32_t s = 0; s < header.bone_count; s++)
+            for (uint32_t k : slot_keys[s])
+                buffer.insert(buffer.end(), slot_packed[s].begin() + k * POSE_ARCHIVE_KEY_BYTES,
+                    slot_packed[s].begin() + (k + 1) * POSE_ARCHIVE_KEY_BYTES);
+    }
+    block_offsets.push_back(buffer.size());
+    std::memcpy(buffer.data() + header.blocks_offset, block_offsets.data(), block_offsets.size() * sizeof(uint32_t));
+    std::memcpy(buffer.data(), &header, sizeof(pose_archive_header));
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cout << "ERROR: FAILED TO OPEN FILE " << path << std::endl;
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+    if (stats) {
+        stats->frames = header.frame_count;
+        stats->slots = header.bone_count;
+        stats->keys = header.key_count;
+        stats->bytes = buffer.size();
+        stats->max_error_degrees = max_error;
+        stats->encode_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+    return file.good();
+}
+
+/**
+ * @brief memory mapped reader over a .parc file. Frames decode into the pose stream slot
+ * layout (9 floats per slot), so anything that takes pose_stream::frame_data can take them.
+ * Decoding only reads the mapping, several threads can decode different blocks at once.
+ *
+ */
+class pose_archive {
+public:
+    pose_archive() {}
+
+    bool open(const std::string& path) {
+        if (!file.open(path)) {
+            std::cout << "ERROR: FAILED TO MAP POSE ARCHIVE " << path << std::endl;
+            return false;
+        }
+        if (file.size() < sizeof(pose_archive_header)) {
+            std::cout << "ERROR: POSE ARCHIVE TOO SMALL " << path << std::endl;
+            file.close();
+            return false;
+        }
+        std::memcpy(&header, file.bytes(), sizeof(pose_archive_header));
+        if (std::memcmp(header.magic, POSE_ARCHIVE_MAGIC, 4) != 0 || header.version != POSE_ARCHIVE_VERSION ||
+            header.block_frames == 0 || header.block_frames > 256 ||
+            header.block_count != (header.frame_count + header.block_frames - 1) / header.block_frames) {
+            std::cout << "ERROR: BAD POSE ARCHIVE HEADER " << path << std::endl;
+            file.close();
+            return false;
+        }
+        size_t names_end = (size_t) header.names_offset + header.bone_count * POSE_STREAM_NAME_SIZE;
+        size_t positions_end = (size_t) header.positions_offset + header.position_count * 3 * sizeof(float);
+        size_t table_end = (size_t) header.blocks_offset + (header.block_count + 1) * sizeof(uint32_t);
+        bool valid = names_end <= file.size() && positions_end <= file.size() && table_end <= file.size();
+        for (uint32_t block = 0; valid && block < header.block_count; block++) {
+            size_t begin = block_offset(block), end = block_offset(block + 1);
+            valid = begin <= end && end <= file.size() && end - begin >= header.bone_count * sizeof(uint16_t);
+            if (valid) {
+                // every slot has at least the key the decoder starts from
+                size_t keys = 0;
+                for (uint32_t s = 0; s < header.bone_count; s++) {
+                    uint32_t count = key_count(block, s);
+                    valid = valid && count > 0;
+                    keys += count;
+                }
+                valid = valid && end - begin == header.bone_count * sizeof(uint16_t) + keys * (1 + POSE_ARCHIVE_KEY_BYTES);
+            }
+            if (valid) {
+                // key frames strictly increasing inside the block, write_slot divides by their distance
+                const unsigned char* key_frames = file.bytes() + begin + header.bone_count * sizeof(uint16_t);
+                for (uint32_t s = 0; valid && s < header.bone_count; s++) {
+                    uint32_t count = key_count(block, s);
+                    for (uint32_t k = 0; valid && k < count; k++)
+                        valid = key_frames[k] < block_length(block) && (k == 0 || key_frames[k] > key_frames[k - 1]);
+                    key_frames += count;
+                }
+            }
+        }
+        if (!valid) {
+            std::cout << "ERROR: TRUNCATED OR CORRUPT POSE ARCHIVE " << path << std::endl;
+            file.close();
+            return false;
+        }
+
+        names.clear();
+        const char* name_table = reinterpret_cast<const char*>(file.bytes() + header.names_offset);
+        for (uint32_t i = 0; i < header.bone_count; i++) {
+            const char* entry = name_table + i * POSE_STREAM_NAME_SIZE;
+            names.push_back(std::string(entry, strnlen(entry, POSE_STREAM_NAME_SIZE)));
+        }
+        return true;
+    }
+
+    uint32_t frame_count() const { return header.frame_count; }
+    uint32_t bone_count() const { return header.bone_count; }
+    uint32_t frame_stride() const { return header.bone_count * POSE_STREAM_FLOATS_PER_ROTATION; }
+    uint32_t block_frames() const { return header.block_frames; }
+    uint32_t block_count() const { return header.block_count; }
+    uint32_t key_count() const { return header.key_count; }
+    float tolerance_degrees() const { return header.tolerance_degrees; }
+    const std::vector<std::string>& bone_names() const { return names; }
+    size_t size() const { return file.size(); }
+
+    uint32_t block_first_frame(uint32_t block) const { return block * header.block_frames; }
+    uint32_t block_length(uint32_t block) const {
+        return std::min(header.block_frames, header.frame_count - block_first_frame(block));
+    }
+
+    std::vector<position> base_positions() const {
+        const float* raw = reinterpret_cast<const float*>(file.bytes() + header.positions_offset);
+        std::vector<position> result;
+        result.reserve(header.position_count);
+        for (uint32_t i = 0; i < header.position_count; i++)
+            result.push_back(position(raw[i*3], raw[i*3 + 1], raw[i*3 + 2]));
+        return result;
+    }
+
+    /**
+     * @brief decodes every frame of a block, walking each slot's keys once
+     *
+     * @param block
+     * @param out block_length(block) * frame_stride() floats, frame after frame
+     */
+    void decode_block(uint32_t block, float* out) const {
+        uint32_t frames = block_length(block);
+        block_cursor cursor = cursor_at(block);
+        for (uint32_t s = 0; s < header.bone_count; s++) {
+            uint32_t count = key_count(block, s);
+            uint32_t k = 0;
+            float a[4], b[4], q[4];
+            pose_archive_unpack_key(cursor.keys, a);
+            if (count > 1)
+                pose_archive_unpack_key(cursor.keys + POSE_ARCHIVE_KEY_BYTES, b);
+            for (uint32_t f = 0; f < frames; f++) {
+                while (k + 2 < count && cursor.frames[k + 1] <= f) {
+                    k++;
+                    std::memcpy(a, b, sizeof(a));
+                    pose_archive_unpack_key(cursor.keys + (k + 1) * POSE_ARCHIVE_KEY_BYTES, b);
+                }
+                write_slot(cursor.frames, k, count, a, b, f, q);
+                rotation_from_quaternion(q, out + (size_t) f * frame_stride() + s * POSE_STREAM_FLOATS_PER_ROTATION);
+            }
+            cursor.frames += count;
+            cursor.keys += count * POSE_ARCHIVE_KEY_BYTES;
+        }
+    }
+
+    /**
+     * @brief decodes a single frame, random access costs one block's key lookup per slot
+     *
+     * @param index
+     * @param out frame_stride() floats
+     */
+    void decode_frame(uint32_t index, float* out) const {
+        uint32_t block = index / header.block_frames;
+        uint32_t f = index - block_first_frame(block);
+        block_cursor cursor = cursor_at(block);
+        for (uint32_t s = 0; s < header.bone_count; s++) {
+            uint32_t count = key_count(block, s);
+            uint32_t k = 0;
+            while (k + 2 < count && cursor.frames[k + 1] <= f)
+                k++;
+            float a[4], b[4], q[4];
+            pose_archive_unpack_key(cursor.keys + k * POSE_ARCHIVE_KEY_BYTES, a);
+            if (count > 1)
+                pose_archive_unpack_key(cursor.keys + (k + 1) * POSE_ARCHIVE_KEY_BYTES, b);
+            write_slot(cursor.frames, k, count, a, b, f, q);
+            rotation_from_quaternion(q, out + s * POSE_STREAM_FLOATS_PER_ROTATION);
+            cursor.frames += count;
+            cursor.keys += count * POSE_ARCHIVE_KEY_BYTES;
+        }
+    }
+
+private:
+    struct block_cursor {
+        const unsigned char* frames;
+        const unsigned char* keys;
+    };
+
+    mapped_file file;
+    pose_archive_header header = {};
+    std::vector<std::string> names;
+
+    uint32_t block_offset(uint32_t block) const {
+        uint32_t offset;
+        std::memcpy(&offset, file.bytes() + header.blocks_offset + block * sizeof(uint32_t), sizeof(uint32_t));
+        return offset;
+    }
+
+    uint32_t key_count(uint32_t block, uint32_t slot) const {
+        uint16_t count;
+        std::memcpy(&count, file.bytes() + block_offset(block) + slot * sizeof(uint16_t), sizeof(uint16_t));
+        return count;
+    }
+
+    block_cursor cursor_at(uint32_t block) const {
+        const unsigned char* start = file.bytes() + block_offset(block);
+        uint32_t keys = 0;
+        for (uint32_t s = 0; s < header.bone_count; s++)
+            keys += key_count(block, s);
+        block_cursor cursor;
+        cursor.frames = start + header.bone_count * sizeof(uint16_t);
+        cursor.keys = cursor.frames + keys;
+        return cursor;
+    }
+
+    // the rotation of block frame f from the keys k and k + 1 around it
+    static void write_slot(const unsigned char* key_frames, uint32_t k, uint32_t count,
+        const float* a, const float* b, uint32_t f, float* q)
+    {
+        if (count < 2 || f <= key_frames[k]) {
+            std::memcpy(q, a, 4 * sizeof(float));
+            return;
+        }
+        uint32_t first = key_frames[k], last = key_frames[k + 1];
+        pose_archive_blend(a, b, (float) (f - first) / (last - first), q);
+    }
+};
+
+/**
+ * @brief compresses a pose stream file into a .parc file
+ *
+ * @param stream_path .pstream
+ * @param archive_path output path
+ * @param tolerance_degrees
+ * @param stats filled in when not null
+ * @return true on success
+ */
+bool convert_pose_stream_to_archive(
+    const std::string& stream_path,
+    const std::string& archive_path,
+    float tolerance_degrees = POSE_ARCHIVE_DEFAULT_TOLERANCE_DEGREES,
+    pose_archive_stats* stats = nullptr)
+{
+    pose_stream stream;
+    if (!stream.open(stream_path))
+        return false;
+    return write_pose_archive(archive_path, stream, tolerance_degrees, POSE_ARCHIVE_BLOCK_FRAMES, stats);
+}
+
+/**
+ * @brief archive counterpart of load_vamp_model_from_stream
+ *
+ * @param filename .parc file name inside JOINT_FILEPATH
+ * @param archive reader that keeps the mapping alive
+ * @return bodymodel
+ */
+bodymodel load_vamp_model_from_archive(const std::string& filename, pose_archive& archive) {
+    bodymodel model = create_local_dancing_vampire_model();
+    if (!archive.open(JOINT_FILEPATH + filename))
+        return model;
+    model.set_positions(archive.base_positions());
+    return model;
+}
+
+/**
+ * @brief returns the .parc name for a text capture, converting it (through its .pstream)
+ * on first use and again whenever the capture is re-recorded
+ *
+ * @param text_filename file name inside JOINT_FILEPATH
+ * @return std::string
+ */
+std::string ensure_pose_archive(const std::string& text_filename) {
+    std::string archive_filename = text_filename.substr(0, text_filename.find_last_of('.')) + POSE_ARCHIVE_EXTENSION;
+    if (!pose_file_is_stale(JOINT_FILEPATH + text_filename, JOINT_FILEPATH + archive_filename))
+        return archive_filename;
+    std::string stream_filename = ensure_pose_stream(text_filename);
+    if (!convert_pose_stream_to_archive(JOINT_FILEPATH + stream_filename, JOINT_FILEPATH + archive_filename))
+        std::cout << "ERROR: FAILED TO CONVERT " << text_filename << " TO POSE ARCHIVE" << std::endl;
+    return archive_filename;
+}
+
+#endif
@@ -0,0 +1,627 @@
+#ifndef POSE_BENCHMARKS_HPP
+#define POSE_BENCHMARKS_HPP
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cmath>
+#include <regex>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <filesystem>
+
+#include "skeleton_utils.h"
+#include "skeleton_loader_helper.hpp"
+#include "keypoint_parser.hpp"
+#include "pose_follower.hpp"
+#include "pose_stream.hpp"
+#include "retarget_plan.hpp"
+#include "pose_playback.hpp"
+#include "pose_archive.hpp"
+#include "pose_cache.hpp"
+#include "benchmark_common.hpp"
+
+/**
+ * @brief times the per bone rotation work done by construct_rotations / apply_rotations:
+ * a rodrigues rotation between two bone directions, then rotating the child about the parent.
+ *
+ * @param iterations number of bones rotated
+ * @return nanoseconds per bone
+ */
+double benchmark_bone_rotation(unsigned int iterations = 1000000) {
+    std::vector<position> base_dirs;
+    std::vector<position> new_dirs;
+    for (unsigned int i = 0; i < 64; i++) {
+        float angle = 0.1f * i;
+        base_dirs.push_back(position(std::cos(angle), std::sin(angle), 0.25f));
+        new_dirs.push_back(position(0.5f, std::cos(angle), std::sin(angle)));
+    }
+    position parent(0.1f, 0.2f, 0.3f);
+
+    float sum = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (unsigned int i = 0; i < iterations; i++) {
+        position base_dir = base_dirs[i & 63];
+        position new_dir = new_dirs[i & 63];
+        matrix rotation = rodrigues(base_dir, new_dir);
+        position rotated = rotation.dot(base_dir).add(parent);
+        sum += rotated.x + rotated.y + rotated.z;
+    }
+    auto stop = std::chrono::high_resolution_clock::now();
+    benchmark_sink = sum;
+
+    double ns_per_bone = std::chrono::duration<double, std::nano>(stop - start).count() / iterations;
+    std::cout << "bone rotation: " << ns_per_bone << " ns per bone" << std::endl;
+    return ns_per_bone;
+}
+
+// the keypoint parsers as they were before keypoint_parser.hpp, kept to measure against
+
+position legacy_split_string_kp_into_arr (std::string keypoints, bool reverse_y=false) {
+    std::string end_bracket = "]";
+    std::string comma = ",";
+    int start, end = -1*comma.size();
+    float x;
+    start = end + comma.size();
+    end = keypoints.find(comma, start);    
+    std::string current_num = keypoints.substr(start, end-start);
+    // try catch for case of dangling ,
+    try {
+        x = stof(current_num);
+    } catch (...) {
+        start = end + comma.size();
+        end = keypoints.find(comma, start);    
+        std::string current_num = keypoints.substr(start, end-start);
+        x = stof(current_num);
+    }
+    start = end + comma.size();
+    end = keypoints.find(comma, start);
+    current_num = keypoints.substr(start, end-start);
+    float y = stof(current_num);
+    if (reverse_y)
+        y*=-1;
+
+    start = end + comma.size();
+    end = keypoints.find(comma, start);
+    // now you have 
+    current_num = keypoints.substr(start, end-start);
+    float z = stof(current_num);
+
+    return {x, y, z};
+}
+
+std::vector<position> legacy_split_blaze_keypoints (std::string kp, bool reverse_y=false) {
+    std::string end_bracket = "]";
+    std::string comma = ",";
+    int start, end = -1*end_bracket.size();
+    std::vector<position> positions; 
+    do {
+        start = end + end_bracket.size();
+        end = kp.find(end_bracket, start);
+        // now you have 
+        std::string keypoints = kp.substr(start, end-start);
+        keypoints.erase(remove(keypoints.begin(), keypoints.end(), '['), keypoints.end());
+        // now I should have NUM, NUM, NUM
+        if (keypoints.find(",") == std::string::npos)
+            break;
+        positions.push_back(
+            legacy_split_string_kp_into_arr(keypoints, reverse_y)
+        );
+    } while (end != -1);
+    return positions;
+}
+
+std::unordered_map<std::string, matrix> legacy_matrices_from_line(std::string line) {
+    // skip past frame info
+    int colon_pos = nthOccurrence(line, ":", 1);
+    std::string preparsed_file = line.substr(colon_pos);
+
+    std::regex between_brackets("\\{([^\\}]*)\\}");
+    std::sregex_iterator iterator(preparsed_file.begin(), preparsed_file.end(), between_brackets);
+    std::sregex_iterator end;
+    std::vector<std::string> martices;    
+    while (iterator != end) {
+        std::smatch match = *iterator;
+        martices.push_back(match[1].str());
+        ++iterator;
+    }
+
+    // now you have the stored positions, get the names
+    std::vector<std::string> names;
+    std::regex between_space_and_colon("\\s([^\\s]+):");
+    iterator = std::sregex_iterator(preparsed_file.begin(), preparsed_file.end(), between_space_and_colon);
+    while (iterator != end) {
+        std::smatch match = *iterator;
+        names.push_back(match[1].str());
+        ++iterator;
+    }
+
+
+
+    std::regex between_square_paren("\\[([^\\]]*)\\]");
+    // for each matrix, split into rows, then split into cells
+    std::vector<matrix> real_matrices;
+    for (std::string mat : martices) {
+        std::sregex_iterator row_iter  = std::sregex_iterator(mat.begin(), mat.end(), between_square_paren);
+        std::vector<std::vector<float>> num_mat;
+        while (row_iter != end) {
+            std::smatch match = *row_iter;
+            std::string row = match[1].str();
+            std::stringstream floats(row);
+            std::vector<float> num_row;
+            float i;
+            while (floats >> i) {
+                num_row.push_back(i);
+                if (floats.peek() == ',') 
+                    floats.ignore();
+            }
+            num_mat.push_back(num_row);
+            ++row_iter;
+        }
+        matrix local_matrix(num_mat);
+        real_matrices.push_back(local_matrix);
+    }
+
+    // now construct final name - rotation matrix hashmap
+    std::unordered_map<std::string, matrix> joint_matrix_map;
+    for (unsigned int i = 0; i < names.size(); i++) {
+        std::string name = names[i];
+        matrix matrix = real_matrices[i];
+        joint_matrix_map[name] = matrix;
+    }
+
+    return joint_matrix_map;
+}
+
+bool same_bits(float a, float b) {
+    return std::memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+/**
+ * @brief parses a capture in JOINT_FILEPATH (keypoint line, then FRAME lines) with the old
+ * string / regex parsers, the new string returning wrappers and the allocation free scanner
+ * writing into preallocated arrays, and prints the throughput of each in MB/s. Also checks
+ * that old and new produce bit identical floats.
+ *
+ * @param filename
+ * @param repeats passes over the file per measurement
+ * @return scanner MB/s
+ */
+double benchmark_keypoint_parser(const std::string& filename, unsigned int repeats = 3) {
+    std::ifstream file(JOINT_FILEPATH + filename, std::ios::binary);
+    if (!file.is_open()) {
+        std::cout << "ERROR: FAILED TO OPEN FILE " << JOINT_FILEPATH + filename << std::endl;
+        return 0;
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    std::string text = buffer.str();
+
+    std::vector<std::string> lines;
+    std::istringstream line_stream(text);
+    std::string line;
+    while (std::getline(line_stream, line))
+        lines.push_back(line);
+    if (lines.empty())
+        return 0;
+
+    // preallocated once: every keypoint of the first line, up to 64 matrices per frame
+    const size_t MATRICES_PER_FRAME = 64;
+    std::vector<float> keypoints(max_floats_in(lines[0].size()));
+    std::vector<float> rotations(lines.size() * MATRICES_PER_FRAME * 9);
+
+    auto mb_per_second = [&](auto parse) {
+        auto start = std::chrono::high_resolution_clock::now();
+        for (unsigned int r = 0; r < repeats; r++)
+            parse();
+        auto stop = std::chrono::high_resolution_clock::now();
+        double seconds = std::chrono::duration<double>(stop - start).count();
+        return seconds > 0 ? text.size() * (double) repeats / seconds / 1e6 : 0;
+    };
+
+    size_t sink = 0;
+    double legacy = mb_per_second([&]() {
+        sink += legacy_split_blaze_keypoints(lines[0]).size();
+        for (size_t i = 1; i < lines.size(); i++)
+            sink += legacy_matrices_from_line(lines[i]).size();
+    });
+    double wrappers = mb_per_second([&]() {
+        sink += split_blaze_keypoints(lines[0]).size();
+        for (size_t i = 1; i < lines.size(); i++)
+            sink += matrices_from_line(lines[i]).size();
+    });
+    double scanner = mb_per_second([&]() {
+        const std::string& first = lines[0];
+        sink += parse_keypoints(first.data(), first.data() + first.size(), keypoints.data(), keypoints.size() / 3);
+        for (size_t i = 1; i < lines.size(); i++) {
+            float* frame = rotations.data() + i * MATRICES_PER_FRAME * 9;
+            size_t slot = 0;
+            for_each_matrix_in_line(lines[i].data(), lines[i].data() + lines[i].size(),
+                [&](const char*, size_t, const float* rotation) {
+                    if (slot < MATRICES_PER_FRAME)
+                        std::memcpy(frame + 9 * slot++, rotation, 9 * sizeof(float));
+                });
+            sink += slot;
+        }
+    });
+    double raw_scan = mb_per_second([&]() {
+        sink += scan_floats(text.data(), text.data() + text.size(), rotations.data(), rotations.size());
+    });
+    benchmark_sink = sink;
+
+    // old and new must agree bit for bit
+    unsigned int mismatches = 0;
+    std::vector<position> old_positions = legacy_split_blaze_keypoints(lines[0]);
+    std::vector<position> new_positions = split_blaze_keypoints(lines[0]);
+    if (old_positions.size() != new_positions.size())
+        mismatches++;
+    for (size_t i = 0; i < old_positions.size() && i < new_positions.size(); i++) {
+        if (!same_bits(old_positions[i].x, new_positions[i].x) || !same_bits(old_positions[i].y, new_positions[i].y) ||
+            !same_bits(old_positions[i].z, new_positions[i].z))
+            mismatches++;
+    }
+    for (size_t i = 1; i < lines.size(); i++) {
+        auto old_map = legacy_matrices_from_line(lines[i]);
+        auto new_map = matrices_from_line(lines[i]);
+        if (old_map.size() != new_map.size())
+            mismatches++;
+        for (auto& pair : old_map) {
+            auto iter = new_map.find(pair.first);
+            if (iter == new_map.end() || std::memcmp(pair.second.mat, iter->second.mat, sizeof(pair.second.mat)) != 0)
+                mismatches++;
+        }
+    }
+
+    std::cout << filename << " (" << text.size() / 1e6 << " MB): legacy " << legacy << " MB/s, wrappers "
+        << wrappers << " MB/s, scanner " << scanner << " MB/s, raw scan_floats " << raw_scan << " MB/s, "
+        << mismatches << " mismatches" << std::endl;
+    return scanner;
+}
+
+void benchmark_keypoint_parser() {
+    benchmark_keypoint_parser("ymca_blaze_vamp.txt");
+    benchmark_keypoint_parser("head_test_blaze_vamp.txt");
+}
+
+/**
+ * @brief replays a capture in JOINT_FILEPATH into a temporary file at a fixed rate, one
+ * FRAME line per write like a live capture process would, while a pose_file_follower tails
+ * it and a consumer loop polls it. Prints the write -> poll latency per frame (mean, p99,
+ * max) next to the capture interval, plus frames shown and dropped.
+ *
+ * @param filename capture to replay
+ * @param fps capture rate
+ * @param frames FRAME lines written, the capture repeats if it is shorter
+ * @param policy
+ * @return mean latency in milliseconds
+ */
+double benchmark_pose_follow_latency(const std::string& filename, double fps, unsigned int frames, pose_follow_policy policy) {
+    std::ifstream file(JOINT_FILEPATH + filename, std::ios::binary);
+    if (!file.is_open()) {
+        std::cout << "ERROR: FAILED TO OPEN FILE " << JOINT_FILEPATH + filename << std::endl;
+        return 0;
+    }
+    std::vector<std::string> lines;
+    std::string line;
+    while (std::getline(file, line))
+        lines.push_back(line + "\n");
+    if (lines.size() < 2)
+        return 0;
+
+    std::string live_path = (std::filesystem::temp_directory_path() / "pose_follow_benchmark.txt").string();
+    FILE* live = fopen(live_path.c_str(), "wb");
+    if (live == NULL) {
+        std::cout << "ERROR: FAILED TO OPEN FILE " << live_path << std::endl;
+        return 0;
+    }
+
+    std::vector<std::string> slot_names;
+    bodymodel blaze = create_adjusted_blaze_model();
+    for (const bone& j : blaze.skel->bones)
+        slot_names.push_back(j.name);
+    pose_file_follower follower(live_path, slot_names);
+    follower.start();
+
+    // write time of every frame, published before the line reaches the file
+    std::vector<double> written_at(frames);
+    std::atomic<unsigned int> written{0};
+    std::thread writer([&]() {
+        fwrite(lines[0].data(), 1, lines[0].size(), live);
+        fflush(live);
+        double start = pose_follow_clock();
+        for (unsigned int i = 0; i < frames; i++) {
+            double due = start + i / fps;
+            while (pose_follow_clock() < due)
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            const std::string& frame_line = lines[1 + i % (lines.size() - 1)];
+            written_at[i] = pose_follow_clock();
+            written.store(i + 1, std::memory_order_release);
+            fwrite(frame_line.data(), 1, frame_line.size(), live);
+            fflush(live);
+        }
+    });
+
+    std::vector<double> latencies;
+    latencies.reserve(frames);
+    live_pose_sample sample;
+    double deadline = pose_follow_clock() + frames / fps + 2.0;
+    while (pose_follow_clock() < deadline) {
+        if (follower.poll(policy, sample) && sample.fresh && sample.sequence < written.load(std::memory_order_acquire)) {
+            latencies.push_back(pose_follow_clock() - written_at[sample.sequence]);
+            if (sample.sequence + 1 == frames)
+                break;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    writer.join();
+    follower.stop();
+    fclose(live);
+    std::filesystem::remove(live_path);
+
+    if (latencies.empty()) {
+        std::cout << "ERROR: NO FRAMES FOLLOWED" << std::endl;
+        return 0;
+    }
+    double mean = 0;
+    for (double l : latencies)
+        mean += l;
+    mean /= latencies.size();
+    std::sort(latencies.begin(), latencies.end());
+    double p99 = latencies[std::min(latencies.size() - 1, (size_t) (latencies.size() * 0.99))];
+
+    const char* policy_names[] = {"every frame", "latest", "interpolate"};
+    std::cout << filename << " at " << fps << " fps (" << policy_names[policy] << "): latency mean "
+        << mean * 1000.0 << " ms, p99 " << p99 * 1000.0 << " ms, max " << latencies.back() * 1000.0
+        << " ms, frame interval " << 1000.0 / fps << " ms, " << follower.FramesShown() << "/" << frames
+        << " frames shown, " << follower.FramesDropped() << " dropped" << std::endl;
+    return mean * 1000.0;
+}
+
+void benchmark_pose_follow_latency() {
+    benchmark_pose_follow_latency("ymca_blaze_vamp.txt", 30, 300, POSE_FOLLOW_EVERY_FRAME);
+    benchmark_pose_follow_latency("ymca_blaze_vamp.txt", 120, 600, POSE_FOLLOW_LATEST);
+    benchmark_pose_follow_latency("ymca_blaze_vamp.txt", 120, 600, POSE_FOLLOW_INTERPOLATE);
+}
+
+// the reference the blends are measured against
+void slerp_quaternion(const float* a, const float* b, double t, float* out) {
+    double dot = (double) a[0] * b[0] + (double) a[1] * b[1] + (double) a[2] * b[2] + (double) a[3] * b[3];
+    double sign = dot < 0 ? -1.0 : 1.0;
+    dot = std::min(1.0, std::fabs(dot));
+    double angle = std::acos(dot);
+    double w0 = 1.0 - t, w1 = t;
+    if (angle > 1e-6) {
+        w0 = std::sin((1.0 - t) * angle) / std::sin(angle);
+        w1 = std::sin(t * angle) / std::sin(angle);
+    }
+    for (int c = 0; c < 4; c++)
+        out[c] = (float) (a[c] * w0 + b[c] * w1 * sign);
+}
+
+/**
+ * @brief time based clip playback: per kernel cost of blending one frame's rotations, how
+ * far nlerp and the corrected nlerp land from an exact slerp, and the per render frame cost
+ * of blending + retargeting a capture played back at a render rate
+ *
+ * @param filename capture in joints_output
+ * @param capture_fps
+ * @param render_fps
+ * @param iterations blended frames per kernel
+ */
+void benchmark_pose_playback(const std::string& filename, double capture_fps, double render_fps, unsigned int iterations = 20000) {
+    typedef std::chrono::high_resolution_clock clock;
+    pose_stream stream;
+    bodymodel base_model = load_vamp_model_from_stream(ensure_pose_stream(filename), stream);
+    if (stream.frame_count() < 2) {
+        std::cout << "ERROR: NOT ENOUGH FRAMES IN " << filename << std::endl;
+        return;
+    }
+    pose_quaternion_track track(stream);
+    std::vector<float> rotations(track.rotation_floats());
+    pose_interpolation_scratch scratch;
+
+    std::cout << filename << ": " << track.frame_count << " frames, " << track.slot_count << " slots" << std::endl;
+    std::vector<float> reference(track.rotation_floats());
+    for (int k = 0; k <= (int) pose_simd_best_kernel(); k++) {
+        pose_simd_kernel kernel = (pose_simd_kernel) k;
+        auto start = clock::now();
+        for (unsigned int i = 0; i < iterations; i++) {
+            double position = std::fmod(i * 0.37, (double) track.frame_count);
+            interpolate_pose_rotations(track, position, POSE_INTERPOLATE_FAST_SLERP, scratch, rotations.data(), kernel);
+            benchmark_sink += rotations[i % rotations.size()];
+        }
+        double ns = std::chrono::duration<double, std::nano>(clock::now() - start).count() / iterations;
+
+        // every kernel against the scalar one on the same frame
+        double max_difference = 0;
+        interpolate_pose_rotations(track, 1.5, POSE_INTERPOLATE_FAST_SLERP, scratch, rotations.data(), kernel);
+        if (kernel == POSE_SIMD_SCALAR)
+            reference = rotations;
+        for (size_t i = 0; i < rotations.size(); i++)
+            max_difference = std::max(max_difference, (double) std::fabs(rotations[i] - reference[i]));
+        std::cout << "  " << POSE_SIMD_KERNEL_NAMES[k] << ": " << ns << " ns per frame, "
+            << ns / track.slot_count << " ns per slot, max difference to scalar " << max_difference << std::endl;
+    }
+
+    // accuracy, every interval of the clip at a few points in between
+    double nlerp_max = 0, fast_max = 0, nlerp_sum = 0, fast_sum = 0;
+    unsigned int samples = 0;
+    std::vector<float> nlerp_out(track.rotation_floats()), fast_out(track.rotation_floats());
+    for (uint32_t f = 0; f + 1 < track.frame_count; f++) {
+        for (double t = 0.125; t < 1.0; t += 0.125) {
+            interpolate_pose_rotations(track, f + t, POSE_INTERPOLATE_NLERP, scratch, nlerp_out.data(), POSE_SIMD_SCALAR);
+            interpolate_pose_rotations(track, f + t, POSE_INTERPOLATE_FAST_SLERP, scratch, fast_out.data(), POSE_SIMD_SCALAR);
+            const float* x = track.frame(f);
+            const float* y = track.frame(f + 1);
+            for (uint32_t s = 0; s < track.slot_count; s++) {
+                float a[4], b[4], exact[4], nlerp_q[4], fast_q[4];
+                for (int c = 0; c < 4; c++) {
+                    a[c] = x[c * track.padded_slots + s];
+                    b[c] = y[c * track.padded_slots + s];
+                }
+                slerp_quaternion(a, b, t, exact);
+                quaternion_from_rotation(nlerp_out.data() + s * POSE_STREAM_FLOATS_PER_ROTATION, nlerp_q);
+                quaternion_from_rotation(fast_out.data() + s * POSE_STREAM_FLOATS_PER_ROTATION, fast_q);
+                double nlerp_error = quaternion_angle_degrees(exact, nlerp_q);
+                double fast_error = quaternion_angle_degrees(exact, fast_q);
+                nlerp_max = std::max(nlerp_max, nlerp_error);
+                fast_max = std::max(fast_max, fast_error);
+                nlerp_sum += nlerp_error;
+                fast_sum += fast_error;
+                samples++;
+            }
+        }
+    }
+    std::cout << "  error to slerp: nlerp mean " << nlerp_sum / samples << " max " << nlerp_max
+        << " deg, fast slerp mean " << fast_sum / samples << " max " << fast_max << " deg" << std::endl;
+
+    // a render loop at render_fps over the whole clip, blend + retarget into the vertex floats
+    bodymodel blaze_model = create_adjusted_blaze_model();
+    retarget_plan plan = compile_retarget_plan(blaze_model, base_model, stream.bone_names());
+    std::vector<int> draw_order = base_model.position_indices_in_order();
+    std::vector<float> vertices(draw_order.size() * 3);
+    std::vector<position> positions;
+    pose_playback_clock playback(stream.frame_count(), capture_fps);
+    unsigned int renders = (unsigned int) std::ceil(playback.duration() * render_fps);
+    std::vector<double> costs;
+    costs.reserve(renders);
+    for (unsigned int i = 0; i < renders; i++) {
+        auto start = clock::now();
+        retarget_playback_frame_into(plan, track, playback.frame_position(), POSE_INTERPOLATE_FAST_SLERP,
+            base_model.positions, draw_order, rotations, scratch, positions, vertices.data());
+        costs.push_back(std::chrono::duration<double, std::micro>(clock::now() - start).count());
+        benchmark_sink += vertices[i % vertices.size()];
+        playback.advance(1.0 / render_fps);
+    }
+    double mean = 0;
+    for (double c : costs)
+        mean += c;
+    mean /= costs.size();
+    std::sort(costs.begin(), costs.end());
+    std::cout << "  " << capture_fps << " Hz capture at " << render_fps << " Hz: " << renders << " render frames, blend + retarget mean "
+        << mean << " us, p99 " << costs[std::min(costs.size() - 1, (size_t) (costs.size() * 0.99))] << " us, max "
+        << costs.back() << " us of a " << 1e6 / render_fps << " us frame" << std::endl;
+}
+
+void benchmark_pose_playback() {
+    benchmark_pose_playback("ymca_blaze_vamp.txt", 30, 144);
+    benchmark_pose_playback("head_test_blaze_vamp.txt", 30, 144);
+}
+
+/**
+ * @brief heap taken by the frames load_vamp_model_from_path returns, counted from the
+ * container sizes (nodes, buckets and long names), allocator overhead not included
+ */
+size_t estimate_rotation_map_bytes(const std::vector<std::unordered_map<std::string, matrix>>& frames) {
+    // libstdc++ node: next pointer, the pair and the cached hash
+    size_t node = sizeof(void*) + sizeof(std::pair<const std::string, matrix>) + sizeof(size_t);
+    size_t bytes = frames.capacity() * sizeof(frames[0]);
+    for (const auto& frame : frames) {
+        bytes += frame.bucket_count() * sizeof(void*) + frame.size() * node;
+        for (const auto& pair : frame)
+            if (pair.first.capacity() > 15)
+                bytes += pair.first.capacity() + 1;
+    }
+    return bytes;
+}
+
+/**
+ * @brief compresses a capture into a .parc and reports its size against the text capture,
+ * the in memory frames, and the .pstream; the largest decoded error; and how fast it
+ * decodes whole blocks, single frames, and straight into a pose cache next to the stream
+ *
+ * @param filename text capture in joints_output
+ * @param tolerance_degrees
+ * @param iterations decode passes over the clip
+ */
+void benchmark_pose_archive(const std::string& filename, float tolerance_degrees = POSE_ARCHIVE_DEFAULT_TOLERANCE_DEGREES,
+    unsigned int iterations = 50)
+{
+    typedef std::chrono::high_resolution_clock clock;
+    std::string stem = filename.substr(0, filename.find_last_of('.'));
+    pose_stream stream;
+    bodymodel base_model = load_vamp_model_from_stream(ensure_pose_stream(filename), stream);
+    std::string archive_path = JOINT_FILEPATH + stem + POSE_ARCHIVE_EXTENSION;
+    pose_archive_stats stats;
+    pose_archive archive;
+    if (stream.frame_count() == 0 ||
+        !write_pose_archive(archive_path, stream, tolerance_degrees, POSE_ARCHIVE_BLOCK_FRAMES, &stats) ||
+        !archive.open(archive_path)) {
+        std::cout << "ERROR: FAILED TO ARCHIVE " << filename << std::endl;
+        return;
+    }
+
+    size_t text_bytes = std::filesystem::file_size(JOINT_FILEPATH + filename);
+    auto [text_model, text_frames] = load_vamp_model_from_path(JOINT_FILEPATH + filename, false);
+    size_t map_bytes = estimate_rotation_map_bytes(text_frames);
+    std::cout << filename << ": " << stats.frames << " frames, " << stats.slots << " slots, tolerance "
+        << tolerance_degrees << " deg, " << stats.keys << " keys (" << 100.0 * stats.keys / ((double) stats.frames * stats.slots)
+        << "% of rotations), encoded in " << stats.encode_ms << " ms" << std::endl;
+    std::cout << "  text " << text_bytes << " B, in memory frames ~" << map_bytes << " B, pstream " << stream.size()
+        << " B, archive " << archive.size() << " B: " << (double) text_bytes / archive.size() << "x text, "
+        << (double) map_bytes / archive.size() << "x in memory, " << (double) stream.size() / archive.size()
+        << "x pstream" << std::endl;
+
+    // every decoded rotation against the stream
+    std::vector<float> decoded((size_t) archive.block_frames() * archive.frame_stride());
+    double max_error = 0;
+    for (uint32_t block = 0; block < archive.block_count(); block++) {
+        archive.decode_block(block, decoded.data());
+        for (uint32_t f = 0; f < archive.block_length(block); f++) {
+            for (uint32_t s = 0; s < archive.bone_count(); s++) {
+                float expected[4], actual[4];
+                size_t offset = s * POSE_STREAM_FLOATS_PER_ROTATION;
+                quaternion_from_rotation(stream.frame_data(archive.block_first_frame(block) + f) + offset, expected);
+                quaternion_from_rotation(decoded.data() + (size_t) f * archive.frame_stride() + offset, actual);
+                max_error = std::max(max_error, quaternion_angle_degrees(expected, actual));
+            }
+        }
+    }
+    std::cout << "  max decoded error " << max_error << " deg (encoder measured " << stats.max_error_degrees << ")" << std::endl;
+
+    auto start = clock::now();
+    for (unsigned int i = 0; i < iterations; i++) {
+        for (uint32_t block = 0; block < archive.block_count(); block++) {
+            archive.decode_block(block, decoded.data());
+            benchmark_sink += decoded[block % decoded.size()];
+        }
+    }
+    double block_seconds = std::chrono::duration<double>(clock::now() - start).count();
+    double frames_decoded = (double) iterations * archive.frame_count();
+    start = clock::now();
+    for (unsigned int i = 0; i < iterations; i++) {
+        for (uint32_t f = 0; f < archive.frame_count(); f++) {
+            // a stride through the clip, not in order
+            archive.decode_frame((f * 7919u) % archive.frame_count(), decoded.data());
+            benchmark_sink += decoded[f % archive.frame_stride()];
+        }
+    }
+    double frame_seconds = std::chrono::duration<double>(clock::now() - start).count();
+    std::cout << "  decode: blocks " << frames_decoded / block_seconds << " frames/s ("
+        << frames_decoded * archive.frame_stride() * sizeof(float) / block_seconds / 1e6 << " MB/s of rotations), random frames "
+        << frames_decoded / frame_seconds << " frames/s" << std::endl;
+
+    bodymodel blaze_model = create_adjusted_blaze_model();
+    retarget_plan plan = compile_retarget_plan(blaze_model, base_model, stream.bone_names());
+    std::vector<int> draw_order = base_model.position_indices_in_order();
+    work_stealing_pool& pool = benchmark_pool();
+    pose_cache from_stream = build_position_cache(plan, stream, base_model.positions, draw_order, pool);
+    pose_cache from_archive = build_position_cache(plan, archive, base_model.positions, draw_order, pool);
+    double max_distance = 0;
+    for (size_t i = 0; i < from_stream.data.size(); i++)
+        max_distance = std::max(max_distance, (double) std::fabs(from_stream.data[i] - from_archive.data[i]));
+    std::cout << "  pose cache on " << pool.size() << " threads: from pstream " << from_stream.build_seconds * 1000.0
+        << " ms, from archive " << from_archive.build_seconds * 1000.0 << " ms, largest coordinate difference "
+        << max_distance << std::endl;
+}
+
+void benchmark_pose_archive() {
+    benchmark_pose_archive("ymca_blaze_vamp.txt");
+    benchmark_pose_archive("head_test_blaze_vamp.txt");
+}
+
+#endif
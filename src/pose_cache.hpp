@@ -0,0 +1,158 @@
+#ifndef POSE_CACHE_HPP
+#define POSE_CACHE_HPP
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+
+#include "skeleton_utils.h"
+#include "pose_stream.hpp"
+#include "pose_archive.hpp"
+#include "retarget_plan.hpp"
+#include "work_stealing_pool.hpp"
+
+// frames handed to a worker at a time when batch retargeting
+const size_t POSE_CACHE_FRAME_GRAIN = 16;
+
+/**
+ * Every frame of a clip retargeted ahead of time. Frames are stored back to back,
+ * each one already flattened in draw order (xyz per vertex), so the render loop only
+ * indexes into it and uploads.
+ */
+struct pose_cache {
+    uint32_t frame_count = 0;
+    uint32_t floats_per_frame = 0;
+    std::vector<float> data;
+
+    // timing of the batch that filled the cache
+    double build_seconds = 0;
+    unsigned int build_threads = 0;
+
+    const float* frame(uint32_t index) const {
+        return data.data() + (size_t) index * floats_per_frame;
+    }
+
+    uint32_t vertices_per_frame() const { return floats_per_frame / 3; }
+
+    double frames_per_second() const {
+        return build_seconds > 0 ? frame_count / build_seconds : 0;
+    }
+};
+
+/**
+ * @brief retargets every frame of a pose stream across the pool into a frame major cache,
+ * writing each frame's positions in the given order. Frames are independent, so each
+ * worker keeps one scratch position buffer and writes its frames straight into their
+ * slots of the cache.
+ *
+ * @param plan compiled against stream.bone_names()
+ * @param stream
+ * @param base_positions vampire rest positions
+ * @param order position indices written per frame, e.g. a draw order
+ * @param pool
+ * @return pose_cache
+ */
+pose_cache build_position_cache(
+    const retarget_plan& plan,
+    const pose_stream& stream,
+    const std::vector<position>& base_positions,
+    const std::vector<int>& order,
+    work_stealing_pool& pool)
+{
+    pose_cache cache;
+    cache.frame_count = stream.frame_count();
+    cache.floats_per_frame = order.size() * 3;
+    cache.data.resize((size_t) cache.frame_count * cache.floats_per_frame);
+    cache.build_threads = pool.size();
+
+    std::vector<std::vector<position>> scratch(pool.size(), base_positions);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    pool.parallel_for(cache.frame_count, POSE_CACHE_FRAME_GRAIN,
+        [&](size_t begin, size_t end, unsigned int worker) {
+            std::vector<position>& positions = scratch[worker];
+            for (size_t f = begin; f < end; f++) {
+                retarget_frame_into(plan, stream.frame_data(f), base_positions, order,
+                    positions, cache.data.data() + f * cache.floats_per_frame);
+            }
+        });
+    auto stop = std::chrono::high_resolution_clock::now();
+    cache.build_seconds = std::chrono::duration<double>(stop - start).count();
+    return cache;
+}
+
+/**
+ * @brief build_position_cache from a compressed archive. Workers take whole blocks, decode
+ * each into their own scratch frames and retarget those, so the clip is never held
+ * uncompressed except for the cache itself.
+ *
+ * @param plan compiled against archive.bone_names()
+ * @param archive
+ * @param base_positions vampire rest positions
+ * @param order position indices written per frame, e.g. a draw order
+ * @param pool
+ * @return pose_cache
+ */
+pose_cache build_position_cache(
+    const retarget_plan& plan,
+    const pose_archive& archive,
+    const std::vector<position>& base_positions,
+    const std::vector<int>& order,
+    work_stealing_pool& pool)
+{
+    pose_cache cache;
+    cache.frame_count = archive.frame_count();
+    cache.floats_per_frame = order.size() * 3;
+    cache.data.resize((size_t) cache.frame_count * cache.floats_per_frame);
+    cache.build_threads = pool.size();
+
+    std::vector<std::vector<position>> scratch(pool.size(), base_positions);
+    std::vector<std::vector<float>> decoded(pool.size(),
+        std::vector<float>((size_t) archive.block_frames() * archive.frame_stride()));
+
+    auto start = std::chrono::high_resolution_clock::now();
+    pool.parallel_for(archive.block_count(), 1,
+        [&](size_t begin, size_t end, unsigned int worker) {
+            std::vector<position>& positions = scratch[worker];
+            float* frames = decoded[worker].data();
+            for (size_t block = begin; block < end; block++) {
+                archive.decode_block(block, frames);
+                uint32_t first = archive.block_first_frame(block);
+                for (uint32_t f = 0; f < archive.block_length(block); f++) {
+                    retarget_frame_into(plan, frames + (size_t) f * archive.frame_stride(), base_positions, order,
+                        positions, cache.data.data() + (size_t) (first + f) * cache.floats_per_frame);
+                }
+            }
+        });
+    auto stop = std::chrono::high_resolution_clock::now();
+    cache.build_seconds = std::chrono::duration<double>(stop - start).count();
+    return cache;
+}
+
+/**
+ * @brief retargets a whole clip in draw order, ready for the render loop
+ *
+ * @param plan compiled against stream.bone_names()
+ * @param stream
+ * @param base_model vampire model at rest, provides base positions and draw order
+ * @param pool
+ * @return pose_cache
+ */
+pose_cache build_pose_cache(
+    const retarget_plan& plan,
+    const pose_stream& stream,
+    bodymodel& base_model,
+    work_stealing_pool& pool)
+{
+    pose_cache cache = build_position_cache(plan, stream, base_model.positions,
+        base_model.position_indices_in_order(), pool);
+
+    std::cout << "Retargeted " << cache.frame_count << " frames in " << cache.build_seconds * 1000.0
+        << " ms on " << cache.build_threads << " threads (" << cache.frames_per_second()
+        << " frames/s)" << std::endl;
+
+    return cache;
+}
+
+#endif
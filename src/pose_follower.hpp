@@ -0,0 +1,115 @@
+#ifndef POSE_FOLLOWER_HPP
+#define POSE_FOLLOWER_HPP
+
+#include <vector>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+#include "live_pose_source.hpp"
+
+// bytes read from the capture per read call
+const size_t POSE_FOLLOW_READ_CHUNK = 64 * 1024;
+
+/**
+ * Follows a capture file while another process appends to it. The reader thread picks up
+ * new bytes (inotify on Linux, a short poll elsewhere) and parses only complete lines,
+ * the first line carries the base positions. When the render loop falls behind the rest
+ * of the capture waits in the file.
+ */
+class pose_file_follower : public live_pose_source {
+public:
+    /**
+     * @param path capture being written, may not exist yet
+     * @param slot_names rotation name per slot, the layout frames are written in
+     * @param queue_capacity frames buffered between reader and render loop
+     */
+    pose_file_follower(const std::string& path, const std::vector<std::string>& slot_names, size_t queue_capacity = 64)
+        : live_pose_source(slot_names, queue_capacity), path(path)
+    {
+        buffer.resize(POSE_FOLLOW_READ_CHUNK * 2);
+    }
+
+    ~pose_file_follower() {
+        stop();
+    }
+
+private:
+    std::string path;
+    std::vector<char> buffer;
+    size_t buffered = 0;
+
+    /* reads whatever was appended since the last call and parses the complete lines,
+    a trailing partial line stays buffered until its newline arrives*/
+    void read_available(FILE* file) {
+        while (!stopping.load()) {
+            if (buffer.size() - buffered < POSE_FOLLOW_READ_CHUNK)
+                buffer.resize(buffer.size() * 2);
+            size_t got = fread(buffer.data() + buffered, 1, POSE_FOLLOW_READ_CHUNK, file);
+            if (got == 0) {
+                // at the current end of the file, clear EOF so later appends are seen
+                clearerr(file);
+                return;
+            }
+            bytes_read.fetch_add(got, std::memory_order_relaxed);
+
+            buffered += got;
+            size_t consumed = parse_text_lines(buffer.data(), buffered);
+            if (consumed > 0) {
+                std::memmove(buffer.data(), buffer.data() + consumed, buffered - consumed);
+                buffered -= consumed;
+            }
+        }
+    }
+
+    void run() override {
+        FILE* file = NULL;
+        while (file == NULL && !stopping.load()) {
+            file = fopen(path.c_str(), "rb");
+            if (file == NULL)
+                std::this_thread::sleep_for(std::chrono::microseconds(POSE_FOLLOW_POLL_MICROSECONDS));
+        }
+        if (file == NULL)
+            return;
+
+#ifdef __linux__
+        int notify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (notify >= 0 && inotify_add_watch(notify, path.c_str(), IN_MODIFY | IN_CLOSE_WRITE) < 0) {
+            close(notify);
+            notify = -1;
+        }
+#endif
+
+        while (!stopping.load()) {
+            read_available(file);
+#ifdef __linux__
+            if (notify >= 0) {
+                // wakes on the next write, the timeout only bounds how long stop() waits
+                pollfd watch = {notify, POLLIN, 0};
+                if (::poll(&watch, 1, 50) > 0) {
+                    char events[4096];
+                    while (read(notify, events, sizeof(events)) > 0) {}
+                }
+                continue;
+            }
+#endif
+            std::this_thread::sleep_for(std::chrono::microseconds(POSE_FOLLOW_POLL_MICROSECONDS));
+        }
+
+#ifdef __linux__
+        if (notify >= 0)
+            close(notify);
+#endif
+        fclose(file);
+    }
+};
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef POSE_FRAME_QUEUE_HPP
+#define POSE_FRAME_QUEUE_HPP
+
+#include <atomic>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * Bounded single producer / single consumer ring of fixed size pose frames. Frame data
+ * lives in one preallocated block, the producer fills a slot in place and publishes it,
+ * the consumer reads slots in order and releases them. Lock free: the only shared state
+ * is the head and tail counters.
+ */
+class pose_frame_queue {
+public:
+    /**
+     * @param capacity frames the ring holds, rounded up to a power of two
+     * @param floats_per_frame e.g. slot count * POSE_STREAM_FLOATS_PER_ROTATION
+     */
+    pose_frame_queue(size_t capacity, size_t floats_per_frame)
+        : floats_per_frame(floats_per_frame)
+    {
+        size_t rounded = 1;
+        while (rounded < capacity)
+            rounded <<= 1;
+        mask = rounded - 1;
+        data.resize(rounded * floats_per_frame);
+        sequences.resize(rounded);
+        seconds.resize(rounded);
+    }
+
+    pose_frame_queue(const pose_frame_queue&) = delete;
+    pose_frame_queue& operator=(const pose_frame_queue&) = delete;
+
+    size_t capacity() const { return mask + 1; }
+    size_t frame_floats() const { return floats_per_frame; }
+
+    // frames waiting for the consumer, exact on the consumer thread
+    size_t size() const {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief producer: slot to fill for the next frame, NULL while the ring is full
+     */
+    float* begin_push() {
+        uint64_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) > mask)
+            return NULL;
+        return data.data() + (t & mask) * floats_per_frame;
+    }
+
+    /**
+     * @brief producer: publishes the slot returned by begin_push
+     *
+     * @param sequence frame number within the capture
+     * @param time_seconds when the frame was read, steady clock
+     */
+    void end_push(uint64_t sequence, double time_seconds) {
+        uint64_t t = tail.load(std::memory_order_relaxed);
+        sequences[t & mask] = sequence;
+        seconds[t & mask] = time_seconds;
+        tail.store(t + 1, std::memory_order_release);
+    }
+
+    // consumer: i-th waiting frame, i < size()
+    const float* peek(size_t i = 0) const {
+        return data.data() + ((head.load(std::memory_order_relaxed) + i) & mask) * floats_per_frame;
+    }
+    uint64_t peek_sequence(size_t i = 0) const {
+        return sequences[(head.load(std::memory_order_relaxed) + i) & mask];
+    }
+    double peek_seconds(size_t i = 0) const {
+        return seconds[(head.load(std::memory_order_relaxed) + i) & mask];
+    }
+
+    /**
+     * @brief consumer: hands count frames back to the producer
+     */
+    void pop(size_t count = 1) {
+        head.store(head.load(std::memory_order_relaxed) + count, std::memory_order_release);
+    }
+
+private:
+    size_t floats_per_frame;
+    size_t mask;
+    std::vector<float> data;
+    std::vector<uint64_t> sequences;
+    std::vector<double> seconds;
+
+    // on separate cache lines so producer and consumer do not share one
+    alignas(64) std::atomic<uint64_t> head{0};
+    alignas(64) std::atomic<uint64_t> tail{0};
+};
+
+#endif
@@ -0,0 +1,558 @@
+#ifndef POSE_INGEST_HPP
+#define POSE_INGEST_HPP
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdint>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+#include "live_pose_source.hpp"
+
+/*
+ * Local pose ingest: a producer (the capture process) connects to a Unix domain socket,
+ * or a named pipe on Windows, and streams poses into the running app.
+ *
+ * A connection either speaks the capture text format, base positions line then FRAME
+ * lines, or starts with the binary magic, all values little endian:
+ *
+ *   char     magic[4]       "PING"
+ *   uint32_t slot_count
+ *   char     names[slot_count][POSE_STREAM_NAME_SIZE]   null padded, as in .pstream
+ *   uint32_t position_count
+ *   float    base_positions[position_count][3]
+ *
+ * followed by one length prefixed message per frame:
+ *
+ *   uint32_t length         bytes that follow, 8 + slot_count * 9 * 4
+ *   uint64_t sequence
+ *   float    rotations[slot_count][9]
+ */
+
+const char POSE_INGEST_MAGIC[4] = {'P', 'I', 'N', 'G'};
+// bytes read per call on text connections
+const size_t POSE_INGEST_READ_CHUNK = 64 * 1024;
+// how long blocking calls wait before checking for stop()
+const int POSE_INGEST_WAIT_MS = 50;
+// sanity limits on binary headers
+const uint32_t POSE_INGEST_MAX_SLOTS = 4096;
+const uint32_t POSE_INGEST_MAX_POSITIONS = 65536;
+
+#ifdef _WIN32
+const std::string POSE_INGEST_DEFAULT_ENDPOINT = "\\\\.\\pipe\\pose_ingest";
+#else
+const std::string POSE_INGEST_DEFAULT_ENDPOINT = "/tmp/pose_ingest.sock";
+#endif
+
+/**
+ * Server end of the ingest channel, one producer at a time.
+ */
+class pose_ingest_listener {
+public:
+    pose_ingest_listener() {}
+    pose_ingest_listener(const pose_ingest_listener&) = delete;
+    pose_ingest_listener& operator=(const pose_ingest_listener&) = delete;
+
+    ~pose_ingest_listener() {
+        close();
+    }
+
+    bool open(const std::string& endpoint) {
+        close();
+        name = endpoint;
+#ifdef _WIN32
+        pipe = CreateNamedPipeA(endpoint.c_str(), PIPE_ACCESS_INBOUND | FILE_FLAG_OVERLAPPED,
+            PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT, 1, 0, 1 << 20, 0, NULL);
+        if (pipe == INVALID_HANDLE_VALUE)
+            return false;
+        event = CreateEventA(NULL, TRUE, FALSE, NULL);
+        return event != NULL;
+#else
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        if (endpoint.size() >= sizeof(address.sun_path))
+            return false;
+        std::memcpy(address.sun_path, endpoint.c_str(), endpoint.size() + 1);
+        // a socket file left behind by an earlier run
+        unlink(endpoint.c_str());
+        listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listen_fd < 0)
+            return false;
+        if (bind(listen_fd, (sockaddr*) &address, sizeof(address)) < 0 || listen(listen_fd, 1) < 0) {
+            close();
+            return false;
+        }
+        return true;
+#endif
+    }
+
+    /**
+     * @brief waits up to timeout_ms for a producer to connect
+     *
+     * @param timeout_ms
+     * @return true when one is connected
+     */
+    bool accept(int timeout_ms) {
+#ifdef _WIN32
+        if (!pending) {
+            ZeroMemory(&overlapped, sizeof(overlapped));
+            overlapped.hEvent = event;
+            if (ConnectNamedPipe(pipe, &overlapped))
+                return true;
+            DWORD error = GetLastError();
+            if (error == ERROR_PIPE_CONNECTED)
+                return true;
+            if (error != ERROR_IO_PENDING)
+                return false;
+            pending = true;
+        }
+        if (WaitForSingleObject(event, timeout_ms) != WAIT_OBJECT_0)
+            return false;
+        pending = false;
+        DWORD unused;
+        return GetOverlappedResult(pipe, &overlapped, &unused, FALSE) != 0;
+#else
+        pollfd waiting = {listen_fd, POLLIN, 0};
+        if (::poll(&waiting, 1, timeout_ms) <= 0)
+            return false;
+        connection_fd = ::accept(listen_fd, NULL, NULL);
+        return connection_fd >= 0;
+#endif
+    }
+
+    /**
+     * @brief reads what the producer sent, waiting up to timeout_ms when nothing is there
+     *
+     * @param data
+     * @param size
+     * @param timeout_ms
+     * @return bytes read, 0 on timeout, -1 once the producer disconnected
+     */
+    long read(void* data, size_t size, int timeout_ms) {
+#ifdef _WIN32
+        DWORD available = 0;
+        DWORD waited = 0;
+        while (true) {
+            if (!PeekNamedPipe(pipe, NULL, 0, NULL, &available, NULL))
+                return -1;
+            if (available > 0)
+                break;
+            if ((int) waited >= timeout_ms)
+                return 0;
+            Sleep(1);
+            waited++;
+        }
+        // never blocks, the bytes are already there
+        ZeroMemory(&overlapped, sizeof(overlapped));
+        overlapped.hEvent = event;
+        DWORD got = 0;
+        DWORD wanted = (DWORD) std::min<size_t>(size, available);
+        if (!ReadFile(pipe, data, wanted, NULL, &overlapped) && GetLastError() != ERROR_IO_PENDING)
+            return -1;
+        if (!GetOverlappedResult(pipe, &overlapped, &got, TRUE))
+            return -1;
+        return got;
+#else
+        while (true) {
+            ssize_t got = recv(connection_fd, data, size, MSG_DONTWAIT);
+            if (got > 0)
+                return got;
+            if (got == 0)
+                return -1;
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                return -1;
+            pollfd waiting = {connection_fd, POLLIN, 0};
+            int ready = ::poll(&waiting, 1, timeout_ms);
+            if (ready == 0)
+                return 0;
+            if (ready < 0 && errno != EINTR)
+                return -1;
+        }
+#endif
+    }
+
+    // drops the current producer, accept() takes the next one
+    void disconnect() {
+#ifdef _WIN32
+        if (pipe != INVALID_HANDLE_VALUE)
+            DisconnectNamedPipe(pipe);
+#else
+        if (connection_fd >= 0)
+            ::close(connection_fd);
+        connection_fd = -1;
+#endif
+    }
+
+    void close() {
+        disconnect();
+#ifdef _WIN32
+        if (pipe != INVALID_HANDLE_VALUE) {
+            if (pending)
+                CancelIo(pipe);
+            CloseHandle(pipe);
+        }
+        if (event != NULL)
+            CloseHandle(event);
+        pipe = INVALID_HANDLE_VALUE;
+        event = NULL;
+        pending = false;
+#else
+        if (listen_fd >= 0) {
+            ::close(listen_fd);
+            unlink(name.c_str());
+        }
+        listen_fd = -1;
+#endif
+    }
+
+private:
+    std::string name;
+#ifdef _WIN32
+    HANDLE pipe = INVALID_HANDLE_VALUE;
+    HANDLE event = NULL;
+    OVERLAPPED overlapped = {};
+    bool pending = false;
+#else
+    int listen_fd = -1;
+    int connection_fd = -1;
+#endif
+};
+
+/**
+ * Producer end of the ingest channel, used by tools/pose_replay.cpp.
+ */
+class pose_ingest_client {
+public:
+    pose_ingest_client() {}
+    pose_ingest_client(const pose_ingest_client&) = delete;
+    pose_ingest_client& operator=(const pose_ingest_client&) = delete;
+
+    ~pose_ingest_client() {
+        close();
+    }
+
+    bool connect(const std::string& endpoint) {
+        close();
+#ifdef _WIN32
+        pipe = CreateFileA(endpoint.c_str(), GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+        if (pipe == INVALID_HANDLE_VALUE && GetLastError() == ERROR_PIPE_BUSY && WaitNamedPipeA(endpoint.c_str(), 1000))
+            pipe = CreateFileA(endpoint.c_str(), GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+        return pipe != INVALID_HANDLE_VALUE;
+#else
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        if (endpoint.size() >= sizeof(address.sun_path))
+            return false;
+        std::memcpy(address.sun_path, endpoint.c_str(), endpoint.size() + 1);
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0)
+            return false;
+        if (::connect(fd, (sockaddr*) &address, sizeof(address)) < 0) {
+            close();
+            return false;
+        }
+        return true;
+#endif
+    }
+
+    /**
+     * @brief writes all of data, blocking while the server is behind
+     *
+     * @return false once the server went away
+     */
+    bool write(const void* data, size_t size) {
+        const char* bytes = (const char*) data;
+        while (size > 0) {
+#ifdef _WIN32
+            DWORD sent = 0;
+            if (!WriteFile(pipe, bytes, (DWORD) size, &sent, NULL))
+                return false;
+#else
+#ifdef MSG_NOSIGNAL
+            ssize_t sent = send(fd, bytes, size, MSG_NOSIGNAL);
+#else
+            ssize_t sent = send(fd, bytes, size, 0);
+#endif
+            if (sent < 0 && errno == EINTR)
+                continue;
+            if (sent <= 0)
+                return false;
+#endif
+            bytes += sent;
+            size -= sent;
+        }
+        return true;
+    }
+
+    /**
+     * @brief sends the binary header, see the layout at the top of this file
+     *
+     * @param slot_names slot order of every frame sent after it
+     * @param base_positions
+     * @return false once the server went away
+     */
+    bool write_binary_header(const std::vector<std::string>& slot_names, const std::vector<position>& base_positions) {
+        std::vector<char> header(4 + 4 + slot_names.size() * POSE_STREAM_NAME_SIZE + 4 + base_positions.size() * 3 * sizeof(float), 0);
+        char* p = header.data();
+        uint32_t slot_count = slot_names.size();
+        uint32_t position_count = base_positions.size();
+        std::memcpy(p, POSE_INGEST_MAGIC, 4);
+        std::memcpy(p + 4, &slot_count, 4);
+        p += 8;
+        for (const std::string& name : slot_names) {
+            std::memcpy(p, name.data(), std::min<size_t>(name.size(), POSE_STREAM_NAME_SIZE - 1));
+            p += POSE_STREAM_NAME_SIZE;
+        }
+        std::memcpy(p, &position_count, 4);
+        p += 4;
+        for (const position& pos : base_positions) {
+            float xyz[3] = {pos.x, pos.y, pos.z};
+            std::memcpy(p, xyz, sizeof(xyz));
+            p += sizeof(xyz);
+        }
+        return write(header.data(), header.size());
+    }
+
+    /**
+     * @brief sends one binary frame message in a single write
+     *
+     * @param sequence
+     * @param rotations slot_count * 9 floats in header slot order
+     * @param slot_count
+     * @return false once the server went away
+     */
+    bool write_binary_frame(uint64_t sequence, const float* rotations, uint32_t slot_count) {
+        uint32_t length = 8 + slot_count * POSE_STREAM_FLOATS_PER_ROTATION * sizeof(float);
+        message.resize(4 + length);
+        std::memcpy(message.data(), &length, 4);
+        std::memcpy(message.data() + 4, &sequence, 8);
+        std::memcpy(message.data() + 12, rotations, length - 8);
+        return write(message.data(), message.size());
+    }
+
+    void close() {
+#ifdef _WIN32
+        if (pipe != INVALID_HANDLE_VALUE)
+            CloseHandle(pipe);
+        pipe = INVALID_HANDLE_VALUE;
+#else
+        if (fd >= 0)
+            ::close(fd);
+        fd = -1;
+#endif
+    }
+
+private:
+    std::vector<char> message;
+#ifdef _WIN32
+    HANDLE pipe = INVALID_HANDLE_VALUE;
+#else
+    int fd = -1;
+#endif
+};
+
+/**
+ * Receives poses from a local producer on a dedicated I/O thread. Text and binary frames
+ * are decoded straight into the queue slot the render loop retargets from; binary frames
+ * whose slot order matches are copied once, from the read buffer into the slot, others go
+ * through staging and are remapped slot by slot.
+ * Base positions come from the first connection, later producers may reconnect.
+ */
+class pose_ingest_server : public live_pose_source {
+public:
+    /**
+     * @param endpoint socket path, or pipe name on Windows
+     * @param slot_names rotation name per slot, the layout frames are written in
+     * @param queue_capacity frames buffered between the I/O thread and render loop
+     */
+    pose_ingest_server(const std::string& endpoint, const std::vector<std::string>& slot_names, size_t queue_capacity = 64)
+        : live_pose_source(slot_names, queue_capacity), endpoint(endpoint)
+    {
+        buffer.resize(POSE_INGEST_READ_CHUNK * 2);
+    }
+
+    ~pose_ingest_server() {
+        stop();
+    }
+
+    // true once the endpoint accepts producers
+    bool Listening() const { return listening.load(); }
+    uint64_t Connections() const { return connections.load(std::memory_order_relaxed); }
+
+private:
+    std::string endpoint;
+    pose_ingest_listener listener;
+    std::atomic<bool> listening{false};
+    std::atomic<uint64_t> connections{0};
+
+    // bytes received and not decoded yet are buffer[decoded, buffered)
+    std::vector<char> buffer;
+    size_t decoded = 0;
+    size_t buffered = 0;
+    // binary connections, producer slot -> our slot
+    std::vector<int> remap;
+    std::vector<float> staging;
+
+    /* copies size bytes of the connection into out, first what is buffered, then reads.
+    A frame is usually already buffered whole, so small messages cost one copy and no
+    extra reads */
+    bool take(void* out, size_t size) {
+        char* bytes = (char*) out;
+        while (size > 0) {
+            if (decoded == buffered) {
+                if (stopping.load())
+                    return false;
+                decoded = buffered = 0;
+                long got = listener.read(buffer.data(), buffer.size(), POSE_INGEST_WAIT_MS);
+                if (got < 0)
+                    return false;
+                buffered = got;
+                bytes_read.fetch_add(got, std::memory_order_relaxed);
+                continue;
+            }
+            size_t count = std::min(size, buffered - decoded);
+            std::memcpy(bytes, buffer.data() + decoded, count);
+            decoded += count;
+            bytes += count;
+            size -= count;
+        }
+        return true;
+    }
+
+    // text connections keep decoded at 0, complete lines are moved out of the buffer
+    void serve_text() {
+        while (!stopping.load()) {
+            size_t consumed = parse_text_lines(buffer.data(), buffered);
+            if (consumed > 0) {
+                std::memmove(buffer.data(), buffer.data() + consumed, buffered - consumed);
+                buffered -= consumed;
+            }
+            if (buffer.size() - buffered < POSE_INGEST_READ_CHUNK)
+                buffer.resize(buffer.size() * 2);
+            long got = listener.read(buffer.data() + buffered, POSE_INGEST_READ_CHUNK, POSE_INGEST_WAIT_MS);
+            if (got < 0)
+                return;
+            buffered += got;
+            bytes_read.fetch_add(got, std::memory_order_relaxed);
+        }
+    }
+
+    void serve_binary() {
+        uint32_t slot_count = 0;
+        if (!take(&slot_count, 4))
+            return;
+        if (slot_count > POSE_INGEST_MAX_SLOTS) {
+            std::cout << "ERROR: BAD POSE INGEST HEADER, " << slot_count << " SLOTS" << std::endl;
+            return;
+        }
+        std::vector<char> name_table(slot_count * POSE_STREAM_NAME_SIZE);
+        if (!take(name_table.data(), name_table.size()))
+            return;
+        remap.resize(slot_count);
+        bool in_order = slot_count == slot_names().size();
+        for (uint32_t i = 0; i < slot_count; i++) {
+            const char* name = name_table.data() + i * POSE_STREAM_NAME_SIZE;
+            remap[i] = find_slot(name, strnlen(name, POSE_STREAM_NAME_SIZE));
+            in_order = in_order && remap[i] == (int) i;
+        }
+
+        uint32_t position_count = 0;
+        if (!take(&position_count, 4))
+            return;
+        if (position_count > POSE_INGEST_MAX_POSITIONS) {
+            std::cout << "ERROR: BAD POSE INGEST HEADER, " << position_count << " POSITIONS" << std::endl;
+            return;
+        }
+        std::vector<float> xyz(position_count * 3);
+        if (!take(xyz.data(), xyz.size() * sizeof(float)))
+            return;
+        publish_base_positions(xyz.data(), position_count);
+
+        size_t rotation_bytes = slot_count * POSE_STREAM_FLOATS_PER_ROTATION * sizeof(float);
+        staging.resize(slot_count * POSE_STREAM_FLOATS_PER_ROTATION);
+        while (!stopping.load()) {
+            uint32_t length = 0;
+            uint64_t sequence = 0;
+            if (!take(&length, 4))
+                return;
+            if (length != 8 + rotation_bytes) {
+                std::cout << "ERROR: BAD POSE INGEST FRAME LENGTH " << length << std::endl;
+                return;
+            }
+            if (!take(&sequence, 8))
+                return;
+
+            // decoded straight into the slot the render loop retargets from
+            float* slot = wait_for_slot();
+            if (slot == NULL)
+                return;
+            if (in_order) {
+                if (!take(slot, rotation_bytes))
+                    return;
+            } else {
+                if (!take(staging.data(), rotation_bytes))
+                    return;
+                PROFILE_STAGE(STAGE_PARSE);
+                fill_identity(slot);
+                for (uint32_t i = 0; i < slot_count; i++) {
+                    if (remap[i] >= 0)
+                        std::memcpy(slot + remap[i] * POSE_STREAM_FLOATS_PER_ROTATION,
+                            staging.data() + i * POSE_STREAM_FLOATS_PER_ROTATION,
+                            POSE_STREAM_FLOATS_PER_ROTATION * sizeof(float));
+                }
+            }
+            publish_slot(sequence);
+        }
+    }
+
+    void run() override {
+        if (!listener.open(endpoint)) {
+            std::cout << "ERROR: FAILED TO OPEN POSE INGEST ENDPOINT " << endpoint << std::endl;
+            return;
+        }
+        listening.store(true);
+        while (!stopping.load()) {
+            if (!listener.accept(POSE_INGEST_WAIT_MS))
+                continue;
+            connections.fetch_add(1, std::memory_order_relaxed);
+
+            // the first four bytes tell binary from text
+            restart_text();
+            decoded = buffered = 0;
+            char magic[4];
+            if (take(magic, 4)) {
+                if (std::memcmp(magic, POSE_INGEST_MAGIC, 4) == 0) {
+                    serve_binary();
+                } else {
+                    // text from the first byte on, put the four back in front
+                    size_t rest = buffered - decoded;
+                    std::memmove(buffer.data() + 4, buffer.data() + decoded, rest);
+                    std::memcpy(buffer.data(), magic, 4);
+                    decoded = 0;
+                    buffered = 4 + rest;
+                    serve_text();
+                }
+            }
+            listener.disconnect();
+        }
+        listening.store(false);
+        listener.close();
+    }
+};
+
+#endif
@@ -0,0 +1,206 @@
+#ifndef POSE_PIPELINE_HPP
+#define POSE_PIPELINE_HPP
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <filesystem>
+
+#include "skeleton_utils.h"
+#include "skeleton_loader_helper.hpp"
+#include "pose_stream.hpp"
+#include "retarget_plan.hpp"
+#include "pose_cache.hpp"
+#include "work_stealing_pool.hpp"
+
+/*
+ * Headless load -> retarget -> export for capture files. Nothing here includes glad or
+ * GLFW or needs a GL context, so it builds and runs on machines without a GPU
+ * (tools/pose_cli.cpp).
+ *
+ * Binary export (.ppos), little endian:
+ *
+ *   char     magic[4]       "PPOS"
+ *   uint32_t version
+ *   uint32_t frame_count
+ *   uint32_t position_count
+ *   float    positions[frame_count][position_count][3]
+ */
+
+const char POSE_EXPORT_MAGIC[4] = {'P', 'P', 'O', 'S'};
+const uint32_t POSE_EXPORT_VERSION = 1;
+
+enum pose_export_format {
+    // one "[[x, y, z], ...]" line per frame, the vamp_dump.txt format split_blaze_keypoints reads
+    POSE_EXPORT_TEXT,
+    POSE_EXPORT_BINARY
+};
+
+/**
+ * @brief writes the vampire's positions as one line into a file, the input
+ * create_local_dancing_vampire_model captures are built from
+ *
+ * @param vamp
+ * @param filename
+ */
+void dump_vampire_into_file(const bodymodel& vamp, const std::string& filename = "vamp_dump.txt") {
+
+    std::ofstream vamp_dump_file (filename);
+    std::string vamp_line = "[";
+    for (int i = 0; i < vamp.positions.size(); i++) {
+        position pos = vamp.positions[i];
+        vamp_line += pos.toString();
+        if (i != vamp.positions.size() - 1)
+            vamp_line += ", ";
+    }
+    vamp_line += "]";
+    vamp_dump_file << vamp_line << std::endl;
+    vamp_dump_file.close();
+    std::cout << "POSITONS SIZE:";
+    std::cout << split_blaze_keypoints(vamp_line, false).size() << std::endl;
+    std::cout << "POSITIONS DUMP: " << std::endl;
+    std::cout << vamp_line << std::endl;
+}
+
+/**
+ * @brief writes every frame of a cache as a text line, same layout as dump_vampire_into_file
+ *
+ * @param cache
+ * @param path
+ * @return true on success
+ */
+bool export_positions_text(const pose_cache& cache, const std::string& path) {
+    std::ofstream out(path, std::ios::binary);
+    if (!out.is_open()) {
+        std::cout << "ERROR: FAILED TO OPEN FILE " << path << std::endl;
+        return false;
+    }
+
+    std::string line;
+    char number[48];
+    for (uint32_t f = 0; f < cache.frame_count; f++) {
+        const float* xyz = cache.frame(f);
+        line.clear();
+        line += "[";
+        for (uint32_t v = 0; v < cache.vertices_per_frame(); v++) {
+            // %f matches position::toString, which goes through std::to_string
+            snprintf(number, sizeof(number), "%s[%f, %f, %f]", v ? ", " : "", xyz[v*3], xyz[v*3 + 1], xyz[v*3 + 2]);
+            line += number;
+        }
+        line += "]\n";
+        out.write(line.data(), line.size());
+    }
+    return out.good();
+}
+
+/**
+ * @brief writes a cache as a .ppos file, see the layout at the top of this file
+ *
+ * @param cache
+ * @param path
+ * @return true on success
+ */
+bool export_positions_binary(const pose_cache& cache, const std::string& path) {
+    std::ofstream out(path, std::ios::binary);
+    if (!out.is_open()) {
+        std::cout << "ERROR: FAILED TO OPEN FILE " << path << std::endl;
+        return false;
+    }
+
+    uint32_t header[3] = {POSE_EXPORT_VERSION, cache.frame_count, cache.vertices_per_frame()};
+    out.write(POSE_EXPORT_MAGIC, sizeof(POSE_EXPORT_MAGIC));
+    out.write((const char*) header, sizeof(header));
+    out.write((const char*) cache.data.data(), cache.data.size() * sizeof(float));
+    return out.good();
+}
+
+struct pose_job_result {
+    std::string capture;
+    std::string output;
+    bool ok = false;
+    uint32_t frames = 0;
+    // text -> stream conversion (when needed) and mapping
+    double load_ms = 0;
+    // plan compile and batch retarget
+    double retarget_ms = 0;
+    double export_ms = 0;
+
+    double total_ms() const { return load_ms + retarget_ms + export_ms; }
+};
+
+/**
+ * @brief runs one capture through the whole pipeline. Text captures are converted to a
+ * .pstream in output_dir first and that stream is reused while it is newer than the capture,
+ * .pstream and .parc inputs are mapped directly, archives decode block by block.
+ *
+ * @param capture_path text capture, .pstream or .parc
+ * @param output_dir receives <name>.pstream and <name>_positions.txt / .ppos
+ * @param format
+ * @param pool retarget workers
+ * @return pose_job_result
+ */
+pose_job_result process_capture(
+    const std::string& capture_path,
+    const std::string& output_dir,
+    pose_export_format format,
+    work_stealing_pool& pool)
+{
+    namespace fs = std::filesystem;
+    pose_job_result result;
+    result.capture = capture_path;
+
+    fs::path capture(capture_path);
+    fs::path out_dir(output_dir);
+    std::error_code error;
+    fs::create_directories(out_dir, error);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    std::string stream_path = capture_path;
+    bool archived = capture.extension() == POSE_ARCHIVE_EXTENSION;
+    if (!archived && capture.extension() != POSE_STREAM_EXTENSION) {
+        fs::path converted = out_dir / (capture.stem().string() + POSE_STREAM_EXTENSION);
+        if (pose_file_is_stale(capture_path, converted.string()) && !convert_pose_text_file_to_stream(capture_path, converted.string(), false)) {
+            std::cout << "ERROR: FAILED TO CONVERT " << capture_path << " TO POSE STREAM" << std::endl;
+            return result;
+        }
+        stream_path = converted.string();
+    }
+
+    pose_stream stream;
+    pose_archive archive;
+    if (archived ? !archive.open(stream_path) || archive.frame_count() == 0
+                 : !stream.open(stream_path) || stream.frame_count() == 0)
+        return result;
+    bodymodel base_model = create_local_dancing_vampire_model();
+    base_model.set_positions(archived ? archive.base_positions() : stream.base_positions());
+    auto loaded = std::chrono::high_resolution_clock::now();
+
+    retarget_plan plan = compile_retarget_plan(create_adjusted_blaze_model(), base_model,
+        archived ? archive.bone_names() : stream.bone_names());
+    std::vector<int> index_order(base_model.positions.size());
+    for (size_t i = 0; i < index_order.size(); i++)
+        index_order[i] = i;
+    pose_cache cache = archived
+        ? build_position_cache(plan, archive, base_model.positions, index_order, pool)
+        : build_position_cache(plan, stream, base_model.positions, index_order, pool);
+    auto retargeted = std::chrono::high_resolution_clock::now();
+
+    std::string suffix = format == POSE_EXPORT_BINARY ? ".ppos" : "_positions.txt";
+    result.output = (out_dir / (capture.stem().string() + suffix)).string();
+    result.ok = format == POSE_EXPORT_BINARY
+        ? export_positions_binary(cache, result.output)
+        : export_positions_text(cache, result.output);
+    auto exported = std::chrono::high_resolution_clock::now();
+
+    result.frames = cache.frame_count;
+    result.load_ms = std::chrono::duration<double, std::milli>(loaded - start).count();
+    result.retarget_ms = std::chrono::duration<double, std::milli>(retargeted - loaded).count();
+    result.export_ms = std::chrono::duration<double, std::milli>(exported - retargeted).count();
+    return result;
+}
+
+#endif
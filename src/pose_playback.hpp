@@ -0,0 +1,463 @@
+#ifndef POSE_PLAYBACK_HPP
+#define POSE_PLAYBACK_HPP
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+#include "pose_stream.hpp"
+#include "retarget_plan.hpp"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define POSE_PLAYBACK_AVX2 1
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define POSE_PLAYBACK_SSE2 1
+#endif
+
+// slots per kernel step, tracks are padded to a multiple of it
+const uint32_t POSE_PLAYBACK_LANES = 8;
+
+// M_PI is a POSIX extension, strict -std=c++17 and MSVC do not define it
+constexpr double POSE_PLAYBACK_PI = 3.14159265358979323846;
+
+enum pose_interpolation {
+    // the frame the clock is in, no blending (the pre-retargeted clip cache can be used)
+    POSE_INTERPOLATE_NONE,
+    // normalized lerp, exact at the keys, speeds up a little mid interval
+    POSE_INTERPOLATE_NLERP,
+    // nlerp with the interpolation parameter corrected towards slerp's constant angular
+    // speed by a polynomial in the keys' cosine, no trig per slot
+    POSE_INTERPOLATE_FAST_SLERP
+};
+
+enum pose_simd_kernel {
+    POSE_SIMD_SCALAR,
+    POSE_SIMD_SSE2,
+    POSE_SIMD_AVX2
+};
+
+const char* const POSE_SIMD_KERNEL_NAMES[] = {"scalar", "sse2", "avx2"};
+
+/**
+ * @brief widest kernel this build was compiled with, -mavx2 (/arch:AVX2) enables AVX2
+ */
+inline pose_simd_kernel pose_simd_best_kernel() {
+#if defined(POSE_PLAYBACK_AVX2)
+    return POSE_SIMD_AVX2;
+#elif defined(POSE_PLAYBACK_SSE2)
+    return POSE_SIMD_SSE2;
+#else
+    return POSE_SIMD_SCALAR;
+#endif
+}
+
+/**
+ * Maps wall time to a fractional frame index of a looping capture, so playback speed is
+ * the capture's rate whatever the render rate. Frame i is shown at i / frames_per_second.
+ */
+struct pose_playback_clock {
+    double frames_per_second = 30.0;
+    uint32_t frame_count = 0;
+    // seconds into the clip, always in [0, duration)
+    double time = 0;
+    bool paused = false;
+
+    pose_playback_clock() {}
+    pose_playback_clock(uint32_t frame_count, double frames_per_second)
+        : frames_per_second(frames_per_second), frame_count(frame_count) {}
+
+    double duration() const { return frame_count / frames_per_second; }
+
+    void advance(double seconds) {
+        if (!paused)
+            seek(time + seconds);
+    }
+
+    // moves by whole capture frames, e.g. stepping while paused
+    void step(int frames) {
+        seek(time + frames / frames_per_second);
+    }
+
+    void seek(double seconds) {
+        double length = duration();
+        if (length <= 0) {
+            time = 0;
+            return;
+        }
+        time = std::fmod(seconds, length);
+        if (time < 0)
+            time += length;
+    }
+
+    // in [0, frame_count), the integer part is the frame shown, the rest the blend to the next
+    double frame_position() const {
+        double position = time * frames_per_second;
+        return position < frame_count ? position : 0.0;
+    }
+
+    uint32_t frame() const { return (uint32_t) frame_position(); }
+};
+
+/**
+ * @brief a rotation matrix (row major 3x3, as in a pose stream) as a unit quaternion
+ *
+ * @param m 9 floats
+ * @param q x, y, z, w
+ */
+void quaternion_from_rotation(const float* m, float* q) {
+    // Shepperd: the largest of the four diagonal combinations keeps the division stable
+    float trace = m[0] + m[4] + m[8];
+    float x, y, z, w;
+    if (trace > 0) {
+        float s = std::sqrt(trace + 1.0f) * 2.0f;
+        w = 0.25f * s;
+        x = (m[7] - m[5]) / s;
+        y = (m[2] - m[6]) / s;
+        z = (m[3] - m[1]) / s;
+    } else if (m[0] > m[4] && m[0] > m[8]) {
+        float s = std::sqrt(1.0f + m[0] - m[4] - m[8]) * 2.0f;
+        w = (m[7] - m[5]) / s;
+        x = 0.25f * s;
+        y = (m[1] + m[3]) / s;
+        z = (m[2] + m[6]) / s;
+    } else if (m[4] > m[8]) {
+        float s = std::sqrt(1.0f + m[4] - m[0] - m[8]) * 2.0f;
+        w = (m[2] - m[6]) / s;
+        x = (m[1] + m[3]) / s;
+        y = 0.25f * s;
+        z = (m[5] + m[7]) / s;
+    } else {
+        float s = std::sqrt(1.0f + m[8] - m[0] - m[4]) * 2.0f;
+        w = (m[3] - m[1]) / s;
+        x = (m[2] + m[6]) / s;
+        y = (m[5] + m[7]) / s;
+        z = 0.25f * s;
+    }
+    float length = std::sqrt(x * x + y * y + z * z + w * w);
+    q[0] = x / length;
+    q[1] = y / length;
+    q[2] = z / length;
+    q[3] = w / length;
+}
+
+/**
+ * @brief the row major 3x3 rotation of a unit quaternion
+ *
+ * @param q x, y, z, w
+ * @param m 9 floats
+ */
+void rotation_from_quaternion(const float* q, float* m) {
+    float x = q[0], y = q[1], z = q[2], w = q[3];
+    m[0] = 1 - 2 * (y * y + z * z);
+    m[1] = 2 * (x * y - z * w);
+    m[2] = 2 * (x * z + y * w);
+    m[3] = 2 * (x * y + z * w);
+    m[4] = 1 - 2 * (x * x + z * z);
+    m[5] = 2 * (y * z - x * w);
+    m[6] = 2 * (x * z - y * w);
+    m[7] = 2 * (y * z + x * w);
+    m[8] = 1 - 2 * (x * x + y * y);
+}
+
+// angle in degrees between two unit quaternions, either sign
+inline double quaternion_angle_degrees(const float* a, const float* b) {
+    double dot = std::fabs((double) a[0] * b[0] + (double) a[1] * b[1] + (double) a[2] * b[2] + (double) a[3] * b[3]);
+    return 2.0 * std::acos(std::min(1.0, dot)) * 180.0 / POSE_PLAYBACK_PI;
+}
+
+/**
+ * Every frame of a pose stream as quaternions, laid out for the kernels: per frame four
+ * arrays (x, y, z, w) of padded_slots floats each. Padding slots hold the identity. Each
+ * slot's sign is flipped where needed so consecutive frames sit in the same hemisphere.
+ */
+struct pose_quaternion_track {
+    uint32_t frame_count = 0;
+    uint32_t slot_count = 0;
+    uint32_t padded_slots = 0;
+    std::vector<float> data;
+
+    pose_quaternion_track() {}
+
+    explicit pose_quaternion_track(const pose_stream& stream) {
+        frame_count = stream.frame_count();
+        slot_count = stream.bone_count();
+        padded_slots = (slot_count + POSE_PLAYBACK_LANES - 1) / POSE_PLAYBACK_LANES * POSE_PLAYBACK_LANES;
+        data.assign((size_t) frame_count * frame_stride(), 0.0f);
+
+        for (uint32_t f = 0; f < frame_count; f++) {
+            float* x = frame(f);
+            const float* previous = f > 0 ? frame(f - 1) : nullptr;
+            for (uint32_t s = 0; s < padded_slots; s++) {
+                float q[4] = {0, 0, 0, 1};
+                if (s < slot_count)
+                    quaternion_from_rotation(stream.frame_data(f) + s * POSE_STREAM_FLOATS_PER_ROTATION, q);
+                if (previous) {
+                    float dot = q[0] * previous[s] + q[1] * previous[padded_slots + s] +
+                        q[2] * previous[2 * padded_slots + s] + q[3] * previous[3 * padded_slots + s];
+                    if (dot < 0)
+                        q[0] = -q[0], q[1] = -q[1], q[2] = -q[2], q[3] = -q[3];
+                }
+                for (int c = 0; c < 4; c++)
+                    x[c * padded_slots + s] = q[c];
+            }
+        }
+    }
+
+    size_t frame_stride() const { return (size_t) padded_slots * 4; }
+    float* frame(uint32_t index) { return data.data() + index * frame_stride(); }
+    const float* frame(uint32_t index) const { return data.data() + index * frame_stride(); }
+
+    // floats interpolate_pose_rotations writes, the layout retarget_frame_into reads
+    size_t rotation_floats() const { return (size_t) slot_count * POSE_STREAM_FLOATS_PER_ROTATION; }
+};
+
+// scratch of the kernels, nine padded arrays of matrix elements
+struct pose_interpolation_scratch {
+    std::vector<float> matrices;
+};
+
+// the blend weight of the second key, see POSE_INTERPOLATE_FAST_SLERP
+inline float fast_slerp_parameter(float alpha, float cosine) {
+    float d = std::fabs(cosine);
+    float k = 0.931872f + d * (-1.25654f + d * 0.331442f);
+    return alpha + alpha * (alpha - 0.5f) * (alpha - 1.0f) * k;
+}
+
+void interpolate_quaternions_scalar(const float* q0, const float* q1, float alpha, bool fast_slerp,
+    uint32_t begin, uint32_t end, uint32_t stride, float* out)
+{
+    for (uint32_t s = begin; s < end; s++) {
+        float a[4], b[4];
+        for (int c = 0; c < 4; c++) {
+            a[c] = q0[c * stride + s];
+            b[c] = q1[c * stride + s];
+        }
+        float dot = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+        float t = fast_slerp ? fast_slerp_parameter(alpha, dot) : alpha;
+        // shortest arc, the track is already continuous except across the loop
+        float t1 = dot < 0 ? -t : t;
+        float t0 = 1.0f - t;
+        float q[4];
+        for (int c = 0; c < 4; c++)
+            q[c] = a[c] * t0 + b[c] * t1;
+        float inverse_length = 1.0f / std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+        for (int c = 0; c < 4; c++)
+            q[c] *= inverse_length;
+
+        float m[9];
+        rotation_from_quaternion(q, m);
+        for (int e = 0; e < 9; e++)
+            out[e * stride + s] = m[e];
+    }
+}
+
+#if defined(POSE_PLAYBACK_SSE2)
+void interpolate_quaternions_sse2(const float* q0, const float* q1, float alpha, bool fast_slerp,
+    uint32_t stride, float* out)
+{
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 two = _mm_set1_ps(2.0f);
+    const __m128 sign_bit = _mm_set1_ps(-0.0f);
+    const __m128 alpha4 = _mm_set1_ps(alpha);
+    for (uint32_t s = 0; s < stride; s += 4) {
+        __m128 ax = _mm_loadu_ps(q0 + s), ay = _mm_loadu_ps(q0 + stride + s);
+        __m128 az = _mm_loadu_ps(q0 + 2 * stride + s), aw = _mm_loadu_ps(q0 + 3 * stride + s);
+        __m128 bx = _mm_loadu_ps(q1 + s), by = _mm_loadu_ps(q1 + stride + s);
+        __m128 bz = _mm_loadu_ps(q1 + 2 * stride + s), bw = _mm_loadu_ps(q1 + 3 * stride + s);
+
+        __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)),
+            _mm_add_ps(_mm_mul_ps(az, bz), _mm_mul_ps(aw, bw)));
+        __m128 t = alpha4;
+        if (fast_slerp) {
+            __m128 d = _mm_andnot_ps(sign_bit, dot);
+            __m128 k = _mm_add_ps(_mm_set1_ps(0.931872f), _mm_mul_ps(d,
+                _mm_add_ps(_mm_set1_ps(-1.25654f), _mm_mul_ps(d, _mm_set1_ps(0.331442f)))));
+            __m128 bend = _mm_mul_ps(_mm_mul_ps(alpha4, _mm_sub_ps(alpha4, _mm_set1_ps(0.5f))),
+                _mm_mul_ps(_mm_sub_ps(alpha4, one), k));
+            t = _mm_add_ps(alpha4, bend);
+        }
+        __m128 t0 = _mm_sub_ps(one, t);
+        // the sign of dot moves onto the second weight
+        __m128 t1 = _mm_xor_ps(t, _mm_and_ps(dot, sign_bit));
+
+        __m128 x = _mm_add_ps(_mm_mul_ps(ax, t0), _mm_mul_ps(bx, t1));
+        __m128 y = _mm_add_ps(_mm_mul_ps(ay, t0), _mm_mul_ps(by, t1));
+        __m128 z = _mm_add_ps(_mm_mul_ps(az, t0), _mm_mul_ps(bz, t1));
+        __m128 w = _mm_add_ps(_mm_mul_ps(aw, t0), _mm_mul_ps(bw, t1));
+        __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)),
+            _mm_add_ps(_mm_mul_ps(z, z), _mm_mul_ps(w, w))));
+        __m128 inverse_length = _mm_div_ps(one, length);
+        x = _mm_mul_ps(x, inverse_length);
+        y = _mm_mul_ps(y, inverse_length);
+        z = _mm_mul_ps(z, inverse_length);
+        w = _mm_mul_ps(w, inverse_length);
+
+        __m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+        __m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+        __m128 xw = _mm_mul_ps(x, w), yw = _mm_mul_ps(y, w), zw = _mm_mul_ps(z, w);
+        _mm_storeu_ps(out + s, _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))));
+        _mm_storeu_ps(out + stride + s, _mm_mul_ps(two, _mm_sub_ps(xy, zw)));
+        _mm_storeu_ps(out + 2 * stride + s, _mm_mul_ps(two, _mm_add_ps(xz, yw)));
+        _mm_storeu_ps(out + 3 * stride + s, _mm_mul_ps(two, _mm_add_ps(xy, zw)));
+        _mm_storeu_ps(out + 4 * stride + s, _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))));
+        _mm_storeu_ps(out + 5 * stride + s, _mm_mul_ps(two, _mm_sub_ps(yz, xw)));
+        _mm_storeu_ps(out + 6 * stride + s, _mm_mul_ps(two, _mm_sub_ps(xz, yw)));
+        _mm_storeu_ps(out + 7 * stride + s, _mm_mul_ps(two, _mm_add_ps(yz, xw)));
+        _mm_storeu_ps(out + 8 * stride + s, _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))));
+    }
+}
+#endif
+
+#if defined(POSE_PLAYBACK_AVX2)
+void interpolate_quaternions_avx2(const float* q0, const float* q1, float alpha, bool fast_slerp,
+    uint32_t stride, float* out)
+{
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 two = _mm256_set1_ps(2.0f);
+    const __m256 sign_bit = _mm256_set1_ps(-0.0f);
+    const __m256 alpha8 = _mm256_set1_ps(alpha);
+    for (uint32_t s = 0; s < stride; s += 8) {
+        __m256 ax = _mm256_loadu_ps(q0 + s), ay = _mm256_loadu_ps(q0 + stride + s);
+        __m256 az = _mm256_loadu_ps(q0 + 2 * stride + s), aw = _mm256_loadu_ps(q0 + 3 * stride + s);
+        __m256 bx = _mm256_loadu_ps(q1 + s), by = _mm256_loadu_ps(q1 + stride + s);
+        __m256 bz = _mm256_loadu_ps(q1 + 2 * stride + s), bw = _mm256_loadu_ps(q1 + 3 * stride + s);
+
+        __m256 dot = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ax, bx), _mm256_mul_ps(ay, by)),
+            _mm256_add_ps(_mm256_mul_ps(az, bz), _mm256_mul_ps(aw, bw)));
+        __m256 t = alpha8;
+        if (fast_slerp) {
+            __m256 d = _mm256_andnot_ps(sign_bit, dot);
+            __m256 k = _mm256_add_ps(_mm256_set1_ps(0.931872f), _mm256_mul_ps(d,
+                _mm256_add_ps(_mm256_set1_ps(-1.25654f), _mm256_mul_ps(d, _mm256_set1_ps(0.331442f)))));
+            __m256 bend = _mm256_mul_ps(_mm256_mul_ps(alpha8, _mm256_sub_ps(alpha8, _mm256_set1_ps(0.5f))),
+                _mm256_mul_ps(_mm256_sub_ps(alpha8, one), k));
+            t = _mm256_add_ps(alpha8, bend);
+        }
+        __m256 t0 = _mm256_sub_ps(one, t);
+        __m256 t1 = _mm256_xor_ps(t, _mm256_and_ps(dot, sign_bit));
+
+        __m256 x = _mm256_add_ps(_mm256_mul_ps(ax, t0), _mm256_mul_ps(bx, t1));
+        __m256 y = _mm256_add_ps(_mm256_mul_ps(ay, t0), _mm256_mul_ps(by, t1));
+        __m256 z = _mm256_add_ps(_mm256_mul_ps(az, t0), _mm256_mul_ps(bz, t1));
+        __m256 w = _mm256_add_ps(_mm256_mul_ps(aw, t0), _mm256_mul_ps(bw, t1));
+        __m256 length = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y)),
+            _mm256_add_ps(_mm256_mul_ps(z, z), _mm256_mul_ps(w, w))));
+        __m256 inverse_length = _mm256_div_ps(one, length);
+        x = _mm256_mul_ps(x, inverse_length);
+        y = _mm256_mul_ps(y, inverse_length);
+        z = _mm256_mul_ps(z, inverse_length);
+        w = _mm256_mul_ps(w, inverse_length);
+
+        __m256 xx = _mm256_mul_ps(x, x), yy = _mm256_mul_ps(y, y), zz = _mm256_mul_ps(z, z);
+        __m256 xy = _mm256_mul_ps(x, y), xz = _mm256_mul_ps(x, z), yz = _mm256_mul_ps(y, z);
+        __m256 xw = _mm256_mul_ps(x, w), yw = _mm256_mul_ps(y, w), zw = _mm256_mul_ps(z, w);
+        _mm256_storeu_ps(out + s, _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(yy, zz))));
+        _mm256_storeu_ps(out + stride + s, _mm256_mul_ps(two, _mm256_sub_ps(xy, zw)));
+        _mm256_storeu_ps(out + 2 * stride + s, _mm256_mul_ps(two, _mm256_add_ps(xz, yw)));
+        _mm256_storeu_ps(out + 3 * stride + s, _mm256_mul_ps(two, _mm256_add_ps(xy, zw)));
+        _mm256_storeu_ps(out + 4 * stride + s, _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, zz))));
+        _mm256_storeu_ps(out + 5 * stride + s, _mm256_mul_ps(two, _mm256_sub_ps(yz, xw)));
+        _mm256_storeu_ps(out + 6 * stride + s, _mm256_mul_ps(two, _mm256_sub_ps(xz, yw)));
+        _mm256_storeu_ps(out + 7 * stride + s, _mm256_mul_ps(two, _mm256_add_ps(yz, xw)));
+        _mm256_storeu_ps(out + 8 * stride + s, _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, yy))));
+    }
+}
+#endif
+
+/**
+ * @brief blends every slot's rotation between the two capture frames around
+ * frame_position and writes them as 3x3 matrices in the pose stream slot layout, the
+ * last frame blends into the first. POSE_INTERPOLATE_NONE takes frame_position's frame
+ * unblended, still rebuilt from the track's quaternions, so it matches the capture's matrices
+ * to float rounding rather than bit for bit.
+ *
+ * @param track
+ * @param frame_position e.g. pose_playback_clock::frame_position()
+ * @param mode
+ * @param scratch reused between calls
+ * @param out track.rotation_floats() floats, read by retarget_frame_into
+ * @param kernel falls back to the widest one compiled in
+ */
+void interpolate_pose_rotations(
+    const pose_quaternion_track& track,
+    double frame_position,
+    pose_interpolation mode,
+    pose_interpolation_scratch& scratch,
+    float* out,
+    pose_simd_kernel kernel = pose_simd_best_kernel())
+{
+    if (track.frame_count == 0)
+        return;
+    if (kernel > pose_simd_best_kernel())
+        kernel = pose_simd_best_kernel();
+
+    uint32_t first = (uint32_t) frame_position % track.frame_count;
+    uint32_t second = (first + 1) % track.frame_count;
+    float alpha = mode == POSE_INTERPOLATE_NONE ? 0.0f : (float) (frame_position - std::floor(frame_position));
+    const float* q0 = track.frame(first);
+    const float* q1 = track.frame(second);
+    bool fast_slerp = mode == POSE_INTERPOLATE_FAST_SLERP;
+    uint32_t stride = track.padded_slots;
+
+    scratch.matrices.resize((size_t) stride * POSE_STREAM_FLOATS_PER_ROTATION);
+    float* matrices = scratch.matrices.data();
+    switch (kernel) {
+#if defined(POSE_PLAYBACK_AVX2)
+    case POSE_SIMD_AVX2:
+        interpolate_quaternions_avx2(q0, q1, alpha, fast_slerp, stride, matrices);
+        break;
+#endif
+#if defined(POSE_PLAYBACK_SSE2)
+    case POSE_SIMD_SSE2:
+        interpolate_quaternions_sse2(q0, q1, alpha, fast_slerp, stride, matrices);
+        break;
+#endif
+    default:
+        interpolate_quaternions_scalar(q0, q1, alpha, fast_slerp, 0, track.slot_count, stride, matrices);
+        break;
+    }
+
+    // element major to the 9 floats per slot of a pose stream frame
+    for (uint32_t s = 0; s < track.slot_count; s++)
+        for (uint32_t e = 0; e < POSE_STREAM_FLOATS_PER_ROTATION; e++)
+            out[s * POSE_STREAM_FLOATS_PER_ROTATION + e] = matrices[e * stride + s];
+}
+
+/**
+ * @brief one render frame of clip playback: blends the rotations at frame_position and
+ * retargets them straight into out in draw order
+ *
+ * @param plan compiled against the stream the track was built from
+ * @param track
+ * @param frame_position
+ * @param mode
+ * @param base_positions vampire rest positions
+ * @param draw_order
+ * @param rotations scratch, track.rotation_floats() floats
+ * @param scratch
+ * @param positions scratch positions
+ * @param out draw_order.size() * 3 floats, can be a mapped vertex buffer range
+ */
+void retarget_playback_frame_into(
+    const retarget_plan& plan,
+    const pose_quaternion_track& track,
+    double frame_position,
+    pose_interpolation mode,
+    const std::vector<position>& base_positions,
+    const std::vector<int>& draw_order,
+    std::vector<float>& rotations,
+    pose_interpolation_scratch& scratch,
+    std::vector<position>& positions,
+    float* out)
+{
+    rotations.resize(track.rotation_floats());
+    interpolate_pose_rotations(track, frame_position, mode, scratch, rotations.data());
+    retarget_frame_into(plan, rotations.data(), base_positions, draw_order, positions, out);
+}
+
+#endif
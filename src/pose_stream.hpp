@@ -0,0 +1,363 @@
+#ifndef POSE_STREAM_HPP
+#define POSE_STREAM_HPP
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <unordered_map>
+#include <filesystem>
+
+#include "mapped_file.hpp"
+
+#include "skeleton_utils.h"
+#include "skeleton_loader_helper.hpp"
+
+/*
+ * Binary pose stream (.pstream) layout, all values little endian:
+ *
+ *  pose_stream_header
+ *  name table      bone_count * POSE_STREAM_NAME_SIZE bytes, null padded
+ *  base positions  position_count * 3 floats
+ *  frames          frame_count * bone_count * 9 floats, row major 3x3 per slot
+ *
+ * every section starts on a 16 byte boundary so frames can be read straight out
+ * of the mapping as float arrays.
+ */
+
+const char POSE_STREAM_MAGIC[4] = {'P', 'S', 'T', 'M'};
+const uint32_t POSE_STREAM_VERSION = 1;
+const uint32_t POSE_STREAM_NAME_SIZE = 32;
+const uint32_t POSE_STREAM_FLOATS_PER_ROTATION = 9;
+const std::string POSE_STREAM_EXTENSION = ".pstream";
+
+struct pose_stream_header {
+    char magic[4];
+    uint32_t version;
+    // number of rotation slots in every frame
+    uint32_t bone_count;
+    uint32_t frame_count;
+    // base model positions stored ahead of the frames
+    uint32_t position_count;
+    uint32_t names_offset;
+    uint32_t positions_offset;
+    uint32_t frames_offset;
+};
+
+inline uint32_t pose_stream_align(uint32_t offset) {
+    return (offset + 15u) & ~15u;
+}
+
+/**
+ * @brief non owning view of one frame of a pose stream, points into the mapping
+ *
+ */
+struct pose_frame {
+    const float* rotations = nullptr;
+    uint32_t bone_count = 0;
+    // slot lookup owned by the stream
+    const std::unordered_map<std::string, uint32_t>* slots = nullptr;
+
+    const float* rotation(uint32_t slot) const {
+        return rotations + slot * POSE_STREAM_FLOATS_PER_ROTATION;
+    }
+
+    /**
+     * @brief finds the rotation slot of a bone name, returns -1 if the frame has no such bone
+     *
+     * @param name
+     * @return int
+     */
+    int slot_of(const std::string& name) const {
+        auto iter = slots->find(name);
+        if (iter == slots->end())
+            return -1;
+        return (int) iter->second;
+    }
+};
+
+/**
+ * @brief memory mapped reader over a .pstream file. Frames are handed out as views into
+ * the mapping, so reading a frame does no parsing and no allocation.
+ *
+ */
+class pose_stream {
+public:
+    pose_stream() {}
+
+    bool open(const std::string& path) {
+        if (!file.open(path)) {
+            std::cout << "ERROR: FAILED TO MAP POSE STREAM " << path << std::endl;
+            return false;
+        }
+        if (file.size() < sizeof(pose_stream_header)) {
+            std::cout << "ERROR: POSE STREAM TOO SMALL " << path << std::endl;
+            file.close();
+            return false;
+        }
+        std::memcpy(&header, file.bytes(), sizeof(pose_stream_header));
+        if (std::memcmp(header.magic, POSE_STREAM_MAGIC, 4) != 0 || header.version != POSE_STREAM_VERSION) {
+            std::cout << "ERROR: BAD POSE STREAM HEADER " << path << std::endl;
+            file.close();
+            return false;
+        }
+        size_t frames_end = (size_t) header.frames_offset +
+            (size_t) header.frame_count * frame_stride() * sizeof(float);
+        size_t positions_end = (size_t) header.positions_offset + header.position_count * 3 * sizeof(float);
+        size_t names_end = (size_t) header.names_offset + header.bone_count * POSE_STREAM_NAME_SIZE;
+        if (frames_end > file.size() || positions_end > file.size() || names_end > file.size()) {
+            std::cout << "ERROR: TRUNCATED POSE STREAM " << path << std::endl;
+            file.close();
+            return false;
+        }
+
+        names.clear();
+        slots.clear();
+        const char* name_table = reinterpret_cast<const char*>(file.bytes() + header.names_offset);
+        for (uint32_t i = 0; i < header.bone_count; i++) {
+            const char* entry = name_table + i * POSE_STREAM_NAME_SIZE;
+            names.push_back(std::string(entry, strnlen(entry, POSE_STREAM_NAME_SIZE)));
+            slots[names.back()] = i;
+        }
+        return true;
+    }
+
+    uint32_t frame_count() const { return header.frame_count; }
+    uint32_t bone_count() const { return header.bone_count; }
+    uint32_t frame_stride() const { return header.bone_count * POSE_STREAM_FLOATS_PER_ROTATION; }
+    const std::vector<std::string>& bone_names() const { return names; }
+    size_t size() const { return file.size(); }
+
+    const float* frame_data(uint32_t index) const {
+        return reinterpret_cast<const float*>(file.bytes() + header.frames_offset) +
+            (size_t) index * frame_stride();
+    }
+
+    pose_frame frame(uint32_t index) const {
+        pose_frame result;
+        result.rotations = frame_data(index);
+        result.bone_count = header.bone_count;
+        result.slots = &slots;
+        return result;
+    }
+
+    std::vector<position> base_positions() const {
+        const float* raw = reinterpret_cast<const float*>(file.bytes() + header.positions_offset);
+        std::vector<position> result;
+        result.reserve(header.position_count);
+        for (uint32_t i = 0; i < header.position_count; i++)
+            result.push_back(position(raw[i*3], raw[i*3 + 1], raw[i*3 + 2]));
+        return result;
+    }
+
+private:
+    mapped_file file;
+    pose_stream_header header = {};
+    std::vector<std::string> names;
+    std::unordered_map<std::string, uint32_t> slots;
+};
+
+/**
+ * @brief pose stream counterpart of apply_rotations_to_vamp_model, rotations are read
+ * straight out of the mapped frame. Blaze bones missing from the stream keep identity.
+ */
+std::tuple<bodymodel, std::unordered_map<std::string, position>> apply_rotations_to_vamp_model(
+    const pose_frame& frame,
+    const bodymodel& vamp,
+    const bodymodel& blaze
+) {
+    auto blaze_vamp_mapping = blaze_to_vampire_map();
+    const fk_solver& fk = vamp.skel->fk;
+    std::vector<matrix> joint_rotations(fk.size(), identity());
+    std::vector<bool> rotated(fk.size(), false);
+
+    for (const bone& base_bone : blaze.skel->base_bones) {
+        int slot = frame.slot_of(base_bone.name);
+        if (slot >= 0)
+            apply_rotation_to_mapped_vamp_bones(base_bone.name, matrix(frame.rotation(slot)),
+                vamp, blaze_vamp_mapping, joint_rotations, rotated);
+
+        for (const bone& local_bone : blaze.flow(base_bone)) {
+            slot = frame.slot_of(local_bone.name);
+            if (slot >= 0)
+                apply_rotation_to_mapped_vamp_bones(local_bone.name, matrix(frame.rotation(slot)),
+                    vamp, blaze_vamp_mapping, joint_rotations, rotated);
+        }
+    }
+
+    bodymodel new_vamp(vamp.skel);
+    fk.solve(vamp.positions, joint_rotations.data(), new_vamp.positions);
+    std::unordered_map<std::string, position> translations = vamp.downstream_translations(new_vamp.positions, rotated);
+    return {std::move(new_vamp), std::move(translations)};
+}
+
+/**
+ * @brief writes base positions and per frame rotations into a .pstream file.
+ * Slots follow the order of bone_names, bones missing from a frame are written as identity.
+ *
+ * @return true on success
+ */
+bool write_pose_stream(
+    const std::string& path,
+    const std::vector<std::string>& bone_names,
+    const std::vector<position>& base_positions,
+    std::vector<std::unordered_map<std::string, matrix>>& frames)
+{
+    for (const std::string& name : bone_names) {
+        if (name.size() >= POSE_STREAM_NAME_SIZE) {
+            std::cout << "ERROR: BONE NAME TOO LONG FOR POSE STREAM: " << name << std::endl;
+            return false;
+        }
+    }
+
+    pose_stream_header header = {};
+    std::memcpy(header.magic, POSE_STREAM_MAGIC, 4);
+    header.version = POSE_STREAM_VERSION;
+    header.bone_count = bone_names.size();
+    header.frame_count = frames.size();
+    header.position_count = base_positions.size();
+    header.names_offset = pose_stream_align(sizeof(pose_stream_header));
+    header.positions_offset = pose_stream_align(header.names_offset + header.bone_count * POSE_STREAM_NAME_SIZE);
+    header.frames_offset = pose_stream_align(header.positions_offset + header.position_count * 3 * sizeof(float));
+
+    size_t total_size = (size_t) header.frames_offset +
+        (size_t) header.frame_count * header.bone_count * POSE_STREAM_FLOATS_PER_ROTATION * sizeof(float);
+    std::vector<unsigned char> buffer(total_size, 0);
+    std::memcpy(buffer.data(), &header, sizeof(pose_stream_header));
+
+    for (uint32_t i = 0; i < header.bone_count; i++) {
+        std::memcpy(buffer.data() + header.names_offset + i * POSE_STREAM_NAME_SIZE,
+            bone_names[i].data(), bone_names[i].size());
+    }
+
+    float* positions = reinterpret_cast<float*>(buffer.data() + header.positions_offset);
+    for (uint32_t i = 0; i < header.position_count; i++) {
+        positions[i*3] = base_positions[i].x;
+        positions[i*3 + 1] = base_positions[i].y;
+        positions[i*3 + 2] = base_positions[i].z;
+    }
+
+    const float identity_rotation[POSE_STREAM_FLOATS_PER_ROTATION] = {1, 0, 0, 0, 1, 0, 0, 0, 1};
+    float* out = reinterpret_cast<float*>(buffer.data() + header.frames_offset);
+    for (auto& frame : frames) {
+        for (const std::string& name : bone_names) {
+            auto iter = frame.find(name);
+            if (iter == frame.end()) {
+                std::memcpy(out, identity_rotation, sizeof(identity_rotation));
+            } else {
+                for (int row = 0; row < 3; row++)
+                    for (int col = 0; col < 3; col++)
+                        out[row*3 + col] = iter->second.mat[row][col];
+            }
+            out += POSE_STREAM_FLOATS_PER_ROTATION;
+        }
+    }
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cout << "ERROR: FAILED TO OPEN FILE " << path << std::endl;
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+    return file.good();
+}
+
+/**
+ * @brief converts a text capture (base positions line followed by FRAME lines) into a
+ * binary pose stream. Slots are ordered by the adjusted blaze model's bone order,
+ * any extra names found in the capture are appended after.
+ *
+ * @param text_path path of the text capture
+ * @param stream_path output path of the .pstream file
+ * @param verbose forwarded to load_vamp_model_from_path
+ * @return true on success
+ */
+bool convert_pose_text_file_to_stream(const std::string& text_path, const std::string& stream_path, bool verbose = true) {
+    auto [model, frames] = load_vamp_model_from_path(text_path, verbose);
+    if (model.positions.size() == 0)
+        return false;
+
+    std::vector<std::string> bone_names;
+    bodymodel blaze = create_adjusted_blaze_model();
+    for (const bone& j : blaze.skel->bones)
+        bone_names.push_back(j.name);
+
+    std::vector<std::string> extra_names;
+    for (auto& frame : frames) {
+        for (auto& pair : frame) {
+            if (std::find(bone_names.begin(), bone_names.end(), pair.first) == bone_names.end() &&
+                std::find(extra_names.begin(), extra_names.end(), pair.first) == extra_names.end())
+                extra_names.push_back(pair.first);
+        }
+    }
+    std::sort(extra_names.begin(), extra_names.end());
+    bone_names.insert(bone_names.end(), extra_names.begin(), extra_names.end());
+
+    return write_pose_stream(stream_path, bone_names, model.positions, frames);
+}
+
+/**
+ * @brief converts a text capture in JOINT_FILEPATH into a binary pose stream
+ *
+ * @param text_filename file name inside JOINT_FILEPATH
+ * @param stream_path output path of the .pstream file
+ * @return true on success
+ */
+bool convert_pose_text_to_stream(const std::string& text_filename, const std::string& stream_path) {
+    return convert_pose_text_file_to_stream(JOINT_FILEPATH + text_filename, stream_path);
+}
+
+/**
+ * @brief binary counterpart of load_vamp_model_from_file. Maps JOINT_FILEPATH + filename
+ * and builds the vampire model from the stored base positions.
+ *
+ * @param filename .pstream file name inside JOINT_FILEPATH
+ * @param stream reader that keeps the mapping alive
+ * @return bodymodel
+ */
+bodymodel load_vamp_model_from_stream(const std::string& filename, pose_stream& stream) {
+    bodymodel model = create_local_dancing_vampire_model();
+    if (!stream.open(JOINT_FILEPATH + filename))
+        return model;
+    model.set_positions(stream.base_positions());
+    return model;
+}
+
+/**
+ * @brief whether derived_path has to be rebuilt from source_path: it is missing or the source
+ * was written after it. A missing source keeps whatever was derived from it.
+ *
+ * @param source_path
+ * @param derived_path
+ * @return bool
+ */
+bool pose_file_is_stale(const std::string& source_path, const std::string& derived_path) {
+    namespace fs = std::filesystem;
+    std::error_code error;
+    if (!fs::exists(derived_path, error))
+        return true;
+    if (!fs::exists(source_path, error))
+        return false;
+    return fs::last_write_time(source_path, error) > fs::last_write_time(derived_path, error);
+}
+
+/**
+ * @brief returns the .pstream name for a text capture, converting it on first use and
+ * again whenever the capture is re-recorded
+ *
+ * @param text_filename file name inside JOINT_FILEPATH
+ * @return std::string
+ */
+std::string ensure_pose_stream(const std::string& text_filename) {
+    std::string stream_filename = text_filename.substr(0, text_filename.find_last_of('.')) + POSE_STREAM_EXTENSION;
+    if (!pose_file_is_stale(JOINT_FILEPATH + text_filename, JOINT_FILEPATH + stream_filename))
+        return stream_filename;
+    if (!convert_pose_text_to_stream(text_filename, JOINT_FILEPATH + stream_filename))
+        std::cout << "ERROR: FAILED TO CONVERT " << text_filename << " TO POSE STREAM" << std::endl;
+    return stream_filename;
+}
+
+#endif
@@ -0,0 +1,183 @@
+#ifndef RETARGET_PLAN_HPP
+#define RETARGET_PLAN_HPP
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include "skeleton_utils.h"
+#include "dancingVampireUtils.hpp"
+#include "pose_stream.hpp"
+#include "StageProfiler.h"
+
+/**
+ * Flattened form of apply_rotations_to_vamp_model. Compiled once from the blaze model,
+ * the vampire model and blaze_to_vampire_map(), then applied every frame as a single
+ * forward kinematics pass over the vampire's tree bones (see fk_solver): each joint's
+ * rest vector is turned by the frame rotations mapped onto it and hung off its parent.
+ */
+struct retarget_plan {
+    // vampire tree bones in fk order, parents first
+    std::vector<int> joint_parent;
+    std::vector<int> joint_child;
+    // size joints + 1, range into joint_slots
+    std::vector<uint32_t> joint_slot_offsets;
+    // rotation index inside a frame, per joint in the order apply_rotations_to_vamp_model applies them
+    std::vector<uint32_t> joint_slots;
+
+    size_t joint_count() const { return joint_child.size(); }
+    // bone rotations applied per frame
+    size_t step_count() const { return joint_slots.size(); }
+};
+
+/**
+ * @brief compiles the per frame retarget work into flat index arrays
+ *
+ * @param blaze model providing the blaze bone order, positions unused
+ * @param vamp model the rotations are applied to
+ * @param slot_names rotation name of every slot in a frame, e.g. pose_stream::bone_names()
+ * @return retarget_plan
+ */
+retarget_plan compile_retarget_plan(const bodymodel& blaze, const bodymodel& vamp, const std::vector<std::string>& slot_names) {
+    auto blaze_vamp_mapping = blaze_to_vampire_map();
+    std::vector<std::vector<uint32_t>> joint_slots(vamp.skel->fk.size());
+
+    std::vector<bone> blaze_order;
+    for (const bone& base_bone : blaze.skel->base_bones) {
+        blaze_order.push_back(base_bone);
+        for (const bone& local_bone : blaze.flow(base_bone))
+            blaze_order.push_back(local_bone);
+    }
+
+    for (const bone& blaze_bone : blaze_order) {
+        auto name_iter = std::find(slot_names.begin(), slot_names.end(), blaze_bone.name);
+        // bones without a rotation are left untouched, same as the pose stream apply
+        if (name_iter == slot_names.end())
+            continue;
+
+        for (auto bone_tuple : blaze_vamp_mapping[blaze_bone.name]) {
+            std::vector<bone> vamp_bones = vamp.get_all_bone_between_parent_and_child(
+                std::get<0>(bone_tuple),
+                std::get<1>(bone_tuple)
+            );
+            for (const bone& vamp_bone : vamp_bones) {
+                int joint = vamp.skel->fk.joint_of(vamp_bone);
+                if (joint >= 0)
+                    joint_slots[joint].push_back(name_iter - slot_names.begin());
+            }
+        }
+    }
+
+    retarget_plan plan;
+    plan.joint_parent = vamp.skel->fk.joint_parent;
+    plan.joint_child = vamp.skel->fk.joint_child;
+    plan.joint_slot_offsets.push_back(0);
+    for (const std::vector<uint32_t>& slots : joint_slots) {
+        plan.joint_slots.insert(plan.joint_slots.end(), slots.begin(), slots.end());
+        plan.joint_slot_offsets.push_back(plan.joint_slots.size());
+    }
+    return plan;
+}
+
+/**
+ * @brief runs a compiled plan for one frame. out_positions is overwritten with
+ * base_positions and then rotated in place, once sized it is never reallocated.
+ *
+ * @param plan
+ * @param frame_rotations row major 3x3 rotations, 9 floats per slot
+ * @param base_positions vampire rest positions
+ * @param out_positions
+ */
+void apply_retarget_plan(
+    const retarget_plan& plan,
+    const float* frame_rotations,
+    const std::vector<position>& base_positions,
+    std::vector<position>& out_positions)
+{
+    PROFILE_STAGE(STAGE_RETARGET);
+    out_positions.assign(base_positions.begin(), base_positions.end());
+    position* positions = out_positions.data();
+    const position* rest = base_positions.data();
+
+    for (size_t joint = 0; joint < plan.joint_count(); joint++) {
+        int parent = plan.joint_parent[joint];
+        int child = plan.joint_child[joint];
+        position bone_vector = rest[child].subtract(rest[parent]);
+        for (uint32_t s = plan.joint_slot_offsets[joint]; s < plan.joint_slot_offsets[joint + 1]; s++) {
+            matrix current_rot(frame_rotations + plan.joint_slots[s] * POSE_STREAM_FLOATS_PER_ROTATION);
+            bone_vector = current_rot.dot(bone_vector);
+        }
+        positions[child] = bone_vector.add(positions[parent]);
+    }
+}
+
+void apply_retarget_plan(
+    const retarget_plan& plan,
+    const pose_frame& frame,
+    const std::vector<position>& base_positions,
+    std::vector<position>& out_positions)
+{
+    apply_retarget_plan(plan, frame.rotations, base_positions, out_positions);
+}
+
+/**
+ * @brief writes positions out as xyz floats following a draw order index list
+ *
+ * @param positions
+ * @param draw_order e.g. bodymodel::position_indices_in_order()
+ * @param out draw_order.size() * 3 floats
+ */
+void write_positions_in_order(const std::vector<position>& positions, const std::vector<int>& draw_order, float* out) {
+    PROFILE_STAGE(STAGE_FLATTEN);
+    for (size_t i = 0; i < draw_order.size(); i++) {
+        const position& p = positions[draw_order[i]];
+        out[i*3] = p.x;
+        out[i*3 + 1] = p.y;
+        out[i*3 + 2] = p.z;
+    }
+}
+
+/**
+ * @brief retargets one frame and writes it in draw order straight into out,
+ * which can be a mapped vertex buffer range
+ *
+ * @param scratch working positions, reused between calls
+ * @param out draw_order.size() * 3 floats
+ */
+void retarget_frame_into(
+    const retarget_plan& plan,
+    const float* frame_rotations,
+    const std::vector<position>& base_positions,
+    const std::vector<int>& draw_order,
+    std::vector<position>& scratch,
+    float* out)
+{
+    apply_retarget_plan(plan, frame_rotations, base_positions, scratch);
+    write_positions_in_order(scratch, draw_order, out);
+}
+
+/**
+ * @brief packs a name keyed rotation map into the slot layout a plan expects,
+ * for frames that come from matrices_from_line instead of a pose stream
+ *
+ * @param rotations
+ * @param slot_names
+ * @param out 9 floats per slot, missing names are written as identity
+ */
+void pack_rotations_into_slots(
+    const std::unordered_map<std::string, matrix>& rotations,
+    const std::vector<std::string>& slot_names,
+    std::vector<float>& out)
+{
+    out.resize(slot_names.size() * POSE_STREAM_FLOATS_PER_ROTATION);
+    for (size_t i = 0; i < slot_names.size(); i++) {
+        auto iter = rotations.find(slot_names[i]);
+        matrix rot = iter == rotations.end() ? identity() : iter->second;
+        for (int row = 0; row < 3; row++)
+            for (int col = 0; col < 3; col++)
+                out[i * POSE_STREAM_FLOATS_PER_ROTATION + row*3 + col] = rot.mat[row][col];
+    }
+}
+
+#endif
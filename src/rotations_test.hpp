@@ -104,5 +104,45 @@ void test_basic_rotations() {
 
 }
 
+/**
+ * @brief fk against rotating bone by bone: the 4 joint test model, then the blaze and
+ * vampire models posed by rotations built from a second set of positions
+ *
+ * @return largest coordinate difference seen
+ */
+float test_fk_matches_single_bone_rotations() {
+    auto largest_difference = [](const bodymodel& model, const std::unordered_map<std::string, matrix>& rotations) {
+        std::vector<position> solved = model.rotate_self_by_rotations(rotations, model).positions;
+        std::vector<position> reference = model.rotate_self_by_single_bones(rotations, model).positions;
+        float difference = 0;
+        for (size_t i = 0; i < solved.size(); i++) {
+            position delta = solved[i].subtract(reference[i]);
+            difference = std::max({difference, std::fabs(delta.x), std::fabs(delta.y), std::fabs(delta.z)});
+        }
+        return difference;
+    };
+
+    bodymodel test_model = construct_test_model();
+    bodymodel rotated_model = rotate_test_with_set_rotation_45(test_model);
+    float difference = largest_difference(test_model, rotated_model.construct_rotations(test_model));
+
+    // each model against itself moved a little, every bone gets a real rotation
+    for (bodymodel model : {create_adjusted_blaze_model(), create_local_dancing_vampire_model()}) {
+        std::vector<position> rest, moved;
+        for (size_t i = 0; i < 64; i++) {
+            float angle = 0.37f * i;
+            rest.push_back(position(0.2f * std::sin(angle), 0.1f * i, 0.2f * std::cos(angle)));
+            moved.push_back(rest.back().add(position(0.05f * std::cos(angle), 0, 0.05f * std::sin(1.7f * angle))));
+        }
+        model.set_positions(rest);
+        bodymodel posed = model;
+        posed.set_positions(moved);
+        difference = std::max(difference, largest_difference(model, posed.construct_rotations(model)));
+    }
+
+    std::cout << "fk vs single bone rotations, largest difference: " << difference << std::endl;
+    return difference;
+}
+
 
-#endif
\ No newline at end of file
+#endif
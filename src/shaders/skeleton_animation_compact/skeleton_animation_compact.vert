@@ -0,0 +1,52 @@
+#version 330 core
+
+// skeleton_animation for meshes uploaded with MESH_LAYOUT_COMPACT (CompactVertex.h)
+layout(location = 0) in vec3 pos;
+layout(location = 1) in vec2 octNorm;
+layout(location = 2) in vec2 tex;
+layout(location = 3) in vec2 octTangent;
+layout(location = 5) in ivec4 boneIds; 
+layout(location = 6) in vec4 weights;
+
+uniform mat4 projection;
+uniform mat4 view;
+uniform mat4 model;
+
+const int MAX_BONES = 100;
+const int MAX_BONE_INFLUENCE = 4;
+// unused influence, the -1 of the full layout
+const int NO_BONE = 255;
+// filled by a BonePaletteBuffer in one write per frame
+layout (std140) uniform BonePalette {
+    mat4 finalBonesMatrices[MAX_BONES];
+};
+
+out vec2 TexCoords;
+
+// same as OctDecode in CompactVertex.h
+vec3 octDecode(vec2 e) {
+    vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (v.z < 0.0)
+        v.xy = (1.0 - abs(e.yx)) * vec2(e.x >= 0.0 ? 1.0 : -1.0, e.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(v);
+}
+
+void main() {
+    vec3 norm = octDecode(octNorm);
+    vec4 totalPosition = vec4(0.0f);
+    for(int i = 0 ; i < MAX_BONE_INFLUENCE; i++) {
+        if(boneIds[i] == NO_BONE) 
+            continue;
+        if(boneIds[i] >= MAX_BONES) {
+            totalPosition = vec4(pos, 1.0f);
+            break;
+        }
+        vec4 localPosition = finalBonesMatrices[boneIds[i]] * vec4(pos,1.0f);
+        totalPosition += localPosition * weights[i];
+        vec3 localNormal = mat3(finalBonesMatrices[boneIds[i]]) * norm;
+   }
+	
+    mat4 viewModel = view * model;
+    gl_Position =  projection * viewModel * totalPosition;
+	TexCoords = tex;
+}
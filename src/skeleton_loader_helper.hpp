@@ -7,10 +7,10 @@
 #include <cmath>
 #include <chrono>
 #include <fstream>
-#include <regex>
 #include <sstream>
 
 #include "skeleton_utils.h"
+#include "StageProfiler.h"
 
 const std::string JOINT_FILEPATH = "./joints_output/";
 
@@ -76,69 +76,22 @@ std::string remove_invalid_char_in_floats(const std::string& input) {
 }
 
 
-std::unordered_map<std::string, matrix> matrices_from_line(std::string line) {
-    // skip past frame info
-    int colon_pos = nthOccurrence(line, ":", 1);
-    std::string preparsed_file = line.substr(colon_pos);
-
-    std::regex between_brackets("\\{([^\\}]*)\\}");
-    std::sregex_iterator iterator(preparsed_file.begin(), preparsed_file.end(), between_brackets);
-    std::sregex_iterator end;
-    std::vector<std::string> martices;    
-    while (iterator != end) {
-        std::smatch match = *iterator;
-        martices.push_back(match[1].str());
-        ++iterator;
-    }
-
-    // now you have the stored positions, get the names
-    std::vector<std::string> names;
-    std::regex between_space_and_colon("\\s([^\\s]+):");
-    iterator = std::sregex_iterator(preparsed_file.begin(), preparsed_file.end(), between_space_and_colon);
-    while (iterator != end) {
-        std::smatch match = *iterator;
-        names.push_back(match[1].str());
-        ++iterator;
-    }
-
-
-
-    std::regex between_square_paren("\\[([^\\]]*)\\]");
-    // for each matrix, split into rows, then split into cells
-    std::vector<matrix> real_matrices;
-    for (std::string mat : martices) {
-        std::sregex_iterator row_iter  = std::sregex_iterator(mat.begin(), mat.end(), between_square_paren);
-        std::vector<std::vector<float>> num_mat;
-        while (row_iter != end) {
-            std::smatch match = *row_iter;
-            std::string row = match[1].str();
-            std::stringstream floats(row);
-            std::vector<float> num_row;
-            float i;
-            while (floats >> i) {
-                num_row.push_back(i);
-                if (floats.peek() == ',') 
-                    floats.ignore();
-            }
-            num_mat.push_back(num_row);
-            ++row_iter;
-        }
-        matrix local_matrix(num_mat);
-        real_matrices.push_back(local_matrix);
-    }
-
-    // now construct final name - rotation matrix hashmap
+/**
+ * @brief name -> rotation for one FRAME line, "FRAME: n name: {[..],[..],[..]}, ..."
+ *
+ * @param line
+ * @return std::unordered_map<std::string, matrix>
+ */
+std::unordered_map<std::string, matrix> matrices_from_line(const std::string& line) {
+    PROFILE_STAGE(STAGE_PARSE);
     std::unordered_map<std::string, matrix> joint_matrix_map;
-    for (unsigned int i = 0; i < names.size(); i++) {
-        std::string name = names[i];
-        matrix matrix = real_matrices[i];
-        joint_matrix_map[name] = matrix;
-    }
-
+    for_each_matrix_in_line(line.data(), line.data() + line.size(),
+        [&](const char* name, size_t name_length, const float* rotation) {
+            joint_matrix_map[std::string(name, name_length)] = matrix(rotation);
+        });
     return joint_matrix_map;
 }
 
-
 std::tuple<bodymodel, std::vector<std::unordered_map<std::string, matrix>>> load_blaze_model_from_file(std::string filename) {
     std::ifstream file;
     std::string file_string;
@@ -152,9 +105,9 @@ std::tuple<bodymodel, std::vector<std::unordered_map<std::string, matrix>>> load
     std::vector<position> positions = split_blaze_keypoints(file_string, false);
     bodymodel model = create_adjusted_blaze_model();
 
-    for (bone j : model.base_bones) {
+    for (bone j : model.skel->base_bones) {
         std::cout << j.name << std::endl;
-        for (bone nj : model.bones_flow[j]) {
+        for (bone nj : model.flow(j)) {
             std::cout << nj.name << std::endl;
         }
         std::cout << "__________________" << std::endl;
@@ -173,13 +126,20 @@ std::tuple<bodymodel, std::vector<std::unordered_map<std::string, matrix>>> load
     return {model, matrix_hash_list};
 }
 
-
-std::tuple<bodymodel, std::vector<std::unordered_map<std::string, matrix>>> load_vamp_model_from_file(std::string filename) {
+/**
+ * @brief loads a vampire capture from any path: base positions on the first line,
+ * one rotation line per frame after it
+ *
+ * @param path
+ * @param verbose prints the bone flow and the loaded model, off for batch runs
+ * @return model and per frame rotations
+ */
+std::tuple<bodymodel, std::vector<std::unordered_map<std::string, matrix>>> load_vamp_model_from_path(const std::string& path, bool verbose = true) {
     std::ifstream file;
     std::string file_string;
-    file.open(JOINT_FILEPATH + filename);
+    file.open(path);
     if (!file.is_open()) {
-        std::cout << JOINT_FILEPATH + filename << std::endl;
+        std::cout << path << std::endl;
         std::cout << "ERROR: FAILED TO OPEN FILE" << std::endl;
     }
 
@@ -187,12 +147,14 @@ std::tuple<bodymodel, std::vector<std::unordered_map<std::string, matrix>>> load
     std::vector<position> positions = split_blaze_keypoints(file_string, false);
     bodymodel model = create_local_dancing_vampire_model();
 
-    for (bone j : model.base_bones) {
-        std::cout << j.name << std::endl;
-        for (bone nj : model.bones_flow[j]) {
-            std::cout << nj.name << std::endl;
+    if (verbose) {
+        for (bone j : model.skel->base_bones) {
+            std::cout << j.name << std::endl;
+            for (bone nj : model.flow(j)) {
+                std::cout << nj.name << std::endl;
+            }
+            std::cout << "__________________" << std::endl;
         }
-        std::cout << "__________________" << std::endl;
     }
 
     model.set_positions(positions);
@@ -201,15 +163,26 @@ std::tuple<bodymodel, std::vector<std::unordered_map<std::string, matrix>>> load
         matrix_hash_list.push_back(matrices_from_line(file_string));
     }
 
-    std::cout << model.toString() << std::endl;
+    if (verbose)
+        std::cout << model.toString() << std::endl;
 
     file.close();
     
     return {model, matrix_hash_list};
 }
 
+std::tuple<bodymodel, std::vector<std::unordered_map<std::string, matrix>>> load_vamp_model_from_file(std::string filename) {
+    return load_vamp_model_from_path(JOINT_FILEPATH + filename);
+}
 
 
+
+/**
+ * @brief reads "frame: n: x y z x y z ..." lines, y is flipped
+ *
+ * @param filename file name inside JOINT_FILEPATH
+ * @return one float list per line, lines without a second colon come back empty
+ */
 std::vector<std::vector<float>> load_joints_all_lines(std::string filename) {
     std::ifstream file;
     file.open(JOINT_FILEPATH + filename);
@@ -221,33 +194,19 @@ std::vector<std::vector<float>> load_joints_all_lines(std::string filename) {
     std::vector<std::vector<float>> all_positions;
 
     while (std::getline(file, file_string)) {
-        // now find location of second :
-        int colon_pos = nthOccurrence(file_string, ":", 2);
-        // removes frame #
-        std::string preparsed_file = file_string.substr(colon_pos);
-        // makes string a just numbers seperated by ,
-        std::string parsed_line = remove_invalid_chars(preparsed_file);
-        // parsed_line = remove_invalid_char_in_floats(parsed_line);
-        std::regex reg("\\s+");
-        std::sregex_token_iterator iter(parsed_line.begin(), parsed_line.end(), reg, -1);
-        std::sregex_token_iterator end;
-        std::vector<std::string> tokenized_pos(iter, end);
         std::vector<float> positions;
-        unsigned int index = 0;
-        for (std::string token : tokenized_pos) {
-            std::string parsed_token = remove_invalid_char_in_floats(token);
-            if (isFloat(parsed_token)) {
-                if (index % 3 == 1) {
-                    positions.push_back(std::stof(parsed_token)*-1);
-                } else
-                    positions.push_back(std::stof(parsed_token));
-                index++;
-            }
+        // now find location of second :, everything before it is frame info
+        int colon_pos = nthOccurrence(file_string, ":", 2);
+        if (colon_pos >= 0) {
+            const char* begin = file_string.data() + colon_pos + 1;
+            const char* end = file_string.data() + file_string.size();
+            positions.resize(max_floats_in(end - begin));
+            positions.resize(scan_floats(begin, end, positions.data(), positions.size()));
+            for (size_t i = 1; i < positions.size(); i += 3)
+                positions[i] *= -1;
         }
         all_positions.push_back(positions);
-
     }
-    // tokenized_pos.
     file.close();
 
     return all_positions;
@@ -8,14 +8,17 @@
 #include <deque>
 #include <cmath>
 #include <algorithm>
+#include <type_traits>
+#include <iterator>
+#include <memory>
 
-#include <glad/glad.h>
-#include <GLFW/glfw3.h>
+// only glm, the pose pipeline has to build without a window or GL context
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
 #include "dancingVampireUtils.hpp"
+#include "keypoint_parser.hpp"
 
 
 struct position {
@@ -44,28 +47,28 @@ struct position {
         z = iz;
     }
 
-    std::string toString () {
+    std::string toString () const {
         return "[" + std::to_string(x) + ", " + std::to_string(y) + ", " + std::to_string(z) + "]"; 
     }
 
-    position add (position p) {
+    position add (position p) const {
         return position (x + p.x, y + p.y, z + p.z);
     } 
 
-    position subtract (position p) {
+    position subtract (position p) const {
         return position (x - p.x, y - p.y, z - p.z);
     }
 
-    position scale (float f) {
+    position scale (float f) const {
         return position (x*f, y*f, z*f);
     }
 
-    float dot (position p) {
+    float dot (position p) const {
         return x*p.x + y*p.y + z*p.z;
     }
 
 
-    position cross (position p) {
+    position cross (position p) const {
         float cross_x = y*p.z - z*p.y;
         float cross_y = z*p.x - x*p.z;
         float cross_z = x*p.y - y*p.x;
@@ -73,11 +76,11 @@ struct position {
         return position (cross_x, cross_y, cross_z);
     }
 
-    float magnitude () {
+    float magnitude () const {
         return std::sqrt(x*x + y*y + z*z);
     }
 
-    position normalize() {
+    position normalize() const {
         float mag = magnitude();
         if (mag == 0) 
             return position(0,0,0);
@@ -87,34 +90,59 @@ struct position {
         );
     }
 
-    glm::vec4 to_vec4() {
-        float temp[4] = {
-            x, y, z, 1
-        };
-        return glm::make_vec4(temp);
+    glm::vec4 to_vec4() const {
+        return glm::vec4(x, y, z, 1);
     }
 
-    std::vector<float> to_vector() {
+    std::vector<float> to_vector() const {
         return {x, y, z};
     }
 
-    glm::mat4 convert_to_translation_mat() {
+    glm::mat4 convert_to_translation_mat() const {
         glm::mat4 trans =  glm::translate(glm::mat4(1.0f), glm::vec3(x, y, z));
         return trans;
     }
 };
 
+/**
+ * 3x3 row major matrix stored inline, so it is trivially copyable and
+ * none of the math below touches the heap.
+ */
 struct matrix {
-    std::vector<std::vector<float>> mat;
-    matrix(std::vector<std::vector<float>> imat) {
-        mat = imat;
+    float mat[3][3];
+
+    matrix(const std::vector<std::vector<float>>& imat) {
+        for (int row = 0; row < 3; row++)
+            for (int col = 0; col < 3; col++)
+                mat[row][col] = imat[row][col];
     }
 
     matrix() {
+        for (int row = 0; row < 3; row++)
+            for (int col = 0; col < 3; col++)
+                mat[row][col] = 0;
+    }
+
+    /**
+     * @brief Construct a new matrix from 9 row major floats
+     * 
+     * @param rows 
+     */
+    matrix(const float* rows) {
+        for (int row = 0; row < 3; row++)
+            for (int col = 0; col < 3; col++)
+                mat[row][col] = rows[row*3 + col];
+    }
 
+    matrix(float a, float b, float c,
+           float d, float e, float f,
+           float g, float h, float i) {
+        mat[0][0] = a; mat[0][1] = b; mat[0][2] = c;
+        mat[1][0] = d; mat[1][1] = e; mat[1][2] = f;
+        mat[2][0] = g; mat[2][1] = h; mat[2][2] = i;
     }
 
-    matrix dot (matrix in) {
+    matrix dot (const matrix& in) const {
         // mat a
         float a = mat[0][0];
         float b = mat[0][1];
@@ -137,110 +165,50 @@ struct matrix {
         float q = in.mat[2][1];
         float r = in.mat[2][2];
 
-
-        std::vector<float> row_0 = {
-            a*j + b*m + c*p,
-            a*k + b*n + c*q,
-            a*l + b*o + c*r
-        };
-
-        std::vector<float> row_1 = {
-            d*j + e*m + f*p,
-            d*k + e*n + f*q,
-            d*l + e*o + f*r,
-        };
-
-        std::vector<float> row_2 = {
-            g*j + h*m + i*p,
-            g*k + h*n + i*q,
-            g*l + h*o + i*r
-        };
-
-        std::vector<std::vector<float>> result;
-        result.push_back(row_0);
-        result.push_back(row_1);
-        result.push_back(row_2);
-
-        return matrix(result);
+        return matrix(
+            a*j + b*m + c*p, a*k + b*n + c*q, a*l + b*o + c*r,
+            d*j + e*m + f*p, d*k + e*n + f*q, d*l + e*o + f*r,
+            g*j + h*m + i*p, g*k + h*n + i*q, g*l + h*o + i*r
+        );
     }
 
-    position dot(position pos) {
-        // mat a
-        float a = mat[0][0];
-        float b = mat[0][1];
-        float c = mat[0][2];
-        float d = mat[1][0];
-        float e = mat[1][1];
-        float f = mat[1][2];
-        float g = mat[2][0];
-        float h = mat[2][1];
-        float i = mat[2][2];
-
-        position result(
-            pos.x*a + pos.y*b + pos.z*c, // x coord
-            pos.x*d + pos.y*e + pos.z*f, // y coord
-            pos.x*g + pos.y*h + pos.z*i  // z coord 
+    position dot(position pos) const {
+        return position(
+            pos.x*mat[0][0] + pos.y*mat[0][1] + pos.z*mat[0][2], // x coord
+            pos.x*mat[1][0] + pos.y*mat[1][1] + pos.z*mat[1][2], // y coord
+            pos.x*mat[2][0] + pos.y*mat[2][1] + pos.z*mat[2][2]  // z coord 
         );
-
-        return result;
     }
 
-    matrix add (matrix in) {
-        matrix temp_mat(mat);
-        temp_mat.mat[0][0] = temp_mat.mat[0][0] + in.mat[0][0];
-        temp_mat.mat[0][1] = temp_mat.mat[0][1] + in.mat[0][1];
-        temp_mat.mat[0][2] = temp_mat.mat[0][2] + in.mat[0][2];
-
-        temp_mat.mat[1][0] = temp_mat.mat[1][0] + in.mat[1][0];
-        temp_mat.mat[1][1] = temp_mat.mat[1][1] + in.mat[1][1];
-        temp_mat.mat[1][2] = temp_mat.mat[1][2] + in.mat[1][2];
-
-        temp_mat.mat[2][0] = temp_mat.mat[2][0] + in.mat[2][0];
-        temp_mat.mat[2][1] = temp_mat.mat[2][1] + in.mat[2][1];
-        temp_mat.mat[2][2] = temp_mat.mat[2][2] + in.mat[2][2];
+    matrix add (const matrix& in) const {
+        matrix temp_mat;
+        for (int row = 0; row < 3; row++)
+            for (int col = 0; col < 3; col++)
+                temp_mat.mat[row][col] = mat[row][col] + in.mat[row][col];
         return temp_mat;
     }
 
-    matrix scale(float f) {
-        matrix temp_mat(mat);
-        temp_mat.mat[0][0] = temp_mat.mat[0][0] * f;
-        temp_mat.mat[0][1] = temp_mat.mat[0][1] * f;
-        temp_mat.mat[0][2] = temp_mat.mat[0][2] * f;
-
-        temp_mat.mat[1][0] = temp_mat.mat[1][0] * f;
-        temp_mat.mat[1][1] = temp_mat.mat[1][1] * f;
-        temp_mat.mat[1][2] = temp_mat.mat[1][2] * f;
-
-        temp_mat.mat[2][0] = temp_mat.mat[2][0] * f;
-        temp_mat.mat[2][1] = temp_mat.mat[2][1] * f;
-        temp_mat.mat[2][2] = temp_mat.mat[2][2] * f;
-
+    matrix scale(float f) const {
+        matrix temp_mat;
+        for (int row = 0; row < 3; row++)
+            for (int col = 0; col < 3; col++)
+                temp_mat.mat[row][col] = mat[row][col] * f;
         return temp_mat;
     }
 
-    matrix transpose() {
-        std::vector<std::vector<float>> temp_mat;
-
-        std::vector<float> row_1 = { 
-            mat[0][0], mat[1][0], mat[2][0]
-        };
-
-        std::vector<float> row_2 = { 
-            mat[0][1], mat[1][1], mat[2][1]
-        };
-
-        std::vector<float> row_3 = { 
+    matrix transpose() const {
+        return matrix(
+            mat[0][0], mat[1][0], mat[2][0],
+            mat[0][1], mat[1][1], mat[2][1],
             mat[0][2], mat[1][2], mat[2][2]
-        };
-
-        return matrix(temp_mat);
+        );
     }
 
 
-    std::string to_string() {
+    std::string to_string() const {
         std::string result = "";
 
-        for (std::vector<float> row : mat) {
+        for (const auto& row : mat) {
             result += "[";
 
             for (float elem : row) {
@@ -253,20 +221,17 @@ struct matrix {
         return result;
     }
 
-    std::string to_single_line_string() {
+    std::string to_single_line_string() const {
         std::string result = "";
 
-        unsigned int count = 0;
-
-        for (std::vector<float> row : mat) {
+        for (int row = 0; row < 3; row++) {
             result += "[";
 
-            for (float elem : row) {
+            for (float elem : mat[row]) {
                 result += std::to_string(elem) + ",";
             }
 
-            count++;
-            if (mat.size() != count) {
+            if (row != 2) {
                 result += "],";
             } else {
                 result += "]";
@@ -275,7 +240,7 @@ struct matrix {
         return result;
     }
 
-    glm::mat4 convert_to_mat4() {
+    glm::mat4 convert_to_mat4() const {
         float a = mat[0][0];
         float b = mat[0][1];
         float c = mat[0][2];
@@ -298,33 +263,23 @@ struct matrix {
     }
 };
 
+static_assert(std::is_trivially_copyable<position>::value, "position must stay a plain value type");
+static_assert(std::is_trivially_copyable<matrix>::value, "matrix must stay a plain value type");
+
 matrix identity() {
-    std::vector<std::vector<float>> identity;
-    identity.push_back(
-        {1, 0, 0}
+    return matrix(
+        1, 0, 0,
+        0, 1, 0,
+        0, 0, 1
     );
-    identity.push_back(
-        {0, 1, 0}
-    );
-    identity.push_back(
-        {0, 0, 1}
-    );
-
-    return matrix(identity);
 }
 
 matrix skew_symmetric(position cross) {
-    std::vector<std::vector<float>> skew;
-    skew.push_back(
-        {0,        -cross.z,  cross.y}
-    );
-    skew.push_back(
-        {cross.z,   0,       -cross.x}
+    return matrix(
+        0,        -cross.z,  cross.y,
+        cross.z,   0,       -cross.x,
+        -cross.y,  cross.x, 0
     );
-    skew.push_back(
-        {-cross.y,  cross.x, 0       }
-    );
-    return matrix(skew);
 }
 
 
@@ -345,6 +300,8 @@ struct bone {
     // whether or continue to children
     bool single_shot;
     std::string name;
+    // index in skeleton::bones, set when a skeleton is built from the bone
+    int id = -1;
 
     bone() {
 
@@ -376,72 +333,428 @@ struct BoneHasher {
             using std::string;
 
             // Compute individual hash values for first,
-            // second and third and combine them using XOR
-            // and bit shifting:
+            // second and third and combine them the way boost::hash_combine does,
+            // a plain product is 0 for every bone touching position 0
             std::size_t res = 17;
-            res = res * 31 * hash<int>()(k.parent_index);
-            res = res * 31 * hash<int>()(k.child_index);
-            res = res * 31 * hash<bool>()(k.single_shot);
+            res ^= hash<int>()(k.parent_index) + 0x9e3779b9 + (res << 6) + (res >> 2);
+            res ^= hash<int>()(k.child_index) + 0x9e3779b9 + (res << 6) + (res >> 2);
+            res ^= hash<bool>()(k.single_shot) + 0x9e3779b9 + (res << 6) + (res >> 2);
 
             return res;
         }
 };
 
 
+/**
+ * @brief bones listed by id in one of bone_topology's arrays, iterates as const bone&
+ *
+ */
+struct bone_range {
+    const bone* bones = nullptr;
+    const int* first = nullptr;
+    const int* last = nullptr;
+
+    struct iterator {
+        typedef std::forward_iterator_tag iterator_category;
+        typedef bone value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const bone* pointer;
+        typedef const bone& reference;
+
+        const bone* bones;
+        const int* at;
+
+        const bone& operator*() const { return bones[*at]; }
+        const bone* operator->() const { return bones + *at; }
+        iterator& operator++() { ++at; return *this; }
+        bool operator==(const iterator& other) const { return at == other.at; }
+        bool operator!=(const iterator& other) const { return at != other.at; }
+    };
+
+    iterator begin() const { return {bones, first}; }
+    iterator end() const { return {bones, last}; }
+    size_t size() const { return last - first; }
+    bool empty() const { return first == last; }
+    const bone& operator[](size_t i) const { return bones[first[i]]; }
+};
+
+/**
+ * Skeleton topology in compressed sparse row form, compiled once from a skeleton's bones.
+ * Bones are referred to by id, their index in skeleton::bones.
+ *
+ *  position_bones  per position p, the bones starting at it in bone order:
+ *                  position_bones[position_bone_offsets[p] .. position_bone_offsets[p + 1]).
+ *                  A bone's children are the range of its child position
+ *  flow            base bones, each followed by everything downstream of it depth first,
+ *                  children in bone order. A bone's downstream bones are
+ *                  flow[flow_index[id] + 1 .. flow_end[id]), empty for single shot bones
+ *                  and bones not reached from the base
+ *  name_ids        bone name -> id
+ *
+ * Bones below the base are expected to form a tree (no two non single shot bones share a
+ * child position), a bone reached a second time stays under its first parent.
+ */
+struct bone_topology {
+    std::vector<uint32_t> position_bone_offsets;
+    std::vector<int> position_bones;
+    std::vector<int> flow;
+    // per bone, -1 when the bone is not reached from the base
+    std::vector<int> flow_index;
+    std::vector<int> flow_end;
+    std::unordered_map<std::string, int> name_ids;
+
+    void build(const std::vector<bone>& bones, int base_index) {
+        int position_count = base_index + 1;
+        for (const bone& j : bones)
+            position_count = std::max(position_count, std::max(j.parent_index, j.child_index) + 1);
+
+        // counting sort of the bones by parent position, stable so bone order is kept
+        position_bone_offsets.assign(position_count + 1, 0);
+        for (const bone& j : bones)
+            position_bone_offsets[j.parent_index + 1]++;
+        for (int p = 0; p < position_count; p++)
+            position_bone_offsets[p + 1] += position_bone_offsets[p];
+        position_bones.assign(bones.size(), -1);
+        std::vector<uint32_t> cursor(position_bone_offsets.begin(), position_bone_offsets.end() - 1);
+        for (size_t id = 0; id < bones.size(); id++)
+            position_bones[cursor[bones[id].parent_index]++] = id;
+
+        flow.clear();
+        flow.reserve(bones.size());
+        flow_index.assign(bones.size(), -1);
+        flow_end.assign(bones.size(), -1);
+        // depth first without recursion, each entry is a bone and its next child slot
+        std::vector<std::pair<int, uint32_t>> stack;
+        auto enter = [&](int id) {
+            flow_index[id] = flow.size();
+            flow.push_back(id);
+            const bone& j = bones[id];
+            stack.push_back({id, j.single_shot ? position_bone_offsets[j.child_index + 1] : position_bone_offsets[j.child_index]});
+        };
+        for (uint32_t b = position_bone_offsets[base_index]; b < position_bone_offsets[base_index + 1]; b++) {
+            int base = position_bones[b];
+            if (bones[base].single_shot || flow_index[base] >= 0)
+                continue;
+            enter(base);
+            while (!stack.empty()) {
+                int id = stack.back().first;
+                uint32_t next = stack.back().second;
+                if (next < position_bone_offsets[bones[id].child_index + 1]) {
+                    stack.back().second++;
+                    int child = position_bones[next];
+                    if (flow_index[child] < 0)
+                        enter(child);
+                } else {
+                    flow_end[id] = flow.size();
+                    stack.pop_back();
+                }
+            }
+        }
+
+        name_ids.clear();
+        for (size_t id = 0; id < bones.size(); id++)
+            name_ids[bones[id].name] = id;
+    }
+
+    bone_range bones_from(const std::vector<bone>& bones, int position_index) const {
+        if (position_index < 0 || position_index + 1 >= (int) position_bone_offsets.size())
+            return {};
+        return {bones.data(), position_bones.data() + position_bone_offsets[position_index],
+            position_bones.data() + position_bone_offsets[position_index + 1]};
+    }
+
+    bone_range downstream(const std::vector<bone>& bones, int id) const {
+        if (id < 0 || flow_index[id] < 0)
+            return {};
+        return {bones.data(), flow.data() + flow_index[id] + 1, flow.data() + flow_end[id]};
+    }
+};
+
+
 matrix rodrigues(position base_pos, position new_pos) {
     position new_norm = new_pos.normalize();
     position base_norm = base_pos.normalize();
         
     position cross = base_norm.cross(new_norm);
-    
+
+    float cosin = base_norm.dot(new_norm);
+    // sin from the real cross product, before any axis is substituted
+    float sin = cross.magnitude();
+
+    // same direction, e.g. a bone fk left at its rest vector: no rotation
+    if (sin == 0 && cosin > 0)
+        return identity();
+
     // // arbitary axis determination when mag is 0
-    if (cross.magnitude() == 0)  {
+    if (sin == 0)  {
         cross = position(0, 1, 0);
         std::cout << "CROSS PRODUCT HAS MAGNITUTDE OF 0" << std::endl;
-        // NOTE !! This is an error edge case. if this is ever seen the resulting rotation is WRONG
+        // NOTE !! This is an error edge case (opposite directions). if this is ever seen the
+        // resulting half turn is only right when the bone is perpendicular to y
     }
 
-    float cosin = base_norm.dot(new_norm);
-    float sin = cross.magnitude();
-
     matrix skew_symmetrix = skew_symmetric(cross.normalize());
     matrix skew_sq = skew_symmetrix.dot(skew_symmetrix);
-    
-    matrix I = identity();
 
-    matrix rotation = identity().add(skew_symmetrix.scale(sin)).add(skew_symmetrix.dot(skew_symmetrix).scale(1-cosin));
+    matrix rotation = identity().add(skew_symmetrix.scale(sin)).add(skew_sq.scale(1-cosin));
     return rotation;
 }
 
-struct bodymodel {
-   std::vector<bone> bones;
-   std::unordered_map<bone,std::vector<bone>, BoneHasher> bones_flow;
-   std::vector<position> positions;
+/**
+ * Forward kinematics over a skeleton's bone tree. Tree bones are kept parents first, so
+ * one pass places every joint: a bone's child lands at its parent's solved position plus
+ * the bone's rest vector turned by the bone's rotation. That is where rotating the bones
+ * one by one with rotate_single_bone and shifting everything downstream ends up, in
+ * O(bones) instead of O(bones x downstream bones).
+ *
+ * Single shot bones close a loop between two joints that already hang off other bones,
+ * they are not part of the tree and have no rotation here.
+ */
+struct fk_solver {
+    // tree bones, every parent joint solved before the bones hanging off it
+    std::vector<int> joint_parent;
+    std::vector<int> joint_child;
+    // index into skeleton::bones of every tree bone
+    std::vector<int> joint_bone;
+    // per position index the tree bone whose child it is, -1 for roots
+    std::vector<int> position_joint;
+
+    size_t size() const { return joint_child.size(); }
+
+    /**
+     * @brief the tree bone j is, -1 when j is not part of the tree
+     *
+     * @param j
+     * @return int
+     */
+    int joint_of(const bone& j) const {
+        if (j.single_shot || j.child_index < 0 || j.child_index >= (int) position_joint.size())
+            return -1;
+        int joint = position_joint[j.child_index];
+        return joint >= 0 && joint_parent[joint] == j.parent_index ? joint : -1;
+    }
+
+    /**
+     * @brief solved positions for one rotation per tree bone
+     *
+     * @param base_positions rest positions the bone vectors are taken from
+     * @param rotations size() matrices, in tree order
+     * @param out overwritten, joints outside the tree keep their rest position
+     */
+    void solve(const std::vector<position>& base_positions, const matrix* rotations, std::vector<position>& out) const {
+        out.assign(base_positions.begin(), base_positions.end());
+        for (size_t j = 0; j < size(); j++) {
+            position rest = base_positions[joint_child[j]].subtract(base_positions[joint_parent[j]]);
+            out[joint_child[j]] = rotations[j].dot(rest).add(out[joint_parent[j]]);
+        }
+    }
+};
+
+/**
+ * Positions of one skeleton's joints, indexed by position index. position is three packed
+ * floats, so a pose is one contiguous float array and can be handed to GL or copied as is.
+ */
+typedef std::vector<position> pose;
+
+/**
+ * The part of a bodymodel that never changes once built: bones, base bones, topology and
+ * fk layout. Models share it through a shared_ptr, copying a model copies its pose only.
+ */
+struct skeleton {
+    std::vector<bone> bones;
     // base set of joints, starting points of model
-   std::vector<bone> base_bones;
+    std::vector<bone> base_bones;
+    // children, downstream flow and names of bones, by bone id
+    bone_topology topology;
 
-    std::unordered_map <std::string, bone> name_bone_hash;
+    fk_solver fk;
 
-    // blank model
-    bodymodel () {
+    // no bones
+    skeleton() {
 
     }
 
-    bodymodel(std::vector<bone> incoming_joints, int base_index) {
-        bones = incoming_joints;
+    skeleton(std::vector<bone> incoming_joints, int base_index) {
+        bones = std::move(incoming_joints);
+        for (size_t i = 0; i < bones.size(); i++)
+            bones[i].id = i;
         create_flow_fromm_bones(base_index);
-        create_name_joint_hash();
-       std::vector<position> positions;
+        create_fk_solver();
+    }
+
+    /**
+     * @brief id of a bone of this skeleton, -1 if it has none. Bones copied out of bones
+     * carry their id, others are looked up among the bones leaving their parent position
+     *
+     * @param j
+     * @return int
+     */
+    int bone_id(const bone& j) const {
+        if (j.id >= 0 && j.id < (int) bones.size() && bones[j.id] == j)
+            return j.id;
+        for (const bone& candidate : bones_from_position(j.parent_index))
+            if (candidate == j)
+                return candidate.id;
+        return -1;
     }
 
-    void create_name_joint_hash() {
-        for (bone j : bones) {
-            name_bone_hash[j.name] = j;
+    int bone_id(const std::string& name) const {
+        auto found = topology.name_ids.find(name);
+        return found == topology.name_ids.end() ? -1 : found->second;
+    }
+
+    /**
+     * @brief all bones downstream of j, parents first
+     *
+     * @param j
+     * @return bone_range
+     */
+    bone_range flow(const bone& j) const {
+        return topology.downstream(bones, bone_id(j));
+    }
+
+    // bones whose parent is position_index, in bone order
+    bone_range bones_from_position(int position_index) const {
+        return topology.bones_from(bones, position_index);
+    }
+
+    // bones continuing from j, empty for single shot bones
+    bone_range children(const bone& j) const {
+        return j.single_shot ? bone_range() : bones_from_position(j.child_index);
+    }
+
+    /**
+     * @brief position indices in the order vectorify_positions_in_order emits them,
+     * a parent / child pair per bone, base bones followed by their flow
+     * 
+     * @return std::vector<int> 
+     */
+    std::vector<int> position_indices_in_order() const {
+        std::vector<int> order;
+
+        for (bone base : base_bones) {
+            order.push_back(base.parent_index);
+            order.push_back(base.child_index);
+            for (bone j : flow(base)) { 
+                order.push_back(j.parent_index);
+                order.push_back(j.child_index);
+            }
+        }
+
+        return order;
+    }
+
+    /**
+     * @brief per fk tree bone, the rotation taking the bone from rest to posed. What
+     * construct_rotations computes for two poses of the same skeleton, without the map
+     *
+     * @param rest
+     * @param posed
+     * @param joint_rotations resized to fk.size(), in tree order
+     */
+    void rotations_into(const pose& rest, const pose& posed, std::vector<matrix>& joint_rotations) const {
+        joint_rotations.resize(fk.size());
+        for (size_t j = 0; j < fk.size(); j++) {
+            position base_child = rest[fk.joint_child[j]].subtract(rest[fk.joint_parent[j]]);
+            position child = posed[fk.joint_child[j]].subtract(posed[fk.joint_parent[j]]);
+            joint_rotations[j] = rodrigues(base_child, child);
         }
     }
 
+    /**
+     * @brief rest posed by one rotation per fk tree bone, see fk_solver::solve
+     *
+     * @param rest
+     * @param joint_rotations fk.size() matrices, in tree order
+     * @param out overwritten, allocates only when it is smaller than rest
+     */
+    void solve(const pose& rest, const std::vector<matrix>& joint_rotations, pose& out) const {
+        fk.solve(rest, joint_rotations.data(), out);
+    }
 
-    std::vector<std::vector<float>> vectorify_positions() {
+private:
+    /**
+     * @brief lays out fk over the flow: base bones followed by their downstream bones,
+     * which the topology already lists parents first
+     *
+     */
+    void create_fk_solver() {
+        fk = fk_solver();
+        int position_count = 0;
+        for (const bone& j : bones)
+            position_count = std::max(position_count, std::max(j.parent_index, j.child_index) + 1);
+        fk.position_joint.assign(position_count, -1);
+
+        auto add_joint = [&](const bone& j) {
+            if (j.single_shot || fk.position_joint[j.child_index] >= 0)
+                return;
+            fk.position_joint[j.child_index] = fk.size();
+            fk.joint_parent.push_back(j.parent_index);
+            fk.joint_child.push_back(j.child_index);
+            fk.joint_bone.push_back(bone_id(j));
+        };
+        for (const bone& base : base_bones) {
+            add_joint(base);
+            for (const bone& j : flow(base))
+                add_joint(j);
+        }
+    }
+
+    /**
+     * @brief compiles the topology of bones and collects the base bones, the non single
+     * shot bones leaving base_index, in the order their flows are walked
+     *
+     * @param base_index
+     */
+    void create_flow_fromm_bones (int base_index) {
+        topology.build(bones, base_index);
+        base_bones.clear();
+        for (const bone& j : bones_from_position(base_index))
+            if (!j.single_shot)
+                base_bones.push_back(j);
+    }
+};
+
+// rotations[name], the zero matrix a missing name always got from operator[]
+const matrix& rotation_of(const std::unordered_map<std::string, matrix>& rotations, const std::string& name) {
+    static const matrix missing;
+    auto found = rotations.find(name);
+    return found == rotations.end() ? missing : found->second;
+}
+
+struct bodymodel {
+    // shared by every copy of the model, only positions belong to this one
+    std::shared_ptr<const skeleton> skel;
+    pose positions;
+
+    // blank model
+    bodymodel () : skel(empty_skeleton()) {
+
+    }
+
+    bodymodel(std::vector<bone> incoming_joints, int base_index)
+        : skel(std::make_shared<const skeleton>(std::move(incoming_joints), base_index)) {
+
+    }
+
+    explicit bodymodel(std::shared_ptr<const skeleton> shared, pose initial_positions = pose())
+        : skel(std::move(shared)), positions(std::move(initial_positions)) {
+
+    }
+
+    static const std::shared_ptr<const skeleton>& empty_skeleton() {
+        static const std::shared_ptr<const skeleton> empty = std::make_shared<const skeleton>();
+        return empty;
+    }
+
+    int bone_id(const bone& j) const { return skel->bone_id(j); }
+    int bone_id(const std::string& name) const { return skel->bone_id(name); }
+    bone_range flow(const bone& j) const { return skel->flow(j); }
+    bone_range bones_from_position(int position_index) const { return skel->bones_from_position(position_index); }
+    bone_range children(const bone& j) const { return skel->children(j); }
+    std::vector<int> position_indices_in_order() const { return skel->position_indices_in_order(); }
+
+    std::vector<std::vector<float>> vectorify_positions() const {
         std::vector<std::vector<float>> pos;
 
         for (position p : positions) {
@@ -451,16 +764,17 @@ struct bodymodel {
         return pos;
     }
 
-    std::vector<std::vector<float>> vectorify_positions_in_order() {
+
+    std::vector<std::vector<float>> vectorify_positions_in_order() const {
         std::vector<std::vector<float>> pos;
 
-        for (bone base : base_bones) {
+        for (bone base : skel->base_bones) {
             // first step case
             position p_pos = positions[base.parent_index];
             position c_pos = positions[base.child_index];
             pos.push_back(p_pos.to_vector());
             pos.push_back(c_pos.to_vector());
-            for (bone j : bones_flow[base]) { 
+            for (bone j : flow(base)) { 
                 p_pos = positions[j.parent_index];
                 c_pos = positions[j.child_index];
                 pos.push_back(p_pos.to_vector());
@@ -472,15 +786,18 @@ struct bodymodel {
     }
 
 
-    std::unordered_map<std::string, matrix> construct_rotations(bodymodel base) {
+    std::unordered_map<std::string, matrix> construct_rotations(const bodymodel& base) const {
         std::unordered_map<std::string, matrix> bone_name_to_rotation;
-        for (bone j : base_bones) {
+        for (bone j : skel->base_bones) {
             position parent = positions[j.parent_index];
             position child = positions[j.child_index];
             //now adjust with parent as origin
             child = child.subtract(parent);
 
-            bone base_bone = base.name_bone_hash[j.name];
+            int base_id = base.bone_id(j.name);
+            if (base_id < 0)
+                continue;
+            bone base_bone = base.skel->bones[base_id];
             // base parent as origin
             position base_parent = base.positions[base_bone.parent_index];
             position base_child = base.positions[base_bone.child_index];
@@ -491,12 +808,15 @@ struct bodymodel {
             // NOTE !! To rotate point A to point B, you will need to normalize point A, and then multiple
             // by the bones base distance. This is to prevent bone lengths changing due to model instability
             bone_name_to_rotation[j.name] = rotation;
-            for (bone next_j : bones_flow[j]) {
+            for (bone next_j : flow(j)) {
                 parent = positions[next_j.parent_index];
                 child = positions[next_j.child_index];
                 //now adjust with parent as origin
                 child = child.subtract(parent);
-                base_bone = base.name_bone_hash[next_j.name];
+                base_id = base.bone_id(next_j.name);
+                if (base_id < 0)
+                    continue;
+                base_bone = base.skel->bones[base_id];
                 // base parent as origin
                 base_parent = base.positions[base_bone.parent_index];
                 base_child = base.positions[base_bone.child_index];
@@ -512,26 +832,49 @@ struct bodymodel {
         return bone_name_to_rotation;
     }
 
-    bodymodel rotate_self_by_rotations(std::unordered_map<std::string, matrix> rotations, bodymodel new_model) {
+    bodymodel rotate_self_by_rotations(const std::unordered_map<std::string, matrix>& rotations, const bodymodel& new_model) const {
+        // every tree bone is rotated once, by its own rotation
+        std::vector<matrix> joint_rotations(skel->fk.size(), identity());
+        for (size_t j = 0; j < skel->fk.size(); j++) {
+            const std::string& name = skel->bones[skel->fk.joint_bone[j]].name;
+            if (name == "rl_should")
+                continue;
+            joint_rotations[j] = rotation_of(rotations, name);
+        }
+
+        bodymodel posed(new_model.skel);
+        skel->fk.solve(positions, joint_rotations.data(), posed.positions);
+        return posed;
+
+    }
+
+    /**
+     * @brief rotate_self_by_rotations bone by bone, every rotation followed by shifting the
+     * bone's whole downstream. O(bones x downstream bones), kept as the reference fk is
+     * checked and benchmarked against.
+     *
+     * @param rotations
+     * @param new_model
+     * @return bodymodel
+     */
+    bodymodel rotate_self_by_single_bones(const std::unordered_map<std::string, matrix>& rotations, const bodymodel& new_model) const {
         std::vector<position> local_positions = positions;
 
-        for (bone j : base_bones) {
-            matrix current_matrix = rotations[j.name];
+        for (bone j : skel->base_bones) {
+            matrix current_matrix = rotation_of(rotations, j.name);
             local_positions = rotate_single_bone(j, local_positions, current_matrix);
-            for (bone next_j : bones_flow[j]) {
+            for (bone next_j : flow(j)) {
                 if (next_j.name == "rl_should")
                     continue;
-                current_matrix = rotations[next_j.name];
+                current_matrix = rotation_of(rotations, next_j.name);
                 local_positions = rotate_single_bone(next_j, local_positions, current_matrix);
             }
         }
 
-        new_model.set_positions(local_positions);
-        return new_model;
-
+        return bodymodel(new_model.skel, std::move(local_positions));
     }
 
-    std::vector<position> rotate_single_bone(bone j, std::vector<position> local_positions, matrix current_rot) {
+    std::vector<position> rotate_single_bone(bone j, std::vector<position> local_positions, matrix current_rot) const {
         position parent = local_positions[j.parent_index];
         position child = local_positions[j.child_index];
 
@@ -541,7 +884,7 @@ struct bodymodel {
         local_positions[j.child_index] = rotated_pos;
         // now apply translation downstream
         position position_diff = rotated_pos.subtract(child);
-        for (bone dj : bones_flow[j]) {                    
+        for (bone dj : flow(j)) {                    
             local_positions[dj.child_index] = local_positions[dj.child_index].add(position_diff);
         }
         // std::cout << std::endl;
@@ -552,7 +895,7 @@ struct bodymodel {
         bone j, 
         matrix current_rot, 
         std::vector<position>& local_positions, 
-        std::unordered_map<std::string, position>& map) 
+        std::unordered_map<std::string, position>& map) const
     {
         position parent = local_positions[j.parent_index];
         position child = local_positions[j.child_index];
@@ -563,7 +906,7 @@ struct bodymodel {
         local_positions[j.child_index] = rotated_pos;
         // now apply translation downstream
         position position_diff = rotated_pos.subtract(child);
-        for (bone dj : bones_flow[j]) {                    
+        for (bone dj : flow(j)) {                    
             local_positions[dj.child_index] = local_positions[dj.child_index].add(position_diff);
             // add tranlsation to map
             if (map.find(dj.name) == map.end())
@@ -574,7 +917,7 @@ struct bodymodel {
         }
     }
 
-    std::string toString() {
+    std::string toString() const {
        std::vector <position> local_pos = positions;
         // fail case
         if (positions.size() == 0){
@@ -583,12 +926,12 @@ struct bodymodel {
         std::string return_string = "";
         // iterate through all bones in stream
         
-        for (bone base : base_bones) {
+        for (bone base : skel->base_bones) {
             // first step case
             position p_pos = local_pos[base.parent_index];
             position c_pos = local_pos[base.child_index];
             return_string += base.name + ": {" + p_pos.toString() +", "+ c_pos.toString() + " }, ";
-            for (bone j : bones_flow[base]) { 
+            for (bone j : flow(base)) { 
                 p_pos = local_pos[j.parent_index];
                 c_pos = local_pos[j.child_index];
                 return_string += j.name + ": {" + p_pos.toString() +", "+ c_pos.toString() + " }, ";
@@ -597,7 +940,7 @@ struct bodymodel {
         return return_string;
     }
 
-    std::string toFlatString() {
+    std::string toFlatString() const {
        std::vector <position> local_pos = positions;
         // fail case
         if (positions.size() == 0){
@@ -605,12 +948,12 @@ struct bodymodel {
         }
         std::string return_string = "";
         // iterate through all bones in stream
-        for (bone base : base_bones) {
+        for (bone base : skel->base_bones) {
             // first step case
             position p_pos = local_pos[base.parent_index];
             position c_pos = local_pos[base.child_index];
             return_string += p_pos.toString();
-            for (bone j : bones_flow[base]) { 
+            for (bone j : flow(base)) { 
                 p_pos = local_pos[j.parent_index];
                 c_pos = local_pos[j.child_index];
                 return_string += c_pos.toString();
@@ -620,63 +963,49 @@ struct bodymodel {
     }
 
 
-    void set_positions (std::vector<position> new_positions) {
+    void set_positions (const pose& new_positions) {
         positions = new_positions;
     }
 
-    position_pair get_bones_positions (bone chosen_bone) {
+    position_pair get_bones_positions (const bone& chosen_bone) const {
         return position_pair {positions[chosen_bone.parent_index], positions[chosen_bone.child_index]};
     }
 
-    void create_flow_fromm_bones (int base_index) {
-       std::vector<bone> immediate_children;
-        for (int i = 0; i < bones.size(); i++) {
-            if (bones[i].parent_index == base_index && !bones[i].single_shot) {
-                immediate_children.push_back(bones[i]);
-            }
-        }
-        for (bone child: immediate_children) {
-            create_flow_helper(child);
-        }
-        base_bones = immediate_children;
-    }
-
     /**
-     * @brief Recursive helper for constructing model stream flow
-     * 
-     * Finds each immediate downstream base of the parent base,
-     *  recursively calls this method on each child and childs downstream bones to its own,
-     *  and sets the bones_flow hashmap to all of its downstream bones in order of the 
-     *  furthest upstream bones first
-     * @param parent 
-     * @return std::vector<bone> 
+     * @brief what rotate_single_bone_with_translation_map collects for a solve: for every
+     * bone below a rotated tree bone, how far its parent joint moved
+     *
+     * @param solved positions skel->fk.solve returned from this model's positions
+     * @param rotated per tree bone, whether a rotation was applied to it
+     * @return std::unordered_map<std::string, position>
      */
-   std::vector<bone> create_flow_helper (bone parent) {
-        // find children of parent
-       std::vector<bone> downstream;
-        if (parent.single_shot) 
-            return downstream;
-        for (int i = 0; i < bones.size(); i++) {
-            bone current_bone = bones[i];
-            // if is a child of parent, and is a parent itself,
-            //  bones is downstream
-            if (parent.child_index == current_bone.parent_index) {
-                downstream.push_back(current_bone);
-               std::vector<bone> child_downstream = create_flow_helper(current_bone);
-                downstream.insert(downstream.end(), child_downstream.begin(), child_downstream.end());
-            }
+    std::unordered_map<std::string, position> downstream_translations(
+        const std::vector<position>& solved,
+        const std::vector<bool>& rotated) const
+    {
+        std::unordered_map<std::string, position> translations;
+        // per tree bone, whether a bone above it was rotated
+        std::vector<bool> below_rotated(skel->fk.size(), false);
+        for (size_t j = 0; j < skel->fk.size(); j++) {
+            int parent_joint = skel->fk.position_joint[skel->fk.joint_parent[j]];
+            if (parent_joint < 0 || !(rotated[parent_joint] || below_rotated[parent_joint]))
+                continue;
+            below_rotated[j] = true;
+            translations[skel->bones[skel->fk.joint_bone[j]].name] =
+                solved[skel->fk.joint_parent[j]].subtract(positions[skel->fk.joint_parent[j]]);
         }
-        bones_flow[parent] = downstream;
-        return downstream;
+        return translations;
     }
 
 
+
+
     /**
      * @brief gets the relative xyz position of bones in positions and returns a hashmap which 
      * 
      * @return unordered_map<bone, position, BaseHasher> 
      */
-    std::unordered_map<bone, position, BoneHasher> get_bone_relative_positions () {
+    std::unordered_map<bone, position, BoneHasher> get_bone_relative_positions () const {
        std::vector <position> local_pos = positions;
         std::unordered_map<bone, position, BoneHasher> relative_pos;
         // fail case
@@ -684,7 +1013,7 @@ struct bodymodel {
             return relative_pos;
         }
         // iterate through all bones in stream
-        for (bone base : base_bones) {
+        for (bone base : skel->base_bones) {
 
             // first step case
             position p_pos = local_pos[base.parent_index];
@@ -692,7 +1021,7 @@ struct bodymodel {
             position difference = p_pos.subtract(c_pos);
             relative_pos[base] = difference;
             // for each child of base bones in order, find local difference
-            for (bone j : bones_flow[base]) {
+            for (bone j : flow(base)) {
                 position p_pos = local_pos[j.parent_index];
                 position c_pos = local_pos[j.child_index];
                 position difference = p_pos.subtract(c_pos);
@@ -707,7 +1036,7 @@ struct bodymodel {
      * 
      * @returnstd::vector<position> 
      */
-   std::vector<position> get_bone_relative_positions_flat() {
+   std::vector<position> get_bone_relative_positions_flat() const {
        std::vector <position> local_pos = positions;
        std::vector <position> relative_pos;
 
@@ -715,7 +1044,7 @@ struct bodymodel {
             return relative_pos;
         }
         // iterate through all bones in stream
-        for (bone base : base_bones) {
+        for (bone base : skel->base_bones) {
 
             // first step case
             position p_pos = local_pos[base.parent_index];
@@ -723,7 +1052,7 @@ struct bodymodel {
             position difference = p_pos.subtract(c_pos);
             relative_pos.push_back(difference);
             // for each child of base base in order, find local difference
-            for (bone j : bones_flow[base]) {
+            for (bone j : flow(base)) {
                 position p_pos = local_pos[j.parent_index];
                 position c_pos = local_pos[j.child_index];
                 position difference = p_pos.subtract(c_pos);
@@ -733,36 +1062,25 @@ struct bodymodel {
         return relative_pos;
     }
 
-    std::vector<bone> get_parent_bones_of_pos_index(int index) {
-        std::vector<bone> local_bones;
-        for (bone j : bones) {
-            if (j.parent_index == index) {
-                local_bones.push_back(j);
-            }
-        }
-        return local_bones;
+    std::vector<bone> get_parent_bones_of_pos_index(int index) const {
+        bone_range range = bones_from_position(index);
+        return std::vector<bone>(range.begin(), range.end());
     }
 
-    bone get_first_parent_bone_instance(int index) {
-        for (bone j : bones) {
-            if (j.parent_index == index) {
-                return j;
-            }
-        }
+    bone get_first_parent_bone_instance(int index) const {
+        bone_range range = bones_from_position(index);
+        if (!range.empty())
+            return range[0];
         throw std::invalid_argument("get_first_parent_bone_instance: Failed to find input index as a parent...");
     }
 
-    bone get_first_bone_that_has_child_in_flow(int parent, int child) {
-        std::vector<bone> prospects;
-        for (bone j : bones) {
-            if (j.parent_index == parent && j.child_index == child)
+    bone get_first_bone_that_has_child_in_flow(int parent, int child) const {
+        bone_range prospects = bones_from_position(parent);
+        for (const bone& j : prospects)
+            if (j.child_index == child)
                 return j;
-            else if (j.parent_index == parent)
-                prospects.push_back(j);
-            
-        }
-        for (bone j : prospects) {
-            for (bone c : bones_flow[j]) {
+        for (const bone& j : prospects) {
+            for (const bone& c : flow(j)) {
                 if (c.child_index == child || c.parent_index == child)
                     return j;
             }
@@ -771,22 +1089,16 @@ struct bodymodel {
     }
 
     // gets all bones between bone parent and child in bone heirachy
-    std::vector<bone> get_all_bone_between_parent_and_child(int parent, int child) {
+    std::vector<bone> get_all_bone_between_parent_and_child(int parent, int child) const {
         // I am assuming that parent and child are in one singular path, and have no branches
-        std::vector<bone> parent_bone;
-        bool has_found_parent = false;
-        for (bone j : bones) {
-            if (j.parent_index == parent  && j.child_index == child) {
+        bone_range parent_bone = bones_from_position(parent);
+        for (const bone& j : parent_bone)
+            if (j.child_index == child)
                 return {j};
-            }
-            else if (j.parent_index == parent) {
-                parent_bone.push_back(j);
-            }
-        }
-        for (bone pj : parent_bone) {
+        for (const bone& pj : parent_bone) {
             std::vector<bone> inbetween_bones = {pj};
             bool has_child_in_path = false;
-            for (bone j : bones_flow[pj]) {
+            for (const bone& j : flow(pj)) {
                 if (j.child_index == child) {
                     inbetween_bones.push_back(j);
                     has_child_in_path = true;
@@ -1138,126 +1450,107 @@ void print_map(std::unordered_map<bone, position, BoneHasher> m) {
     }
 }
 
-position split_string_kp_into_arr (std::string keypoints, bool reverse_y=false) {
-    std::string end_bracket = "]";
-    std::string comma = ",";
-    int start, end = -1*comma.size();
-    float x;
-    start = end + comma.size();
-    end = keypoints.find(comma, start);    
-    std::string current_num = keypoints.substr(start, end-start);
-    // try catch for case of dangling ,
-    try {
-        x = stof(current_num);
-    } catch (...) {
-        start = end + comma.size();
-        end = keypoints.find(comma, start);    
-        std::string current_num = keypoints.substr(start, end-start);
-        x = stof(current_num);
-    }
-    start = end + comma.size();
-    end = keypoints.find(comma, start);
-    current_num = keypoints.substr(start, end-start);
-    float y = stof(current_num);
-    if (reverse_y)
-        y*=-1;
-
-    start = end + comma.size();
-    end = keypoints.find(comma, start);
-    // now you have 
-    current_num = keypoints.substr(start, end-start);
-    float z = stof(current_num);
-
-    return {x, y, z};
+/**
+ * @brief first x, y, z in a keypoint string, e.g. "-0.87, 1.00, -0.09". Leading or
+ * dangling commas are skipped, missing numbers are 0.
+ *
+ * @param keypoints
+ * @param reverse_y
+ * @return position
+ */
+position split_string_kp_into_arr (const std::string& keypoints, bool reverse_y=false) {
+    float xyz[3] = {0, 0, 0};
+    parse_keypoints(keypoints.data(), keypoints.data() + keypoints.size(), xyz, 1, reverse_y);
+    return {xyz[0], xyz[1], xyz[2]};
 }
 
-std::vector<position> split_blaze_keypoints (std::string kp, bool reverse_y=false) {
-    std::string end_bracket = "]";
-    std::string comma = ",";
-    int start, end = -1*end_bracket.size();
-    std::vector<position> positions; 
-    do {
-        start = end + end_bracket.size();
-        end = kp.find(end_bracket, start);
-        // now you have 
-        std::string keypoints = kp.substr(start, end-start);
-        keypoints.erase(remove(keypoints.begin(), keypoints.end(), '['), keypoints.end());
-        // now I should have NUM, NUM, NUM
-        //cout << "gotten " << keypoints << "\n";
-        if (keypoints.find(",") == std::string::npos)
-            break;
-        positions.push_back(
-            split_string_kp_into_arr(keypoints, reverse_y)
-        );
-    } while (end != -1);
-    std::cout << "POSITIONS SIZE: "  << positions.size() << std::endl;
+/**
+ * @brief all keypoints of a "[[x, y, z], [x, y, z], ...]" line
+ *
+ * @param kp
+ * @param reverse_y
+ * @return std::vector<position>
+ */
+std::vector<position> split_blaze_keypoints (const std::string& kp, bool reverse_y=false) {
+    std::vector<float> xyz(max_floats_in(kp.size()));
+    size_t count = parse_keypoints(kp.data(), kp.data() + kp.size(), xyz.data(), xyz.size() / 3, reverse_y);
+    std::vector<position> positions(count);
+    for (size_t i = 0; i < count; i++)
+        positions[i] = {xyz[i*3], xyz[i*3 + 1], xyz[i*3 + 2]};
     return positions;
 }
 
+/**
+ * @brief rotates every vampire bone mapped to a single blaze bone by that blaze bone's rotation
+ *
+ * @param blaze_name name of the blaze bone the rotation belongs to
+ * @param current_rot
+ * @param vamp
+ * @param blaze_vamp_mapping result of blaze_to_vampire_map()
+ * @param joint_rotations per vamp.fk tree bone, current_rot is applied after what it holds
+ * @param rotated per vamp.fk tree bone, set for the bones rotated
+ */
+void apply_rotation_to_mapped_vamp_bones(
+    const std::string& blaze_name,
+    const matrix& current_rot,
+    const bodymodel& vamp,
+    std::unordered_map<std::string, std::vector<std::tuple<int, int>>>& blaze_vamp_mapping,
+    std::vector<matrix>& joint_rotations,
+    std::vector<bool>& rotated)
+{
+    // get vamp pos index tuple
+    auto vamp_bone_indexs = blaze_vamp_mapping[blaze_name];
+    for (auto bone_tuple : vamp_bone_indexs) {
+        std::vector<bone> vamp_bones = vamp.get_all_bone_between_parent_and_child(
+            std::get<0>(bone_tuple),
+            std::get<1>(bone_tuple)
+        );
+        // apply rotation for each bone
+        for (bone vamp_bone : vamp_bones) {
+            int joint = vamp.skel->fk.joint_of(vamp_bone);
+            if (joint < 0)
+                continue;
+            joint_rotations[joint] = current_rot.dot(joint_rotations[joint]);
+            rotated[joint] = true;
+        }
+    }
+}
+
 // blaze model does not need positions, it is just used to grab bone names
 std::tuple<bodymodel, std::unordered_map<std::string, position>> apply_rotations_to_vamp_model(
-    std::unordered_map<std::string, matrix> blaze_rotations, 
-    bodymodel vamp, 
-    bodymodel blaze
+    const std::unordered_map<std::string, matrix>& blaze_rotations, 
+    const bodymodel& vamp, 
+    const bodymodel& blaze
 ) {
     auto blaze_vamp_mapping = blaze_to_vampire_map();
-    std::vector<position> local_positions = vamp.positions;
-
-    auto new_vamp = vamp;
-    std::unordered_map<std::string, position> translation_map;
+    const fk_solver& fk = vamp.skel->fk;
+    std::vector<matrix> joint_rotations(fk.size(), identity());
+    std::vector<bool> rotated(fk.size(), false);
 
     // iterate thru blaze model to get rotation and vamp bone
-    for (auto base_bone : blaze.base_bones) {
-        // get local rotations
-        auto current_rot = blaze_rotations[base_bone.name];
-        
-        // get vamp pos index tuple
-        auto vamp_bone_indexs = blaze_vamp_mapping[base_bone.name];
-        for (auto bone_tuple : vamp_bone_indexs) {
-
-
-            std::vector<bone> vamp_bones = vamp.get_all_bone_between_parent_and_child(
-                std::get<0>(bone_tuple),
-                std::get<1>(bone_tuple)
-            );
-            // apply rotation for each bone
-            for (bone vamp_bone : vamp_bones) {
-                // local_positions = vamp.rotate_single_bone_with_translation_map(vamp_bone, local_positions, current_rot, translation_map);
-                vamp.rotate_single_bone_with_translation_map(vamp_bone, current_rot, local_positions, translation_map);
-            }
-        }
-
-        for (auto local_bone : blaze.bones_flow[base_bone]) {
-            // get local rotations
-            auto current_rot = blaze_rotations[local_bone.name];
-            
-            // get vamp pos index tuple
-            auto vamp_bone_indexs = blaze_vamp_mapping[local_bone.name];
-            for (auto bone_tuple : vamp_bone_indexs) {
-                std::vector<bone> vamp_bones = vamp.get_all_bone_between_parent_and_child(
-                    std::get<0>(bone_tuple),
-                    std::get<1>(bone_tuple)
-                );
-                // apply rotation for each bone
-                for (bone vamp_bone : vamp_bones) {
-                    // local_positions = vamp.rotate_single_bone_with_translation_map(vamp_bone, local_positions, current_rot, translation_map);
-                    vamp.rotate_single_bone_with_translation_map(vamp_bone, current_rot, local_positions, translation_map);
-                }
-            }
+    for (const bone& base_bone : blaze.skel->base_bones) {
+        apply_rotation_to_mapped_vamp_bones(base_bone.name, rotation_of(blaze_rotations, base_bone.name),
+            vamp, blaze_vamp_mapping, joint_rotations, rotated);
 
+        for (const bone& local_bone : blaze.flow(base_bone)) {
+            apply_rotation_to_mapped_vamp_bones(local_bone.name, rotation_of(blaze_rotations, local_bone.name),
+                vamp, blaze_vamp_mapping, joint_rotations, rotated);
         }
     }
 
-    new_vamp.set_positions(local_positions);
-    return {new_vamp, translation_map};
+    // the posed model shares vamp's skeleton, only its positions are new
+    bodymodel new_vamp(vamp.skel);
+    fk.solve(vamp.positions, joint_rotations.data(), new_vamp.positions);
+    std::unordered_map<std::string, position> translations = vamp.downstream_translations(new_vamp.positions, rotated);
+    return {std::move(new_vamp), std::move(translations)};
 }
 
-std::unordered_map<std::string, matrix> get_vampire_blaze_rotations(bodymodel blaze, bodymodel vampire) {
+std::unordered_map<std::string, matrix> get_vampire_blaze_rotations(const bodymodel& blaze, const bodymodel& vampire) {
     auto blaze_vamp_mapping = blaze_to_vampire_map();
     std::unordered_map<std::string, matrix> bone_name_to_rotation;
 
     // iterate thru blaze model to get rotation and vamp bone
-    for (auto base_bone : blaze.base_bones) {
+    for (const bone& base_bone : blaze.skel->base_bones) {
         // get local blaze positions
 
         position curr_parent = blaze.positions[base_bone.parent_index];
@@ -1279,7 +1572,7 @@ std::unordered_map<std::string, matrix> get_vampire_blaze_rotations(bodymodel bl
 
         bone_name_to_rotation[base_bone.name] = rotation;
 
-        for (auto local_bone : blaze.bones_flow[base_bone]) {
+        for (auto local_bone : blaze.flow(base_bone)) {
             position curr_parent = blaze.positions[local_bone.parent_index];
             position curr_child = blaze.positions[local_bone.child_index];
             // now adjust with parent as origin
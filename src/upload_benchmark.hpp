@@ -0,0 +1,94 @@
+#ifndef UPLOAD_BENCHMARK_HPP
+#define UPLOAD_BENCHMARK_HPP
+
+#include <glad/glad.h>
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+
+#include "skeleton_utils.h"
+#include "pose_stream.hpp"
+#include "retarget_plan.hpp"
+#include "StreamingBuffer.h"
+
+struct upload_benchmark_result {
+    bool persistent = false;
+    unsigned int frames = 0;
+    double bytes_per_frame = 0;
+    uint64_t stalls = 0;
+    double stall_ms = 0;
+    double ms_per_frame = 0;
+};
+
+/**
+ * @brief streams every frame of a clip through a StreamingBuffer and draws it, retargeting
+ * each frame straight into the buffer. Needs a current GL context but no window, so it runs
+ * under an offscreen / software context (e.g. a hidden GLFW window on Mesa llvmpipe).
+ *
+ * @param plan compiled against stream.bone_names()
+ * @param stream
+ * @param base_model vampire model at rest
+ * @param frames frames to render, wraps around the clip
+ * @param persistent false forces the orphan + glBufferSubData path
+ * @return upload_benchmark_result
+ */
+upload_benchmark_result run_upload_benchmark(
+    const retarget_plan& plan,
+    const pose_stream& stream,
+    bodymodel& base_model,
+    unsigned int frames,
+    bool persistent)
+{
+    std::vector<int> draw_order = base_model.position_indices_in_order();
+    std::vector<position> scratch = base_model.positions;
+    size_t frame_bytes = draw_order.size() * 3 * sizeof(float);
+
+    upload_benchmark_result result;
+    unsigned int VAO;
+    glGenVertexArrays(1, &VAO);
+    {
+        StreamingBuffer buffer(frame_bytes, 3 * sizeof(float), persistent);
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, buffer.VBO);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (unsigned int i = 0; i < frames; i++) {
+            float* dst = (float*) buffer.BeginWrite();
+            retarget_frame_into(plan, stream.frame_data(i % stream.frame_count()), base_model.positions,
+                draw_order, scratch, dst);
+            buffer.EndWrite(frame_bytes);
+
+            glDrawArrays(GL_POINTS, buffer.FirstVertex(), draw_order.size());
+            glDrawArrays(GL_LINES, buffer.FirstVertex(), draw_order.size());
+            buffer.FenceDraws();
+            glFlush();
+        }
+        glFinish();
+        auto stop = std::chrono::high_resolution_clock::now();
+
+        const StreamingBufferStats& stats = buffer.Stats();
+        result.persistent = buffer.IsPersistent();
+        result.frames = frames;
+        result.bytes_per_frame = stats.BytesPerFrame();
+        result.stalls = stats.stalls;
+        result.stall_ms = stats.stallSeconds * 1000.0;
+        result.ms_per_frame = std::chrono::duration<double, std::milli>(stop - start).count() / frames;
+        glBindVertexArray(0);
+    }
+    glDeleteVertexArrays(1, &VAO);
+
+    GLenum e = glGetError();
+    if (e != GL_NO_ERROR)
+        fprintf(stderr, "OpenGL error in \"%s\": %d (%d)\n", "upload benchmark", e, e);
+
+    std::cout << (result.persistent ? "persistent ring" : "orphan + subdata") << ": "
+        << result.frames << " frames, " << result.bytes_per_frame << " bytes/frame, "
+        << result.stalls << " stalls (" << result.stall_ms << " ms), "
+        << result.ms_per_frame << " ms/frame" << std::endl;
+    return result;
+}
+
+#endif
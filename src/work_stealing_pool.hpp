@@ -0,0 +1,147 @@
+#ifndef WORK_STEALING_POOL_HPP
+#define WORK_STEALING_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Persistent thread pool for data parallel loops over independent items (frames, instances,
+ * vertex chunks). Each parallel_for splits the range into grain sized chunks and gives every
+ * worker a contiguous run of them; a worker that runs dry steals chunks from the others.
+ * The calling thread takes part as worker 0, so a pool of size 1 just runs inline.
+ */
+class work_stealing_pool {
+public:
+    // fn(begin, end, worker_index), worker_index < size()
+    typedef std::function<void(size_t, size_t, unsigned int)> range_job;
+
+    explicit work_stealing_pool(unsigned int worker_count = 0) {
+        if (worker_count == 0)
+            worker_count = std::thread::hardware_concurrency();
+        if (worker_count == 0)
+            worker_count = 1;
+        queue_count = worker_count;
+        queues.reset(new chunk_queue[worker_count]);
+        for (unsigned int i = 1; i < worker_count; i++)
+            threads.emplace_back(&work_stealing_pool::worker_loop, this, i);
+    }
+
+    work_stealing_pool(const work_stealing_pool&) = delete;
+    work_stealing_pool& operator=(const work_stealing_pool&) = delete;
+
+    ~work_stealing_pool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& t : threads)
+            t.join();
+    }
+
+    unsigned int size() const { return queue_count; }
+
+    /**
+     * @brief runs fn over [0, count) in chunks of at most grain items and blocks until done.
+     * Calls from different threads are serialized, fn must not call parallel_for itself.
+     *
+     * @param count
+     * @param grain
+     * @param fn
+     */
+    void parallel_for(size_t count, size_t grain, const range_job& fn) {
+        if (count == 0)
+            return;
+        if (grain == 0)
+            grain = 1;
+
+        std::lock_guard<std::mutex> call_lock(call_mutex);
+        size_t chunk_total = (count + grain - 1) / grain;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = &fn;
+            job_count = count;
+            job_grain = grain;
+            for (unsigned int i = 0; i < queue_count; i++) {
+                queues[i].next.store(chunk_total * i / queue_count, std::memory_order_relaxed);
+                queues[i].end = chunk_total * (i + 1) / queue_count;
+            }
+            active_workers = threads.size();
+            generation++;
+        }
+        wake.notify_all();
+
+        run_worker(0);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return active_workers == 0; });
+        job = nullptr;
+    }
+
+private:
+    struct alignas(64) chunk_queue {
+        std::atomic<size_t> next{0};
+        size_t end = 0;
+    };
+
+    std::vector<std::thread> threads;
+    std::unique_ptr<chunk_queue[]> queues;
+    unsigned int queue_count = 1;
+
+    std::mutex call_mutex;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    const range_job* job = nullptr;
+    size_t job_count = 0;
+    size_t job_grain = 1;
+    uint64_t generation = 0;
+    size_t active_workers = 0;
+    bool stopping = false;
+
+    void run_chunk(size_t chunk, unsigned int worker) {
+        size_t begin = chunk * job_grain;
+        size_t end = begin + job_grain < job_count ? begin + job_grain : job_count;
+        (*job)(begin, end, worker);
+    }
+
+    // drains the worker's own chunks first, then steals from the others in turn
+    void run_worker(unsigned int worker) {
+        for (unsigned int offset = 0; offset < queue_count; offset++) {
+            chunk_queue& queue = queues[(worker + offset) % queue_count];
+            while (true) {
+                size_t chunk = queue.next.fetch_add(1, std::memory_order_relaxed);
+                if (chunk >= queue.end)
+                    break;
+                run_chunk(chunk, worker);
+            }
+        }
+    }
+
+    void worker_loop(unsigned int worker) {
+        uint64_t seen_generation = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return stopping || generation != seen_generation; });
+                if (stopping)
+                    return;
+                seen_generation = generation;
+            }
+
+            run_worker(worker);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--active_workers == 0)
+                done.notify_one();
+        }
+    }
+};
+
+#endif
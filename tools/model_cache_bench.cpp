@@ -0,0 +1,53 @@
+// Compares model + animation startup without the baked model cache (one ModelImport pass
+// for the meshes and every clip), with a cold cache (import and bake) and with a warm one
+// (hash + map only). Texture decode / upload is reported on its own since the cache does
+// not cover images.
+//
+// Runs in a hidden window like upload_bench. Run from the repository root.
+//
+//   model_cache_bench [model.dae] [runs]
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <iostream>
+#include <string>
+
+#include "../src/model_cache_benchmark.hpp"
+
+int main(int argc, char** argv)
+{
+    std::string path = argc > 1 ? argv[1] : "./src/models/dancing_vampire/dancing_vampire.dae";
+    unsigned int runs = argc > 2 ? std::stoul(argv[2]) : 5;
+
+    glfwInit();
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+
+    GLFWwindow* window = glfwCreateWindow(64, 64, "model cache bench", NULL, NULL);
+    if (window == NULL) {
+        std::cout << "Failed to create GLFW Window" << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+
+    if (!gladLoadGLLoader((GLADloadproc) glfwGetProcAddress)) {
+        std::cout << "Failed to init GLAD" << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+    std::cout << "GL_RENDERER: " << glGetString(GL_RENDERER) << std::endl;
+
+    // same layout main renders with
+    MeshStorage storage;
+    storage.layout = MESH_LAYOUT_COMPACT;
+    storage.cpuCopy = MESH_RELEASE_CPU;
+    run_model_cache_benchmark(path, runs, storage);
+
+    glfwTerminate();
+    return 0;
+}
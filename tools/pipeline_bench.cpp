@@ -0,0 +1,77 @@
+// Benchmarks the pose pipeline's hot paths with fixed inputs: rodrigues, matrix::dot,
+// construct_rotations, rotate_self_by_rotations (fk) against rotate_self_by_single_bones,
+// fk_solver::solve, skeleton::rotations_into + solve on pose buffers, bodymodel topology
+// lookups, apply_rotations_to_vamp_model, matrices_from_line, vectorify_positions_in_order
+// + flatten and Animator::UpdateAnimation, the skeleton sized ones from 13 to 4096 bones.
+// Needs glm and the assimp headers, no window or GL context.
+//
+//   pipeline_bench [--filter TEXT] [--min-time S] [--repetitions N] [--max-bones N]
+//                  [--json PATH] [--compare BASELINE.json] [--threshold F]
+//
+// Run from the repository root so joints_output/ is found. --json writes the results,
+// --compare runs against an earlier --json file and exits with 1 when a case got slower
+// by more than --threshold (default 0.10), so it can gate a commit.
+
+#include <iostream>
+#include <vector>
+#include <string>
+
+#include "../src/pipeline_benchmarks.hpp"
+
+void print_usage() {
+    std::cout << "usage: pipeline_bench [--filter TEXT] [--min-time S] [--repetitions N] [--max-bones N]"
+        " [--json PATH] [--compare BASELINE.json] [--threshold F]" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    pipeline_benchmark_options options;
+    std::string json_path;
+    std::string baseline_path;
+    double threshold = 0.10;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--filter" && i + 1 < argc) {
+            options.filter = argv[++i];
+        } else if (arg == "--min-time" && i + 1 < argc) {
+            options.min_seconds = std::stod(argv[++i]);
+        } else if (arg == "--repetitions" && i + 1 < argc) {
+            options.repetitions = std::stoul(argv[++i]);
+        } else if (arg == "--max-bones" && i + 1 < argc) {
+            options.max_bones = std::stoul(argv[++i]);
+        } else if (arg == "--json" && i + 1 < argc) {
+            json_path = argv[++i];
+        } else if (arg == "--compare" && i + 1 < argc) {
+            baseline_path = argv[++i];
+        } else if (arg == "--threshold" && i + 1 < argc) {
+            threshold = std::stod(argv[++i]);
+        } else {
+            print_usage();
+            return arg == "--help" || arg == "-h" ? 0 : -1;
+        }
+    }
+
+    // the baseline is read first so a bad path fails before the run
+    std::vector<std::pair<std::string, double>> baseline;
+    if (!baseline_path.empty() && !read_pipeline_benchmark_json(baseline_path, baseline))
+        return -1;
+
+    std::vector<pipeline_benchmark_result> results = run_pipeline_benchmarks(options);
+    if (results.empty()) {
+        std::cout << "ERROR: NO BENCHMARK MATCHES " << options.filter << std::endl;
+        return -1;
+    }
+    if (!json_path.empty() && !write_pipeline_benchmark_json(results, options, json_path))
+        return -1;
+
+    if (!baseline_path.empty()) {
+        std::cout << "against " << baseline_path << ":" << std::endl;
+        unsigned int regressions = compare_pipeline_benchmarks(results, baseline, threshold);
+        if (regressions > 0) {
+            std::cout << regressions << " case(s) slower by more than " << threshold * 100.0 << "%" << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
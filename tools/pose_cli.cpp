@@ -0,0 +1,80 @@
+// Headless pose pipeline: load -> retarget -> export for a batch of captures, with no
+// window, GL context or GPU. Builds without glad/GLFW, only glm is needed.
+//
+//   pose_cli [--threads N] [--out DIR] [--format text|binary] capture...
+//
+// Captures are text captures (base positions line followed by FRAME lines), .pstream or
+// .parc files. Prints per capture timing and the batch throughput.
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+
+#include "../src/pose_pipeline.hpp"
+
+void print_usage() {
+    std::cout << "usage: pose_cli [--threads N] [--out DIR] [--format text|binary] capture..." << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    unsigned int threads = 0;
+    std::string output_dir = "pose_output";
+    pose_export_format format = POSE_EXPORT_TEXT;
+    std::vector<std::string> captures;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) {
+            threads = std::stoul(argv[++i]);
+        } else if (arg == "--out" && i + 1 < argc) {
+            output_dir = argv[++i];
+        } else if (arg == "--format" && i + 1 < argc) {
+            std::string name = argv[++i];
+            if (name == "binary")
+                format = POSE_EXPORT_BINARY;
+            else if (name == "text")
+                format = POSE_EXPORT_TEXT;
+            else {
+                print_usage();
+                return -1;
+            }
+        } else if (arg == "--help" || arg == "-h") {
+            print_usage();
+            return 0;
+        } else {
+            captures.push_back(arg);
+        }
+    }
+    if (captures.empty()) {
+        print_usage();
+        return -1;
+    }
+
+    work_stealing_pool pool(threads);
+    std::cout << "processing " << captures.size() << " captures on " << pool.size() << " threads" << std::endl;
+
+    uint64_t total_frames = 0;
+    unsigned int failed = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (const std::string& capture : captures) {
+        pose_job_result result = process_capture(capture, output_dir, format, pool);
+        if (!result.ok) {
+            std::cout << "ERROR: FAILED TO PROCESS " << capture << std::endl;
+            failed++;
+            continue;
+        }
+        total_frames += result.frames;
+        std::cout << capture << ": " << result.frames << " frames, load " << result.load_ms
+            << " ms, retarget " << result.retarget_ms << " ms, export " << result.export_ms
+            << " ms -> " << result.output << std::endl;
+    }
+    auto stop = std::chrono::high_resolution_clock::now();
+
+    double seconds = std::chrono::duration<double>(stop - start).count();
+    std::cout << "batch: " << captures.size() - failed << "/" << captures.size() << " captures, "
+        << total_frames << " frames in " << seconds * 1000.0 << " ms ("
+        << (seconds > 0 ? total_frames / seconds : 0) << " frames/s)" << std::endl;
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,211 @@
+// Fake pose producer: replays a joints_output capture into the pose ingest endpoint at a
+// fixed rate, the way a live capture process would. Builds without glad/GLFW.
+//
+//   pose_replay [--fps N] [--frames N] [--binary] [--connect ENDPOINT] capture
+//
+// By default a pose_ingest_server runs in process on a temporary endpoint and a consumer
+// thread polls it like the render loop does, so the tool reports end to end latency
+// (send -> poll) and the received frame rate. --fps 0 sends as fast as the server takes
+// frames, which gives the max sustainable rate. With --connect it only sends, e.g. into
+// the app running with LIVE_INGEST_ENDPOINT set.
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <filesystem>
+
+#include "../src/pose_ingest.hpp"
+
+void print_usage() {
+    std::cout << "usage: pose_replay [--fps N] [--frames N] [--binary] [--connect ENDPOINT] capture" << std::endl;
+}
+
+struct replay_capture {
+    std::vector<std::string> lines;
+    pose_stream stream;
+};
+
+/**
+ * @brief sends frames to an endpoint, text lines or binary frames, repeating the capture
+ * when frames is larger than it
+ *
+ * @param endpoint
+ * @param capture
+ * @param binary
+ * @param fps 0 sends without pacing
+ * @param frames
+ * @param sent_at filled with the send time of every frame, published through sent
+ * @param sent
+ * @return seconds spent sending, negative when the endpoint went away
+ */
+double replay(
+    const std::string& endpoint,
+    replay_capture& capture,
+    bool binary,
+    double fps,
+    unsigned int frames,
+    std::vector<double>& sent_at,
+    std::atomic<unsigned int>& sent)
+{
+    pose_ingest_client client;
+    if (!client.connect(endpoint)) {
+        std::cout << "ERROR: FAILED TO CONNECT TO " << endpoint << std::endl;
+        return -1;
+    }
+    bool ok = binary
+        ? client.write_binary_header(capture.stream.bone_names(), capture.stream.base_positions())
+        : client.write(capture.lines[0].data(), capture.lines[0].size());
+
+    unsigned int capture_frames = binary ? capture.stream.frame_count() : capture.lines.size() - 1;
+    double start = pose_follow_clock();
+    for (unsigned int i = 0; i < frames && ok; i++) {
+        if (fps > 0) {
+            double due = start + i / fps;
+            while (pose_follow_clock() < due)
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        sent_at[i] = pose_follow_clock();
+        sent.store(i + 1, std::memory_order_release);
+        if (binary) {
+            ok = client.write_binary_frame(i, capture.stream.frame_data(i % capture_frames), capture.stream.bone_count());
+        } else {
+            const std::string& line = capture.lines[1 + i % capture_frames];
+            ok = client.write(line.data(), line.size());
+        }
+    }
+    double seconds = pose_follow_clock() - start;
+    if (!ok) {
+        std::cout << "ERROR: ENDPOINT CLOSED AFTER " << sent.load() << " FRAMES" << std::endl;
+        return -1;
+    }
+    return seconds;
+}
+
+int main(int argc, char** argv)
+{
+    double fps = 60;
+    unsigned int frames = 600;
+    bool binary = false;
+    std::string connect_to;
+    std::string capture_path;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--fps" && i + 1 < argc) {
+            fps = std::stod(argv[++i]);
+        } else if (arg == "--frames" && i + 1 < argc) {
+            frames = std::stoul(argv[++i]);
+        } else if (arg == "--binary") {
+            binary = true;
+        } else if (arg == "--connect" && i + 1 < argc) {
+            connect_to = argv[++i];
+        } else if (arg == "--help" || arg == "-h") {
+            print_usage();
+            return 0;
+        } else {
+            capture_path = arg;
+        }
+    }
+    if (capture_path.empty() || frames == 0) {
+        print_usage();
+        return -1;
+    }
+
+    // text frames are sent as the capture's own lines, binary ones from its pose stream
+    replay_capture capture;
+    std::ifstream file(capture_path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cout << "ERROR: FAILED TO OPEN FILE " << capture_path << std::endl;
+        return -1;
+    }
+    std::string line;
+    while (std::getline(file, line))
+        capture.lines.push_back(line + "\n");
+    if (capture.lines.size() < 2) {
+        std::cout << "ERROR: NO FRAMES IN " << capture_path << std::endl;
+        return -1;
+    }
+    std::string stream_path = (std::filesystem::temp_directory_path() / "pose_replay.pstream").string();
+    if (!convert_pose_text_file_to_stream(capture_path, stream_path, false) || !capture.stream.open(stream_path) ||
+        capture.stream.frame_count() == 0)
+        return -1;
+
+    std::vector<double> sent_at(frames);
+    std::atomic<unsigned int> sent{0};
+
+    if (!connect_to.empty()) {
+        double seconds = replay(connect_to, capture, binary, fps, frames, sent_at, sent);
+        if (seconds < 0)
+            return 1;
+        std::cout << "sent " << frames << " frames in " << seconds * 1000.0 << " ms ("
+            << (seconds > 0 ? frames / seconds : 0) << " frames/s)" << std::endl;
+        return 0;
+    }
+
+    // loopback: server and consumer in this process, the consumer takes every frame
+#ifdef _WIN32
+    std::string endpoint = POSE_INGEST_DEFAULT_ENDPOINT + "_replay";
+#else
+    std::string endpoint = (std::filesystem::temp_directory_path() / "pose_replay.sock").string();
+#endif
+    pose_ingest_server server(endpoint, capture.stream.bone_names());
+    server.start();
+
+    std::vector<double> latencies;
+    latencies.reserve(frames);
+    double last_arrival = 0;
+    std::atomic<bool> sending{true};
+    std::thread consumer([&]() {
+        live_pose_sample sample;
+        double give_up = 0;
+        while (latencies.size() < frames) {
+            if (server.poll(POSE_FOLLOW_EVERY_FRAME, sample) && sample.fresh) {
+                if (sample.sequence < sent.load(std::memory_order_acquire)) {
+                    last_arrival = pose_follow_clock();
+                    latencies.push_back(last_arrival - sent_at[sample.sequence]);
+                }
+                continue;
+            }
+            // frames still in flight get a second once the producer is done
+            if (!sending.load()) {
+                if (give_up == 0)
+                    give_up = pose_follow_clock() + 1.0;
+                else if (pose_follow_clock() > give_up)
+                    break;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    });
+
+    // the listener opens on the server thread
+    for (int waited = 0; waited < 1000 && !server.Listening(); waited++)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    replay(endpoint, capture, binary, fps, frames, sent_at, sent);
+    sending.store(false);
+    consumer.join();
+    server.stop();
+    std::filesystem::remove(stream_path);
+    if (latencies.empty()) {
+        std::cout << "ERROR: NO FRAMES RECEIVED" << std::endl;
+        return 1;
+    }
+
+    double mean = 0;
+    for (double l : latencies)
+        mean += l;
+    mean /= latencies.size();
+    std::sort(latencies.begin(), latencies.end());
+    double p99 = latencies[std::min(latencies.size() - 1, (size_t) (latencies.size() * 0.99))];
+    double received_seconds = last_arrival - sent_at[0];
+
+    std::cout << (binary ? "binary" : "text") << " at " << (fps > 0 ? std::to_string(fps) : std::string("max")) << " fps: "
+        << latencies.size() << "/" << frames << " frames received, latency mean " << mean * 1000.0
+        << " ms, p99 " << p99 * 1000.0 << " ms, max " << latencies.back() * 1000.0 << " ms, "
+        << (received_seconds > 0 ? latencies.size() / received_seconds : 0) << " frames/s received, "
+        << server.BytesRead() / 1e6 << " MB read" << std::endl;
+    return latencies.size() == frames ? 0 : 1;
+}
@@ -0,0 +1,86 @@
+// Measures per frame pose vertex upload (bytes/frame, fence stalls, frame time) for the
+// persistent ring and the orphan + glBufferSubData fallback, then bone palette upload
+// (GL calls/frame, frame time) per uniform upload mode, then static mesh vertex upload in
+// the full and compact vertex layouts.
+//
+// Runs in a hidden window, so it works on machines without a GPU through a software
+// driver, e.g. LIBGL_ALWAYS_SOFTWARE=1 on Mesa. Run from the repository root.
+//
+//   upload_bench [capture.txt] [frames]
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+
+#include <iostream>
+#include <string>
+
+#include "../src/Shader.h"
+#include "../src/pose_stream.hpp"
+#include "../src/retarget_plan.hpp"
+#include "../src/upload_benchmark.hpp"
+#include "../src/bone_upload_benchmark.hpp"
+#include "../src/mesh_benchmarks.hpp"
+
+int main(int argc, char** argv)
+{
+    std::string capture = argc > 1 ? argv[1] : "ymca_blaze_vamp.txt";
+    unsigned int frames = argc > 2 ? std::stoul(argv[2]) : 2000;
+
+    glfwInit();
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 4);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+
+    GLFWwindow* window = glfwCreateWindow(64, 64, "upload bench", NULL, NULL);
+    if (window == NULL) {
+        // no 4.4 context, the fallback path is still worth measuring
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        window = glfwCreateWindow(64, 64, "upload bench", NULL, NULL);
+    }
+    if (window == NULL) {
+        std::cout << "Failed to create GLFW Window" << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+    glfwSwapInterval(0);
+
+    if (!gladLoadGLLoader((GLADloadproc) glfwGetProcAddress)) {
+        std::cout << "Failed to init GLAD" << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+    std::cout << "GL_RENDERER: " << glGetString(GL_RENDERER) << std::endl;
+    std::cout << "GL_VERSION: " << glGetString(GL_VERSION) << std::endl;
+
+    {
+        Shader pointShader("point_shader");
+        pointShader.use();
+        pointShader.setMat4("projection", glm::mat4(1.0f));
+        pointShader.setMat4("view", glm::mat4(1.0f));
+        pointShader.setMat4("model", glm::mat4(1.0f));
+
+        pose_stream stream;
+        bodymodel base_model = load_vamp_model_from_stream(ensure_pose_stream(capture), stream);
+        if (stream.frame_count() == 0) {
+            std::cout << "Failed to load pose frames" << std::endl;
+            glfwTerminate();
+            return -1;
+        }
+        retarget_plan plan = compile_retarget_plan(create_adjusted_blaze_model(), base_model, stream.bone_names());
+
+        run_upload_benchmark(plan, stream, base_model, frames, true);
+        run_upload_benchmark(plan, stream, base_model, frames, false);
+
+        run_bone_upload_benchmarks(frames);
+
+        run_mesh_upload_benchmarks();
+    }
+
+    glfwTerminate();
+    return 0;
+}